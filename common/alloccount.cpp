@@ -0,0 +1,130 @@
+// Replacements for the global operator new and operator delete, that count the allocations of
+// each thread before passing them on to malloc and free. Without COUNT_ALLOCATIONS, nothing is
+// replaced, and the counts stay at zero.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "alloccount.hpp"
+
+namespace {
+
+// Counter is the counts of one thread, in a cache line of its own
+struct alignas(64) Counter {
+    std::atomic<uint64_t> allocations { 0 };
+    std::atomic<uint64_t> bytes { 0 };
+};
+
+// The counters are not allocated, since they are used by operator new. If there are more threads
+// than counters, the remaining threads share the last one.
+constexpr size_t maxCounters = 256;
+Counter counters[maxCounters];
+std::atomic<size_t> usedCounters { 0 };
+thread_local Counter* threadCounter = nullptr;
+
+Counter& this_thread_counter()
+{
+    if (threadCounter == nullptr) {
+        const size_t i = usedCounters.fetch_add(1, std::memory_order_relaxed);
+        threadCounter = &counters[std::min(i, maxCounters - 1)];
+    }
+    return *threadCounter;
+}
+
+#ifdef COUNT_ALLOCATIONS
+
+void* counted_malloc(size_t size)
+{
+    Counter& counter = this_thread_counter();
+    counter.allocations.fetch_add(1, std::memory_order_relaxed);
+    counter.bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* counted_aligned_alloc(size_t size, std::align_val_t align)
+{
+    Counter& counter = this_thread_counter();
+    counter.allocations.fetch_add(1, std::memory_order_relaxed);
+    counter.bytes.fetch_add(size, std::memory_order_relaxed);
+    // aligned_alloc wants a size that is a multiple of the alignment
+    const auto alignment = static_cast<size_t>(align);
+    const size_t rounded = std::max((size + alignment - 1) & ~(alignment - 1), alignment);
+    return std::aligned_alloc(alignment, rounded);
+}
+
+#endif
+
+}
+
+AllocationCount allocation_count()
+{
+    AllocationCount total;
+    const size_t used = std::min(usedCounters.load(std::memory_order_relaxed), maxCounters);
+    for (size_t i = 0; i < used; ++i) {
+        total.allocations += counters[i].allocations.load(std::memory_order_relaxed);
+        total.bytes += counters[i].bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+AllocationCount thread_allocation_count()
+{
+    const Counter& counter = this_thread_counter();
+    return AllocationCount { counter.allocations.load(std::memory_order_relaxed),
+        counter.bytes.load(std::memory_order_relaxed) };
+}
+
+#ifdef COUNT_ALLOCATIONS
+
+void* operator new(size_t size)
+{
+    if (void* p = counted_malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc {};
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_malloc(size); }
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_malloc(size); }
+
+void* operator new(size_t size, std::align_val_t align)
+{
+    if (void* p = counted_aligned_alloc(size, align)) {
+        return p;
+    }
+    throw std::bad_alloc {};
+}
+
+void* operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return counted_aligned_alloc(size, align);
+}
+
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return counted_aligned_alloc(size, align);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif
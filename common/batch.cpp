@@ -0,0 +1,143 @@
+// Reading manifests of images to render
+
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+
+using namespace std::string_literals;
+
+auto numbered_filename(const std::string& filename, int number, int digits) -> std::string
+{
+    const auto dot = filename.find_last_of('.');
+    const auto slash = filename.find_last_of('/');
+    const bool extension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    const std::string stem = extension ? filename.substr(0, dot) : filename;
+    const std::string suffix = extension ? filename.substr(dot) : ""s;
+    std::string numberString = std::to_string(number);
+    if (numberString.size() < static_cast<size_t>(digits)) {
+        numberString.insert(0, digits - numberString.size(), '0');
+    }
+    return stem + "_"s + numberString + suffix;
+}
+
+auto parse_manifest(const std::string& filename) -> std::vector<BatchImage>
+{
+    std::ifstream in { filename };
+    if (!in) {
+        throw std::runtime_error("could not open "s + filename);
+    }
+
+    // Scenes and outputs are relative to the directory of the manifest
+    const auto dirSlash = filename.find_last_of('/');
+    const std::string dir
+        = (dirSlash == std::string::npos) ? ""s : filename.substr(0, dirSlash + 1);
+    const auto relative = [&](const std::string& path) {
+        return path.starts_with('/') ? path : dir + path;
+    };
+
+    std::vector<BatchImage> images;
+
+    // The images that the last image line created, which camera, move and sweep change
+    size_t first = 0;
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const auto fail = [&](const std::string& what) {
+            throw std::runtime_error(
+                filename + ":"s + std::to_string(lineNumber) + ": "s + what);
+        };
+
+        std::istringstream words { line };
+        std::string kind;
+        if (!(words >> kind) || kind[0] == '#') {
+            continue;
+        }
+
+        // Read the given number of numbers from the rest of the line
+        const auto numbers = [&](size_t n) {
+            std::vector<double> xs(n);
+            for (auto& x : xs) {
+                if (!(words >> x)) {
+                    fail("expected "s + std::to_string(n) + " numbers after "s + kind);
+                }
+            }
+            return xs;
+        };
+
+        if (kind != "image"s && first == images.size()) {
+            fail(kind + " must come after an image"s);
+        }
+
+        if (kind == "image"s) {
+            BatchImage image;
+            if (!(words >> image.output >> image.scene)) {
+                fail("expected an output file and a scene"s);
+            }
+            image.output = relative(image.output);
+            if (image.scene != "demo"s) {
+                image.scene = relative(image.scene);
+            }
+            image.width = 495;
+            image.height = 270;
+            int width, height;
+            if (words >> width) {
+                if (!(words >> height) || width < 1 || height < 1 || width > 16384
+                    || height > 16384) {
+                    fail("expected a width and a height from 1 to 16384"s);
+                }
+                image.width = width;
+                image.height = height;
+            }
+            first = images.size();
+            images.push_back(image);
+        } else if (kind == "camera"s) {
+            const auto v = numbers(3);
+            double yaw = 0, pitch = 0;
+            if (words >> yaw && !(words >> pitch)) {
+                fail("expected a yaw and a pitch"s);
+            }
+            for (size_t i = first; i < images.size(); ++i) {
+                images[i].camera = { v[0], v[1], v[2] };
+                images[i].yaw = yaw;
+                images[i].pitch = pitch;
+            }
+        } else if (kind == "move"s || kind == "sweep"s) {
+            const auto v = numbers(kind == "move"s ? 4 : 5);
+            if (v[0] < 0 || v[0] > 4294967295.0 || v[0] != std::floor(v[0])) {
+                fail("invalid sphere index"s);
+            }
+            const auto index = static_cast<uint32_t>(v[0]);
+            if (kind == "move"s) {
+                for (size_t i = first; i < images.size(); ++i) {
+                    images[i].moves.push_back(SphereMove { index, v[1], v[2], v[3] });
+                }
+                continue;
+            }
+            if (images.size() - first != 1) {
+                fail("only one sweep can follow an image"s);
+            }
+            if (v[4] < 1 || v[4] > 100000 || v[4] != std::floor(v[4])) {
+                fail("the count must be a whole number from 1 to 100000"s);
+            }
+            const BatchImage base = images.back();
+            images.pop_back();
+            for (int k = 0; k < static_cast<int>(v[4]); ++k) {
+                BatchImage image = base;
+                image.moves.push_back(SphereMove { index, v[1] * k, v[2] * k, v[3] * k });
+                image.output = numbered_filename(base.output, k);
+                images.push_back(image);
+            }
+        } else {
+            fail("unknown line: "s + kind);
+        }
+    }
+    return images;
+}
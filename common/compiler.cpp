@@ -0,0 +1,338 @@
+/*
+ * The bytecode compiler.
+ *
+ * Variables get registers in the order they are first assigned, after the variables that the
+ * program sets. All variables get their registers before any code is generated, so that the
+ * temporary registers, which come after the variables, never overwrite a variable that keeps its
+ * value until the next run.
+ */
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+#include "vm.hpp"
+
+using namespace std::string_literals;
+
+namespace {
+
+class Compiler {
+protected:
+    Bytecode& m_code;
+    const Builtins& m_builtins;
+    const SyntaxTree& m_tree;
+    const std::string_view m_source;
+
+    // The register of each variable, and the builtin function for each function name,
+    // indexed by the interned name, or -1
+    std::vector<int32_t> m_variables;
+    std::vector<int32_t> m_functions;
+
+    std::unordered_map<double, uint32_t> m_constants;
+    std::unordered_map<std::string_view, uint32_t> m_strings;
+
+    size_t m_top = 0; // the first free register
+
+    [[noreturn]] void fail(const Node& n, const std::string& message) const
+    {
+        throw std::runtime_error(
+            "line "s + std::to_string(line_number(m_source, n.position)) + ": "s + message);
+    }
+
+    uint16_t allocate(const Node& n)
+    {
+        if (m_top >= std::numeric_limits<uint16_t>::max()) {
+            fail(n, "too many variables"s);
+        }
+        const auto r = static_cast<uint16_t>(m_top++);
+        if (m_top > m_code.registerCount) {
+            m_code.registerCount = m_top;
+        }
+        return r;
+    }
+
+    void emit(OpCode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0, uint8_t n = 0)
+    {
+        m_code.code.push_back(Instruction { op, n, a, b, c });
+    }
+
+    void emit_wide(OpCode op, uint16_t a, uint32_t wide)
+    {
+        emit(op, a, static_cast<uint16_t>(wide & 0xFFFF), static_cast<uint16_t>(wide >> 16));
+    }
+
+    // The position of the next instruction
+    uint32_t here() const { return static_cast<uint32_t>(m_code.code.size()); }
+
+    // Set the target of the jump at the given position
+    void patch(uint32_t jump, uint32_t target)
+    {
+        m_code.code[jump].b = static_cast<uint16_t>(target & 0xFFFF);
+        m_code.code[jump].c = static_cast<uint16_t>(target >> 16);
+    }
+
+    uint32_t constant(double value)
+    {
+        const auto [it, added] = m_constants.try_emplace(value, m_code.constants.size());
+        if (added) {
+            m_code.constants.push_back(value);
+        }
+        return it->second;
+    }
+
+    uint32_t string(std::string_view text)
+    {
+        const auto [it, added] = m_strings.try_emplace(text, m_code.strings.size());
+        if (added) {
+            m_code.strings.emplace_back(text);
+        }
+        return it->second;
+    }
+
+    std::string name(const Node& n) const { return std::string { m_tree.names.str(n.name) }; }
+
+    uint16_t variable(const Node& n) const
+    {
+        if (m_variables[n.name] < 0) {
+            fail(n, "unknown variable "s + name(n));
+        }
+        return static_cast<uint16_t>(m_variables[n.name]);
+    }
+
+    void add_variable(const Node& n, uint32_t id, std::string_view text)
+    {
+        m_variables[id] = allocate(n);
+        m_code.variables.emplace_back(text);
+    }
+
+    void declare(const Node& n);
+    void expression(const Node& n, uint16_t target);
+    uint16_t operand(const Node& n);
+    void statement(const Node& n);
+
+public:
+    Compiler(Bytecode& code, const Builtins& builtins, const SyntaxTree& tree,
+        std::string_view source)
+        : m_code { code }
+        , m_builtins { builtins }
+        , m_tree { tree }
+        , m_source { source }
+        , m_variables(tree.names.size(), -1)
+        , m_functions(tree.names.size(), -1)
+    {
+        // The variables that the program sets come first, whether the script uses them or not
+        for (const auto& variable : builtins.variables()) {
+            const int64_t id = tree.names.find(variable);
+            if (id >= 0) {
+                m_variables[id] = static_cast<int32_t>(m_code.variables.size());
+            }
+            m_code.variables.push_back(variable);
+        }
+        m_top = m_code.registerCount = m_code.variables.size();
+    }
+
+    void program(const Node& n)
+    {
+        declare(n);
+        statement(n);
+        emit(OpCode::HALT);
+    }
+};
+
+// Give every assigned variable a register
+void Compiler::declare(const Node& n)
+{
+    if (n.type == NodeType::ASSIGN && m_variables[n.name] < 0) {
+        add_variable(n, n.name, m_tree.names.str(n.name));
+    }
+    for (const Node* child : { n.first, n.second, n.third }) {
+        if (child) {
+            declare(*child);
+        }
+    }
+    for (const Node* child : n.children) {
+        declare(*child);
+    }
+}
+
+// Find the register that holds the value of an expression. Variables are used as they are,
+// while other expressions are evaluated into a temporary register. The caller frees the
+// temporary register by restoring m_top.
+uint16_t Compiler::operand(const Node& n)
+{
+    if (n.type == NodeType::NAME) {
+        return variable(n);
+    }
+    const uint16_t r = allocate(n);
+    expression(n, r);
+    return r;
+}
+
+// Evaluate an expression into the target register
+void Compiler::expression(const Node& n, uint16_t target)
+{
+    const size_t top = m_top;
+    switch (n.type) {
+    case NodeType::NUMBER:
+        emit_wide(OpCode::LOADK, target, constant(n.number));
+        break;
+    case NodeType::STRING:
+        emit_wide(OpCode::LOADS, target, string(n.text(m_source)));
+        break;
+    case NodeType::NAME:
+        emit(OpCode::MOVE, target, variable(n));
+        break;
+    case NodeType::NEGATE:
+        emit(OpCode::NEG, target, operand(*n.first));
+        break;
+    case NodeType::BINARY: {
+        const uint16_t left = operand(*n.first);
+        const uint16_t right = operand(*n.second);
+        OpCode op = OpCode::ADD;
+        switch (n.op) {
+        case TokenType::PLUS:
+            op = OpCode::ADD;
+            break;
+        case TokenType::MINUS:
+            op = OpCode::SUB;
+            break;
+        case TokenType::STAR:
+            op = OpCode::MUL;
+            break;
+        case TokenType::SLASH:
+            op = OpCode::DIV;
+            break;
+        case TokenType::LT:
+            op = OpCode::LT;
+            break;
+        case TokenType::GT:
+            op = OpCode::GT;
+            break;
+        case TokenType::LTEQ:
+            op = OpCode::LTEQ;
+            break;
+        case TokenType::GTEQ:
+            op = OpCode::GTEQ;
+            break;
+        case TokenType::EQ:
+            op = OpCode::EQ;
+            break;
+        case TokenType::NOTEQ:
+            op = OpCode::NOTEQ;
+            break;
+        default:
+            fail(n, "invalid operator"s);
+        }
+        emit(op, target, left, right);
+        break;
+    }
+    case NodeType::CALL: {
+        if (m_functions[n.name] < 0) {
+            const auto found = m_builtins.find(m_tree.names.str(n.name));
+            if (!found) {
+                fail(n, "unknown function "s + name(n));
+            }
+            if (*found > std::numeric_limits<uint8_t>::max()) {
+                fail(n, "too many functions"s);
+            }
+            m_functions[n.name] = static_cast<int32_t>(*found);
+        }
+        const auto index = static_cast<size_t>(m_functions[n.name]);
+        const int arity = m_builtins.arity(index);
+        if (arity >= 0 && static_cast<size_t>(arity) != n.children.size()) {
+            fail(n, name(n) + " takes "s + std::to_string(arity) + " arguments"s);
+        }
+        // The arguments go in consecutive registers
+        const auto first = static_cast<uint16_t>(m_top);
+        for (const auto& arg : n.children) {
+            expression(*arg, allocate(*arg));
+        }
+        emit(OpCode::CALL, target, static_cast<uint16_t>(n.children.size()), first,
+            static_cast<uint8_t>(index));
+        break;
+    }
+    default:
+        fail(n, "expected an expression"s);
+    }
+    m_top = top;
+}
+
+void Compiler::statement(const Node& n)
+{
+    const size_t top = m_top;
+    switch (n.type) {
+    case NodeType::ASSIGN:
+        expression(*n.first, static_cast<uint16_t>(m_variables[n.name]));
+        return;
+    case NodeType::BLOCK:
+        for (const Node* child : n.children) {
+            statement(*child);
+        }
+        return;
+    case NodeType::IF: {
+        const uint16_t condition = operand(*n.first);
+        const uint32_t skip = here();
+        emit(OpCode::JUMPIFNOT, condition);
+        m_top = top;
+        statement(*n.second);
+        if (n.third) {
+            const uint32_t end = here();
+            emit(OpCode::JUMP);
+            patch(skip, here());
+            statement(*n.third);
+            patch(end, here());
+        } else {
+            patch(skip, here());
+        }
+        return;
+    }
+    case NodeType::FOR: {
+        const uint32_t start = here();
+        uint32_t exit = 0;
+        if (n.first) {
+            const size_t conditionTop = m_top;
+            const uint16_t condition = operand(*n.first);
+            exit = here();
+            emit(OpCode::JUMPIFNOT, condition);
+            m_top = conditionTop;
+        }
+        statement(*n.second);
+        if (n.third) {
+            statement(*n.third);
+        }
+        emit_wide(OpCode::JUMP, 0, start);
+        if (n.first) {
+            patch(exit, here());
+        }
+        return;
+    }
+    default:
+        // An expression, where the result is not used
+        expression(n, allocate(n));
+        m_top = top;
+        return;
+    }
+}
+
+} // namespace
+
+auto compile(const SyntaxTree& tree, std::string_view source, const Builtins& builtins)
+    -> Bytecode
+{
+    Bytecode code;
+    Compiler { code, builtins, tree, source }.program(*tree.root);
+    return code;
+}
+
+auto compile_script(const Script& script, const Builtins& builtins) -> Bytecode
+{
+    SyntaxTree tree;
+    parse(script.tokens(), script.source(), tree);
+    return compile(tree, script.source(), builtins);
+}
@@ -0,0 +1,87 @@
+// The background thread of ImageWriter
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "imagewriter.hpp"
+
+using namespace std::string_literals;
+
+ImageWriter::ImageWriter()
+    : m_thread { [this] { run(); } }
+{
+}
+
+ImageWriter::~ImageWriter()
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+}
+
+void ImageWriter::write(std::string filename, int width, int height, std::vector<uint8_t> rgb)
+{
+    {
+        std::unique_lock lock { m_mutex };
+        m_changed.wait(lock, [this] { return m_queue.size() < maxQueued; });
+        m_queue.push_back(Image { std::move(filename), width, height, std::move(rgb) });
+    }
+    m_changed.notify_all();
+}
+
+std::vector<std::string> ImageWriter::wait()
+{
+    std::unique_lock lock { m_mutex };
+    m_changed.wait(lock, [this] { return m_queue.empty() && m_writing == 0; });
+    return std::exchange(m_failed, {});
+}
+
+size_t ImageWriter::written()
+{
+    std::lock_guard lock { m_mutex };
+    return m_written;
+}
+
+// Take one image at a time from the queue, and write it without holding the lock
+void ImageWriter::run()
+{
+    while (true) {
+        Image image;
+        {
+            std::unique_lock lock { m_mutex };
+            m_changed.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            image = std::move(m_queue.front());
+            m_queue.pop_front();
+            ++m_writing;
+        }
+        m_changed.notify_all();
+
+        bool ok = false;
+        if (std::FILE* file = std::fopen(image.filename.c_str(), "wb")) {
+            const std::string header = "P6\n"s + std::to_string(image.width) + " "s
+                + std::to_string(image.height) + "\n255\n"s;
+            ok = std::fwrite(header.data(), 1, header.size(), file) == header.size()
+                && std::fwrite(image.rgb.data(), 1, image.rgb.size(), file) == image.rgb.size();
+            ok = std::fclose(file) == 0 && ok;
+        }
+
+        {
+            std::lock_guard lock { m_mutex };
+            --m_writing;
+            if (ok) {
+                ++m_written;
+            } else {
+                m_failed.push_back(image.filename);
+            }
+        }
+        m_changed.notify_all();
+    }
+}
@@ -0,0 +1,244 @@
+/*
+ * A Wavefront OBJ loader for meshes with millions of triangles.
+ *
+ * The file is memory mapped and split into one chunk per thread (or more), at line boundaries.
+ * The first pass counts the vertices and triangles in each chunk. The counts are then summed up,
+ * so that each chunk knows where its vertices and triangles go in the final arrays. The second
+ * pass parses the chunks in parallel, writing straight into the final arrays. This way, the file
+ * is never copied, and there is no merge step.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "omp.h"
+
+#include "mappedfile.hpp"
+#include "objloader.hpp"
+
+using namespace std::string_literals;
+
+namespace {
+
+// A range of whole lines in the file
+struct Chunk {
+    const char* begin;
+    const char* end;
+    size_t vertices = 0; // the number of "v" lines
+    size_t triangles = 0; // the number of triangles, after splitting the faces
+    size_t firstVertex = 0; // the index of the first vertex of this chunk, in the whole file
+    size_t firstTriangle = 0; // the index of the first triangle of this chunk, in the whole file
+    std::string error; // set if the chunk could not be parsed
+};
+
+inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* skip_space(const char* p, const char* end)
+{
+    while (p < end && is_space(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+inline const char* skip_word(const char* p, const char* end)
+{
+    while (p < end && !is_space(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// Find the end of the line that starts at p (the position of the newline, or end)
+inline const char* line_end(const char* p, const char* end)
+{
+    const void* nl = std::memchr(p, '\n', end - p);
+    return nl ? static_cast<const char*>(nl) : end;
+}
+
+// Find where a comment starts on the line that ends at end (the position of the "#", or end)
+inline const char* comment_start(const char* p, const char* end)
+{
+    const void* hash = std::memchr(p, '#', end - p);
+    return hash ? static_cast<const char*>(hash) : end;
+}
+
+// Count the corners of the face on the line that starts after the "f"
+inline size_t count_corners(const char* p, const char* end)
+{
+    size_t n = 0;
+    for (p = skip_space(p, end); p < end; p = skip_space(skip_word(p, end), end)) {
+        ++n;
+    }
+    return n;
+}
+
+// Split the file into chunks that start at the beginning of a line
+auto split(const char* data, size_t size, size_t count) -> std::vector<Chunk>
+{
+    std::vector<Chunk> chunks;
+    const char* end = data + size;
+    const char* begin = data;
+    for (size_t i = 1; i <= count && begin < end; ++i) {
+        const char* chunkEnd = (i == count) ? end : data + size / count * i;
+        if (chunkEnd < begin) {
+            chunkEnd = begin;
+        }
+        if (chunkEnd < end) {
+            chunkEnd = line_end(chunkEnd, end);
+            if (chunkEnd < end) {
+                ++chunkEnd; // include the newline
+            }
+        }
+        chunks.push_back(Chunk { begin, chunkEnd });
+        begin = chunkEnd;
+    }
+    return chunks;
+}
+
+// First pass: count the vertices and triangles in a chunk
+void count(Chunk& chunk)
+{
+    for (const char* p = chunk.begin; p < chunk.end;) {
+        const char* eol = line_end(p, chunk.end);
+        const char* q = skip_space(p, eol);
+        if (eol - q >= 2 && is_space(q[1])) {
+            if (q[0] == 'v') {
+                ++chunk.vertices;
+            } else if (q[0] == 'f') {
+                const size_t corners = count_corners(q + 1, comment_start(q, eol));
+                if (corners >= 3) {
+                    chunk.triangles += corners - 2;
+                }
+            }
+        }
+        p = eol + 1;
+    }
+}
+
+// Parse a face index, which may be followed by a texture coordinate and normal index, like
+// "3/1/2". Negative indices count backwards from the most recent vertex.
+// Returns the 0-based vertex index, or -1 if the index is invalid.
+inline int64_t parse_index(const char*& p, const char* end, size_t currentVertex, size_t total)
+{
+    int64_t index = 0;
+    const auto [next, ec] = std::from_chars(p, end, index);
+    p = skip_word(next, end); // skip "/texture/normal"
+    if (ec != std::errc {} || index == 0) {
+        return -1;
+    }
+    index = (index < 0) ? static_cast<int64_t>(currentVertex) + index : index - 1;
+    if (index < 0 || index >= static_cast<int64_t>(total)) {
+        return -1;
+    }
+    return index;
+}
+
+// Second pass: parse the vertices and faces of a chunk, into their final positions
+void parse(Chunk& chunk, size_t totalVertices, float* xs, float* ys, float* zs, uint32_t* indices)
+{
+    size_t vertex = chunk.firstVertex;
+    size_t index = chunk.firstTriangle * 3;
+    for (const char* p = chunk.begin; p < chunk.end; p = line_end(p, chunk.end) + 1) {
+        const char* eol = line_end(p, chunk.end);
+        const char* q = skip_space(p, eol);
+        if (eol - q < 2 || !is_space(q[1])) {
+            continue; // empty lines, comments, "vt", "vn" and so on
+        }
+        if (q[0] == 'v') {
+            float v[3] = { 0, 0, 0 };
+            q += 1;
+            for (int i = 0; i < 3; ++i) {
+                q = skip_space(q, eol);
+                const auto [next, ec] = std::from_chars(q, eol, v[i]);
+                if (ec != std::errc {}) {
+                    chunk.error = "invalid vertex"s;
+                    return;
+                }
+                q = next;
+            }
+            xs[vertex] = v[0];
+            ys[vertex] = v[1];
+            zs[vertex] = v[2];
+            ++vertex;
+        } else if (q[0] == 'f') {
+            // The indices end where a trailing comment starts
+            const char* faceEnd = comment_start(q, eol);
+            if (count_corners(q + 1, faceEnd) < 3) {
+                continue; // counted as zero triangles in the first pass
+            }
+            // Split the face into a fan of triangles, around the first corner
+            q = skip_space(q + 1, faceEnd);
+            const int64_t first = parse_index(q, faceEnd, vertex, totalVertices);
+            q = skip_space(q, faceEnd);
+            int64_t previous = parse_index(q, faceEnd, vertex, totalVertices);
+            for (q = skip_space(q, faceEnd); q < faceEnd; q = skip_space(q, faceEnd)) {
+                const int64_t current = parse_index(q, faceEnd, vertex, totalVertices);
+                if (first < 0 || previous < 0 || current < 0) {
+                    chunk.error = "invalid face index"s;
+                    return;
+                }
+                indices[index++] = static_cast<uint32_t>(first);
+                indices[index++] = static_cast<uint32_t>(previous);
+                indices[index++] = static_cast<uint32_t>(current);
+                previous = current;
+            }
+        }
+    }
+}
+
+} // namespace
+
+auto load_obj(const std::string& filename) -> Mesh
+{
+    const MappedFile file { filename };
+
+    // Use a few chunks per thread, so that threads that finish early can pick up more work,
+    // but do not bother splitting files that are smaller than 256 KiB per chunk.
+    const size_t maxChunks = static_cast<size_t>(omp_get_max_threads()) * 4;
+    const size_t chunkCount = std::clamp(file.size() / (256 * 1024), size_t { 1 }, maxChunks);
+    std::vector<Chunk> chunks = split(file.data(), file.size(), chunkCount);
+
+    const int n = static_cast<int>(chunks.size());
+
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < n; ++i) {
+        count(chunks[i]);
+    }
+
+    // Find where the vertices and triangles of each chunk go
+    size_t totalVertices = 0;
+    size_t totalTriangles = 0;
+    for (auto& chunk : chunks) {
+        chunk.firstVertex = totalVertices;
+        chunk.firstTriangle = totalTriangles;
+        totalVertices += chunk.vertices;
+        totalTriangles += chunk.triangles;
+    }
+    if (totalVertices > UINT32_MAX) {
+        throw std::runtime_error(filename + ": too many vertices"s);
+    }
+
+    std::vector<float> xs(totalVertices);
+    std::vector<float> ys(totalVertices);
+    std::vector<float> zs(totalVertices);
+    std::vector<uint32_t> indices(totalTriangles * 3);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < n; ++i) {
+        parse(chunks[i], totalVertices, xs.data(), ys.data(), zs.data(), indices.data());
+    }
+
+    for (const auto& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error(filename + ": "s + chunk.error);
+        }
+    }
+
+    return Mesh { std::move(xs), std::move(ys), std::move(zs), std::move(indices) };
+}
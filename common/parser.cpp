@@ -0,0 +1,383 @@
+/*
+ * A recursive descent parser for scripts.
+ *
+ * program    = statement*
+ * statement  = "if" "(" expression ")" block ["else" (block | if)]
+ *            | "for" "(" [simple] ";" [expression] ";" [simple] ")" block
+ *            | block
+ *            | simple [";"]
+ * simple     = NAME "=" expression | expression
+ * block      = "{" statement* "}"
+ * expression = sum [("<" | ">" | "<=" | ">=" | "==" | "!=") sum]
+ * sum        = product (("+" | "-") product)*
+ * product    = unary (("*" | "/") unary)*
+ * unary      = "-" unary | primary
+ * primary    = NUMBER | STRING | NAME ["(" [expression ("," expression)*] ")"] | "(" expression ")"
+ *
+ * The nodes are created in the arena of the syntax tree. While the arguments of a call or the
+ * statements of a block are being parsed, they are collected on a stack that is shared by all
+ * calls and blocks, and then copied to an array in the arena when the call or block is done.
+ * This way, building the tree allocates nothing except arena memory, once the stack has grown.
+ *
+ * The parser and the compiler recurse once for each level of the tree, so the depth of the tree
+ * is limited, to fail with an error instead of overflowing the stack. Parentheses, negations,
+ * blocks, else if and each operator in a chain of operators all count as a level.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast.hpp"
+
+using namespace std::string_literals;
+
+namespace {
+
+class Parser {
+protected:
+    static constexpr size_t maxDepth = 256;
+
+    const std::vector<Token>& m_tokens;
+    const std::string_view m_source;
+    SyntaxTree& m_tree;
+    size_t m_pos = 0;
+    size_t m_depth = 0; // the levels of the tree above the node being parsed
+
+    std::vector<const Node*> m_stack; // the children of the calls and blocks being parsed
+
+    // Where the given token starts in the source
+    size_t position(const Token& tok) const
+    {
+        // String tokens do not include the opening quote
+        const size_t offset = static_cast<size_t>(tok.source.data() - m_source.data());
+        return tok.type == TokenType::STRING ? offset - 1 : offset;
+    }
+
+    // Where the current token starts, or the end of the source
+    size_t position() const
+    {
+        return m_pos < m_tokens.size() ? position(m_tokens[m_pos]) : m_source.size();
+    }
+
+    [[noreturn]] void fail(const std::string& message) const
+    {
+        throw std::runtime_error(
+            "line "s + std::to_string(line_number(m_source, position())) + ": "s + message);
+    }
+
+    bool at(TokenType type) const { return m_pos < m_tokens.size() && m_tokens[m_pos].type == type; }
+
+    bool at_keyword(std::string_view keyword) const
+    {
+        return at(TokenType::KEYWORD) && m_tokens[m_pos].source == keyword;
+    }
+
+    // Go one level deeper into the tree, which fails beyond the deepest that is allowed
+    void deeper()
+    {
+        if (++m_depth > maxDepth) {
+            fail("nested more than "s + std::to_string(maxDepth) + " levels deep"s);
+        }
+    }
+
+    // Level is one level of the tree, for as long as it lives
+    class Level {
+        Parser& m_parser;
+
+    public:
+        explicit Level(Parser& parser)
+            : m_parser { parser }
+        {
+            m_parser.deeper();
+        }
+        ~Level() { --m_parser.m_depth; }
+        Level(const Level&) = delete;
+        Level& operator=(const Level&) = delete;
+    };
+
+    // Consume the current token if it has the given type
+    bool accept(TokenType type)
+    {
+        if (at(type)) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    // Consume the current token, which must have the given type
+    const Token& expect(TokenType type, const char* what)
+    {
+        if (!at(type)) {
+            fail("expected "s + what);
+        }
+        return m_tokens[m_pos++];
+    }
+
+    auto node(NodeType type, size_t pos) -> Node*
+    {
+        Node* n = m_tree.arena.make<Node>();
+        n->type = type;
+        n->position = static_cast<uint32_t>(pos);
+        return n;
+    }
+
+    // Move the children from the given stack position and up into the arena
+    auto children(size_t start) -> std::span<const Node* const>
+    {
+        const auto array = m_tree.arena.array<const Node*>(m_stack.size() - start);
+        std::copy(m_stack.begin() + start, m_stack.end(), array.begin());
+        m_stack.resize(start);
+        return array;
+    }
+
+    auto primary() -> Node*;
+    auto unary() -> Node*;
+    auto product() -> Node*;
+    auto sum() -> Node*;
+    auto expression() -> Node*;
+    auto simple() -> Node*;
+    auto block() -> Node*;
+    auto if_statement() -> Node*;
+    auto for_statement() -> Node*;
+    auto statement() -> Node*;
+
+public:
+    Parser(const std::vector<Token>& tokens, std::string_view source, SyntaxTree& tree)
+        : m_tokens { tokens }
+        , m_source { source }
+        , m_tree { tree }
+    {
+    }
+
+    auto program() -> Node*;
+};
+
+auto Parser::primary() -> Node*
+{
+    const size_t pos = position();
+    if (at(TokenType::NUMBER)) {
+        const std::string_view text = m_tokens[m_pos++].source;
+        auto n = node(NodeType::NUMBER, pos);
+        std::from_chars(text.data(), text.data() + text.size(), n->number);
+        return n;
+    }
+    if (at(TokenType::STRING)) {
+        auto n = node(NodeType::STRING, pos);
+        n->length = static_cast<uint32_t>(m_tokens[m_pos++].source.size());
+        return n;
+    }
+    if (at(TokenType::NAME)) {
+        const uint32_t name = m_tree.names.intern(m_tokens[m_pos++].source);
+        if (!accept(TokenType::PAROPEN)) {
+            auto n = node(NodeType::NAME, pos);
+            n->name = name;
+            return n;
+        }
+        auto n = node(NodeType::CALL, pos);
+        n->name = name;
+        if (!accept(TokenType::PARCLOSE)) {
+            const size_t start = m_stack.size();
+            do {
+                m_stack.push_back(expression());
+            } while (accept(TokenType::COMMA));
+            expect(TokenType::PARCLOSE, ")");
+            n->children = children(start);
+        }
+        return n;
+    }
+    if (accept(TokenType::PAROPEN)) {
+        auto n = expression();
+        expect(TokenType::PARCLOSE, ")");
+        return n;
+    }
+    if (m_pos >= m_tokens.size()) {
+        fail("unexpected end of script");
+    }
+    fail("unexpected \""s + std::string { m_tokens[m_pos].source } + "\""s);
+}
+
+auto Parser::unary() -> Node*
+{
+    const size_t pos = position();
+    if (accept(TokenType::MINUS)) {
+        const Level level { *this };
+        auto n = node(NodeType::NEGATE, pos);
+        n->first = unary();
+        return n;
+    }
+    return primary();
+}
+
+auto Parser::product() -> Node*
+{
+    auto left = unary();
+    const size_t depth = m_depth;
+    while (at(TokenType::STAR) || at(TokenType::SLASH)) {
+        deeper();
+        auto n = node(NodeType::BINARY, position());
+        n->op = m_tokens[m_pos++].type;
+        n->first = left;
+        n->second = unary();
+        left = n;
+    }
+    m_depth = depth;
+    return left;
+}
+
+auto Parser::sum() -> Node*
+{
+    auto left = product();
+    const size_t depth = m_depth;
+    while (at(TokenType::PLUS) || at(TokenType::MINUS)) {
+        deeper();
+        auto n = node(NodeType::BINARY, position());
+        n->op = m_tokens[m_pos++].type;
+        n->first = left;
+        n->second = product();
+        left = n;
+    }
+    m_depth = depth;
+    return left;
+}
+
+auto Parser::expression() -> Node*
+{
+    const Level level { *this };
+    auto left = sum();
+    if (at(TokenType::LT) || at(TokenType::GT) || at(TokenType::LTEQ) || at(TokenType::GTEQ)
+        || at(TokenType::EQ) || at(TokenType::NOTEQ)) {
+        auto n = node(NodeType::BINARY, position());
+        n->op = m_tokens[m_pos++].type;
+        n->first = left;
+        n->second = sum();
+        return n;
+    }
+    return left;
+}
+
+// An assignment or an expression
+auto Parser::simple() -> Node*
+{
+    if (at(TokenType::NAME) && m_pos + 1 < m_tokens.size()
+        && m_tokens[m_pos + 1].type == TokenType::ASSIGN) {
+        auto n = node(NodeType::ASSIGN, position());
+        n->name = m_tree.names.intern(m_tokens[m_pos].source);
+        m_pos += 2;
+        n->first = expression();
+        return n;
+    }
+    return expression();
+}
+
+auto Parser::block() -> Node*
+{
+    const Level level { *this };
+    auto n = node(NodeType::BLOCK, position());
+    expect(TokenType::BLOCKOPEN, "{");
+    const size_t start = m_stack.size();
+    while (!accept(TokenType::BLOCKCLOSE)) {
+        if (m_pos >= m_tokens.size()) {
+            fail("expected }");
+        }
+        m_stack.push_back(statement());
+    }
+    n->children = children(start);
+    return n;
+}
+
+auto Parser::if_statement() -> Node*
+{
+    const Level level { *this };
+    auto n = node(NodeType::IF, position());
+    ++m_pos; // if
+    expect(TokenType::PAROPEN, "( after if");
+    n->first = expression();
+    expect(TokenType::PARCLOSE, ")");
+    n->second = block();
+    if (at_keyword("else")) {
+        ++m_pos;
+        n->third = at_keyword("if") ? if_statement() : block();
+    }
+    return n;
+}
+
+// A loop, which is placed in a block after its initialization, if there is one
+auto Parser::for_statement() -> Node*
+{
+    const size_t pos = position();
+    auto n = node(NodeType::FOR, pos);
+    ++m_pos; // for
+    expect(TokenType::PAROPEN, "( after for");
+    const Node* init = nullptr;
+    if (!at(TokenType::SEMICOLON)) {
+        init = simple();
+    }
+    expect(TokenType::SEMICOLON, ";");
+    if (!at(TokenType::SEMICOLON)) {
+        n->first = expression();
+    }
+    expect(TokenType::SEMICOLON, ";");
+    if (!at(TokenType::PARCLOSE)) {
+        n->third = simple();
+    }
+    expect(TokenType::PARCLOSE, ")");
+    n->second = block();
+    if (!init) {
+        return n;
+    }
+    auto outer = node(NodeType::BLOCK, pos);
+    const size_t start = m_stack.size();
+    m_stack.push_back(init);
+    m_stack.push_back(n);
+    outer->children = children(start);
+    return outer;
+}
+
+auto Parser::statement() -> Node*
+{
+    if (at_keyword("if")) {
+        return if_statement();
+    }
+    if (at_keyword("for")) {
+        return for_statement();
+    }
+    if (at(TokenType::BLOCKOPEN)) {
+        return block();
+    }
+    auto n = simple();
+    accept(TokenType::SEMICOLON); // semicolons are optional
+    return n;
+}
+
+auto Parser::program() -> Node*
+{
+    auto n = node(NodeType::BLOCK, 0);
+    while (m_pos < m_tokens.size()) {
+        m_stack.push_back(statement());
+    }
+    n->children = children(0);
+    return n;
+}
+
+} // namespace
+
+void parse(const std::vector<Token>& tokens, std::string_view source, SyntaxTree& tree)
+{
+    // Free the previous tree, if any
+    tree.root = nullptr;
+    tree.names.clear();
+    tree.arena.reset();
+
+    tree.root = Parser { tokens, source, tree }.program();
+}
+
+auto line_number(std::string_view source, size_t position) -> size_t
+{
+    position = std::min(position, source.size());
+    return 1 + static_cast<size_t>(std::count(source.begin(), source.begin() + position, '\n'));
+}
@@ -0,0 +1,579 @@
+/*
+ * Reading and writing scene files, and parsing text descriptions of scenes.
+ * See include/scenefile.hpp for a description of the file format.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <numbers>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "objloader.hpp"
+#include "scenefile.hpp"
+
+using namespace std::string_literals;
+
+// validate checks that the columns fit together and that every object can be used, so that the
+// scene can be used without any further checks. The vertices, the indices and the triangle blocks
+// are only checked by their lengths, see scenefile.hpp. Throws std::runtime_error if the columns
+// are invalid.
+void SceneView::validate() const
+{
+    const auto require = [](bool ok, const char* what) {
+        if (!ok) {
+            throw std::runtime_error("invalid scene: "s + what);
+        }
+    };
+
+    require(light.size() == 4, "the light needs a position and a radius");
+    require(background.size() == 3, "the background color needs 3 values");
+
+    const size_t materials = materialR.size();
+    require(materialG.size() == materials && materialB.size() == materials,
+        "the material columns differ in length");
+
+    const auto materialsOK = [&](std::span<const uint32_t> column) {
+        return std::all_of(column.begin(), column.end(), [&](uint32_t m) { return m < materials; });
+    };
+
+    // No NaN or infinity in any of the given columns
+    const auto finite = [](std::initializer_list<std::span<const double>> columns) {
+        for (const auto column : columns) {
+            for (const double x : column) {
+                if (!std::isfinite(x)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    // The rotations must be unit quaternions, or the objects would also be scaled
+    const auto unit = [](std::span<const double> qx, std::span<const double> qy,
+                          std::span<const double> qz, std::span<const double> qw) {
+        for (size_t i = 0; i < qx.size(); ++i) {
+            const double lengthSquared
+                = qx[i] * qx[i] + qy[i] * qy[i] + qz[i] * qz[i] + qw[i] * qw[i];
+            if (!(std::fabs(lengthSquared - 1) <= 1e-6)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    require(finite({ light, background, materialR, materialG, materialB }),
+        "the light, the background or a material is not finite");
+
+    const size_t spheres = sphereX.size();
+    require(sphereY.size() == spheres && sphereZ.size() == spheres && sphereR.size() == spheres
+            && sphereMaterial.size() == spheres,
+        "the sphere columns differ in length");
+    require(materialsOK(sphereMaterial), "a sphere has an unknown material");
+    require(finite({ sphereX, sphereY, sphereZ, sphereR }), "a sphere is not finite");
+
+    const size_t planes = planeX.size();
+    require(planeY.size() == planes && planeZ.size() == planes && planeNX.size() == planes
+            && planeNY.size() == planes && planeNZ.size() == planes
+            && planeMaterial.size() == planes,
+        "the plane columns differ in length");
+    require(materialsOK(planeMaterial), "a plane has an unknown material");
+    require(finite({ planeX, planeY, planeZ, planeNX, planeNY, planeNZ }), "a plane is not finite");
+
+    const size_t cubes = cubeX.size();
+    require(cubeY.size() == cubes && cubeZ.size() == cubes && cubeW.size() == cubes
+            && cubeH.size() == cubes && cubeD.size() == cubes && cubeMaterial.size() == cubes,
+        "the cube columns differ in length");
+    require(materialsOK(cubeMaterial), "a cube has an unknown material");
+    require((cubeQX.empty() || cubeQX.size() == cubes) && cubeQY.size() == cubeQX.size()
+            && cubeQZ.size() == cubeQX.size() && cubeQW.size() == cubeQX.size(),
+        "the cube rotation columns differ in length");
+    require(finite({ cubeX, cubeY, cubeZ, cubeW, cubeH, cubeD, cubeQX, cubeQY, cubeQZ, cubeQW }),
+        "a cube is not finite");
+    require(unit(cubeQX, cubeQY, cubeQZ, cubeQW), "a cube rotation is not a unit quaternion");
+
+    const size_t meshes = meshVertexStart.size();
+    require(meshVertexCount.size() == meshes && meshIndexStart.size() == meshes
+            && meshIndexCount.size() == meshes && meshMaterial.size() == meshes,
+        "the mesh columns differ in length");
+    require(materialsOK(meshMaterial), "a mesh has an unknown material");
+    require((meshQX.empty() || meshQX.size() == meshes) && meshQY.size() == meshQX.size()
+            && meshQZ.size() == meshQX.size() && meshQW.size() == meshQX.size(),
+        "the mesh rotation columns differ in length");
+    require(finite({ meshQX, meshQY, meshQZ, meshQW }), "a mesh rotation is not finite");
+    require(unit(meshQX, meshQY, meshQZ, meshQW), "a mesh rotation is not a unit quaternion");
+
+    // The triangle blocks and the bounding boxes are either there for every mesh, or missing
+    const size_t prepared = meshBlockStart.size();
+    require((prepared == 0 || prepared == meshes) && meshBlockCount.size() == prepared
+            && meshMinX.size() == prepared && meshMinY.size() == prepared
+            && meshMinZ.size() == prepared && meshMaxX.size() == prepared
+            && meshMaxY.size() == prepared && meshMaxZ.size() == prepared,
+        "the mesh block columns differ in length");
+    for (const auto column : { meshMinX, meshMinY, meshMinZ, meshMaxX, meshMaxY, meshMaxZ }) {
+        require(std::all_of(column.begin(), column.end(), [](float x) { return std::isfinite(x); }),
+            "the bounding box of a mesh is not finite");
+    }
+
+    const size_t vertices = vertexX.size();
+    require(vertexY.size() == vertices && vertexZ.size() == vertices,
+        "the vertex columns differ in length");
+    for (size_t i = 0; i < meshes; ++i) {
+        require(static_cast<uint64_t>(meshVertexStart[i]) + meshVertexCount[i] <= vertices,
+            "a mesh refers to vertices outside of the vertex columns");
+        require(static_cast<uint64_t>(meshIndexStart[i]) + meshIndexCount[i] <= indices.size()
+                && meshIndexCount[i] % 3 == 0,
+            "a mesh refers to indices outside of the index column");
+        if (prepared != 0) {
+            const size_t triangles = meshIndexCount[i] / 3;
+            require(static_cast<uint64_t>(meshBlockStart[i]) + meshBlockCount[i] <= blocks.size()
+                    && meshBlockCount[i]
+                        == (triangles + TriangleBlock::size - 1) / TriangleBlock::size,
+                "a mesh refers to blocks outside of the block column");
+        }
+    }
+}
+
+// view returns spans that point into the vectors of this SceneData
+const SceneView SceneData::view() const
+{
+    SceneView view;
+    view.light = light;
+    view.background = background;
+    view.materialR = materialR;
+    view.materialG = materialG;
+    view.materialB = materialB;
+    view.sphereX = sphereX;
+    view.sphereY = sphereY;
+    view.sphereZ = sphereZ;
+    view.sphereR = sphereR;
+    view.sphereMaterial = sphereMaterial;
+    view.planeX = planeX;
+    view.planeY = planeY;
+    view.planeZ = planeZ;
+    view.planeNX = planeNX;
+    view.planeNY = planeNY;
+    view.planeNZ = planeNZ;
+    view.planeMaterial = planeMaterial;
+    view.cubeX = cubeX;
+    view.cubeY = cubeY;
+    view.cubeZ = cubeZ;
+    view.cubeW = cubeW;
+    view.cubeH = cubeH;
+    view.cubeD = cubeD;
+    view.cubeMaterial = cubeMaterial;
+    view.cubeQX = cubeQX;
+    view.cubeQY = cubeQY;
+    view.cubeQZ = cubeQZ;
+    view.cubeQW = cubeQW;
+    view.meshVertexStart = meshVertexStart;
+    view.meshVertexCount = meshVertexCount;
+    view.meshIndexStart = meshIndexStart;
+    view.meshIndexCount = meshIndexCount;
+    view.meshMaterial = meshMaterial;
+    view.meshQX = meshQX;
+    view.meshQY = meshQY;
+    view.meshQZ = meshQZ;
+    view.meshQW = meshQW;
+    view.meshBlockStart = meshBlockStart;
+    view.meshBlockCount = meshBlockCount;
+    view.meshMinX = meshMinX;
+    view.meshMinY = meshMinY;
+    view.meshMinZ = meshMinZ;
+    view.meshMaxX = meshMaxX;
+    view.meshMaxY = meshMaxY;
+    view.meshMaxZ = meshMaxZ;
+    view.vertexX = vertexX;
+    view.vertexY = vertexY;
+    view.vertexZ = vertexZ;
+    view.indices = indices;
+    view.blocks = blocks;
+    return view;
+}
+
+MappedScene::MappedScene(const std::string& filename)
+    : m_file { filename }
+{
+    using namespace scenefile;
+
+    const auto fail = [&](const std::string& what) {
+        throw std::runtime_error(filename + ": "s + what);
+    };
+
+    const char* data = m_file.data();
+    const size_t size = m_file.size();
+
+    Header header;
+    if (size < sizeof header) {
+        fail("too short to be a scene file"s);
+    }
+    std::memcpy(&header, data, sizeof header);
+    if (std::memcmp(header.magic, magic, sizeof magic) != 0) {
+        fail("not a scene file"s);
+    }
+    if (header.byteOrder != byteOrderMark) {
+        fail("written on a machine with a different byte order"s);
+    }
+    if (header.version == 0 || header.version > version) {
+        fail("unsupported scene file version "s + std::to_string(header.version));
+    }
+    if (header.fileSize != size
+        || header.columnCount > (size - sizeof header) / sizeof(ColumnEntry)) {
+        fail("the file is truncated"s);
+    }
+
+    // Look up the columns, and point the spans straight into the mapped file
+    const auto* entries = reinterpret_cast<const ColumnEntry*>(data + sizeof header);
+    for_each_column(m_view, [&](Column column, auto& span) {
+        using T = typename std::remove_reference_t<decltype(span)>::element_type;
+        for (uint32_t i = 0; i < header.columnCount; ++i) {
+            const ColumnEntry& entry = entries[i];
+            if (entry.column != static_cast<uint32_t>(column)) {
+                continue;
+            }
+            if (entry.elementSize != sizeof(T) || entry.offset % alignof(T) != 0
+                || entry.offset > size || entry.count > (size - entry.offset) / sizeof(T)) {
+                fail("column "s + std::to_string(entry.column) + " is invalid"s);
+            }
+            span = std::span<T> { reinterpret_cast<T*>(data + entry.offset), entry.count };
+        }
+    });
+
+    try {
+        m_view.validate();
+    } catch (const std::runtime_error& e) {
+        fail(e.what());
+    }
+}
+
+const SceneView& MappedScene::view() const { return m_view; }
+
+void write_scene_file(const SceneView& view, const std::string& filename)
+{
+    using namespace scenefile;
+
+    view.validate();
+
+    // Lay out the column table, then the columns
+    std::vector<ColumnEntry> entries;
+    uint64_t offset = 0;
+    const auto align = [](uint64_t n) { return (n + alignment - 1) / alignment * alignment; };
+    for_each_column(view, [&](Column column, const auto& span) {
+        if (!span.empty()) {
+            entries.push_back(ColumnEntry { static_cast<uint32_t>(column),
+                static_cast<uint32_t>(sizeof(span[0])), span.size(), 0 });
+        }
+    });
+    offset = align(sizeof(Header) + entries.size() * sizeof(ColumnEntry));
+    size_t i = 0;
+    for_each_column(view, [&](Column, const auto& span) {
+        if (!span.empty()) {
+            entries[i++].offset = offset;
+            offset = align(offset + span.size_bytes());
+        }
+    });
+
+    Header header {};
+    std::memcpy(header.magic, magic, sizeof magic);
+    header.version = version;
+    header.byteOrder = byteOrderMark;
+    header.columnCount = static_cast<uint32_t>(entries.size());
+    header.fileSize = offset;
+
+    std::ofstream out { filename, std::ios::binary };
+    if (!out) {
+        throw std::runtime_error("could not create "s + filename);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ColumnEntry));
+    const char padding[alignment] = {};
+    uint64_t written = sizeof header + entries.size() * sizeof(ColumnEntry);
+    i = 0;
+    for_each_column(view, [&](Column, const auto& span) {
+        if (!span.empty()) {
+            out.write(padding, entries[i].offset - written);
+            out.write(reinterpret_cast<const char*>(span.data()), span.size_bytes());
+            written = entries[i].offset + span.size_bytes();
+            ++i;
+        }
+    });
+    out.write(padding, offset - written);
+    if (!out) {
+        throw std::runtime_error("could not write "s + filename);
+    }
+}
+
+auto parse_scene_text(const std::string& filename) -> SceneData
+{
+    std::ifstream in { filename };
+    if (!in) {
+        throw std::runtime_error("could not open "s + filename);
+    }
+
+    // Meshes are loaded relative to the directory of the text file
+    const auto slash = filename.find_last_of('/');
+    const std::string dir = (slash == std::string::npos) ? ""s : filename.substr(0, slash + 1);
+
+    SceneData data;
+    std::unordered_map<std::string, uint32_t> materials;
+
+    // The rotation columns of the previous object, if it can be rotated
+    std::vector<double>* rotation[4] = { nullptr, nullptr, nullptr, nullptr };
+
+    // The material to use if none is given, for each kind of object
+    const auto defaultMaterial = [&](const std::string& name, const RGB color) {
+        if (!materials.contains(name)) {
+            materials[name] = static_cast<uint32_t>(data.materialR.size());
+            data.materialR.push_back(color.R());
+            data.materialG.push_back(color.G());
+            data.materialB.push_back(color.B());
+        }
+        return materials[name];
+    };
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const auto fail = [&](const std::string& what) {
+            throw std::runtime_error(
+                filename + ":"s + std::to_string(lineNumber) + ": "s + what);
+        };
+
+        std::istringstream words { line };
+        std::string kind;
+        if (!(words >> kind) || kind[0] == '#') {
+            continue;
+        }
+
+        // Read the given number of numbers from the rest of the line
+        const auto numbers = [&](size_t n) {
+            std::vector<double> xs(n);
+            for (auto& x : xs) {
+                if (!(words >> x)) {
+                    fail("expected "s + std::to_string(n) + " numbers after "s + kind);
+                }
+            }
+            return xs;
+        };
+
+        // Read an optional material name from the end of the line
+        const auto material = [&](const std::string& fallback, const RGB color) {
+            std::string name;
+            if (!(words >> name)) {
+                return defaultMaterial(fallback, color);
+            }
+            if (!materials.contains(name)) {
+                fail("unknown material "s + name);
+            }
+            return materials[name];
+        };
+
+        if (kind != "rotate"s && kind != "cube"s && kind != "mesh"s) {
+            rotation[0] = nullptr;
+        }
+
+        if (kind == "background"s) {
+            const auto v = numbers(3);
+            data.background = v;
+        } else if (kind == "material"s) {
+            std::string name;
+            if (!(words >> name)) {
+                fail("expected a material name"s);
+            }
+            const auto v = numbers(3);
+            materials[name] = static_cast<uint32_t>(data.materialR.size());
+            data.materialR.push_back(v[0]);
+            data.materialG.push_back(v[1]);
+            data.materialB.push_back(v[2]);
+        } else if (kind == "light"s) {
+            data.light = numbers(4);
+        } else if (kind == "plane"s) {
+            const auto v = numbers(6);
+            data.planeX.push_back(v[0]);
+            data.planeY.push_back(v[1]);
+            data.planeZ.push_back(v[2]);
+            data.planeNX.push_back(v[3]);
+            data.planeNY.push_back(v[4]);
+            data.planeNZ.push_back(v[5]);
+            data.planeMaterial.push_back(material("plane"s, Color::blueish));
+        } else if (kind == "sphere"s) {
+            const auto v = numbers(4);
+            data.sphereX.push_back(v[0]);
+            data.sphereY.push_back(v[1]);
+            data.sphereZ.push_back(v[2]);
+            data.sphereR.push_back(v[3]);
+            data.sphereMaterial.push_back(material("sphere"s, Color::red));
+        } else if (kind == "cube"s) {
+            const auto v = numbers(6);
+            data.cubeX.push_back(v[0]);
+            data.cubeY.push_back(v[1]);
+            data.cubeZ.push_back(v[2]);
+            data.cubeW.push_back(v[3]);
+            data.cubeH.push_back(v[4]);
+            data.cubeD.push_back(v[5]);
+            data.cubeMaterial.push_back(material("cube"s, Color::blueish));
+            for (auto* column : { &data.cubeQX, &data.cubeQY, &data.cubeQZ }) {
+                column->push_back(0);
+            }
+            data.cubeQW.push_back(1);
+            rotation[0] = &data.cubeQX;
+            rotation[1] = &data.cubeQY;
+            rotation[2] = &data.cubeQZ;
+            rotation[3] = &data.cubeQW;
+        } else if (kind == "mesh"s) {
+            std::string objFilename;
+            if (!(words >> objFilename)) {
+                fail("expected an OBJ filename"s);
+            }
+            const auto v = numbers(4);
+            const std::string path = objFilename.starts_with('/') ? objFilename : dir + objFilename;
+            const Mesh mesh = load_obj(path).fit(Point3 { v[0], v[1], v[2] }, v[3]);
+            data.meshVertexStart.push_back(static_cast<uint32_t>(data.vertexX.size()));
+            data.meshVertexCount.push_back(static_cast<uint32_t>(mesh.vertex_count()));
+            data.meshIndexStart.push_back(static_cast<uint32_t>(data.indices.size()));
+            data.meshIndexCount.push_back(static_cast<uint32_t>(mesh.indices().size()));
+            data.meshMaterial.push_back(material("mesh"s, Color::gray));
+            data.meshBlockStart.push_back(static_cast<uint32_t>(data.blocks.size()));
+            data.meshBlockCount.push_back(static_cast<uint32_t>(mesh.blocks().size()));
+            data.meshMinX.push_back(static_cast<float>(mesh.min().x()));
+            data.meshMinY.push_back(static_cast<float>(mesh.min().y()));
+            data.meshMinZ.push_back(static_cast<float>(mesh.min().z()));
+            data.meshMaxX.push_back(static_cast<float>(mesh.max().x()));
+            data.meshMaxY.push_back(static_cast<float>(mesh.max().y()));
+            data.meshMaxZ.push_back(static_cast<float>(mesh.max().z()));
+            for (auto* column : { &data.meshQX, &data.meshQY, &data.meshQZ }) {
+                column->push_back(0);
+            }
+            data.meshQW.push_back(1);
+            rotation[0] = &data.meshQX;
+            rotation[1] = &data.meshQY;
+            rotation[2] = &data.meshQZ;
+            rotation[3] = &data.meshQW;
+            data.vertexX.insert(data.vertexX.end(), mesh.xs().begin(), mesh.xs().end());
+            data.vertexY.insert(data.vertexY.end(), mesh.ys().begin(), mesh.ys().end());
+            data.vertexZ.insert(data.vertexZ.end(), mesh.zs().begin(), mesh.zs().end());
+            data.indices.insert(data.indices.end(), mesh.indices().begin(), mesh.indices().end());
+            data.blocks.insert(data.blocks.end(), mesh.blocks().begin(), mesh.blocks().end());
+        } else if (kind == "rotate"s) {
+            if (!rotation[0]) {
+                fail("rotate must follow a cube or a mesh"s);
+            }
+            const auto v = numbers(4);
+            if (v[0] == 0 && v[1] == 0 && v[2] == 0) {
+                fail("the rotation axis can not be (0, 0, 0)"s);
+            }
+            const Quat previous { rotation[0]->back(), rotation[1]->back(), rotation[2]->back(),
+                rotation[3]->back() };
+            const Quat q
+                = Quat::from_axis_angle(Vec3 { v[0], v[1], v[2] }, v[3] * std::numbers::pi / 180)
+                * previous;
+            rotation[0]->back() = q.x();
+            rotation[1]->back() = q.y();
+            rotation[2]->back() = q.z();
+            rotation[3]->back() = q.w();
+        } else {
+            fail("unknown kind of object: "s + kind);
+        }
+    }
+
+    // Leave out the rotation columns if nothing is rotated
+    const auto unrotated = [](const std::vector<double>& qw) {
+        return std::all_of(qw.begin(), qw.end(), [](double w) { return w == 1; });
+    };
+    if (unrotated(data.cubeQW)) {
+        data.cubeQX.clear();
+        data.cubeQY.clear();
+        data.cubeQZ.clear();
+        data.cubeQW.clear();
+    }
+    if (unrotated(data.meshQW)) {
+        data.meshQX.clear();
+        data.meshQY.clear();
+        data.meshQZ.clear();
+        data.meshQW.clear();
+    }
+    return data;
+}
+
+auto make_scene(const SceneView& view, std::shared_ptr<const void> owner) -> Scene
+{
+    const auto material = [&](uint32_t i) {
+        return RGB { view.materialR[i], view.materialG[i], view.materialB[i] };
+    };
+
+    const Sphere light { view.light[0], view.light[1], view.light[2], view.light[3] };
+
+    // The spheres are read from the columns while tracing
+    const SphereColumns spheres { view.sphereX, view.sphereY, view.sphereZ, view.sphereR,
+        view.sphereMaterial, view.materialR, view.materialG, view.materialB, owner };
+
+    std::vector<Plane> planes;
+    planes.reserve(view.planeX.size());
+    for (size_t i = 0; i < view.planeX.size(); ++i) {
+        planes.emplace_back(view.planeX[i], view.planeY[i], view.planeZ[i], view.planeNX[i],
+            view.planeNY[i], view.planeNZ[i], material(view.planeMaterial[i]));
+    }
+
+    // Scene files from before version 2, and scenes with no rotated objects, have no rotations
+    const auto cubeRotation = [&](size_t i) {
+        return view.cubeQX.empty()
+            ? Quat::identity()
+            : Quat { view.cubeQX[i], view.cubeQY[i], view.cubeQZ[i], view.cubeQW[i] };
+    };
+    const auto meshRotation = [&](size_t i) {
+        return view.meshQX.empty()
+            ? Quat::identity()
+            : Quat { view.meshQX[i], view.meshQY[i], view.meshQZ[i], view.meshQW[i] };
+    };
+
+    std::vector<Cube> cubes;
+    cubes.reserve(view.cubeX.size());
+    for (size_t i = 0; i < view.cubeX.size(); ++i) {
+        cubes.emplace_back(view.cubeX[i], view.cubeY[i], view.cubeZ[i], view.cubeW[i],
+            view.cubeH[i], view.cubeD[i], cubeRotation(i), material(view.cubeMaterial[i]));
+    }
+
+    std::vector<std::shared_ptr<const Mesh>> meshes;
+    for (size_t i = 0; i < view.meshVertexStart.size(); ++i) {
+        const auto x = view.vertexX.subspan(view.meshVertexStart[i], view.meshVertexCount[i]);
+        const auto y = view.vertexY.subspan(view.meshVertexStart[i], view.meshVertexCount[i]);
+        const auto z = view.vertexZ.subspan(view.meshVertexStart[i], view.meshVertexCount[i]);
+        const auto indices = view.indices.subspan(view.meshIndexStart[i], view.meshIndexCount[i]);
+        if (!view.meshBlockStart.empty()) {
+            const auto blocks = view.blocks.subspan(view.meshBlockStart[i], view.meshBlockCount[i]);
+            const Point3 min { view.meshMinX[i], view.meshMinY[i], view.meshMinZ[i] };
+            const Point3 max { view.meshMaxX[i], view.meshMaxY[i], view.meshMaxZ[i] };
+            meshes.push_back(std::make_shared<const Mesh>(x, y, z, indices, blocks, min, max,
+                owner, material(view.meshMaterial[i]), meshRotation(i)));
+            continue;
+        }
+
+        // Files from before version 3 have no triangle blocks, so they are prepared from the
+        // vertices, which means that the indices have to be checked first
+        if (!std::all_of(indices.begin(), indices.end(),
+                [&](uint32_t index) { return index < view.meshVertexCount[i]; })) {
+            throw std::runtime_error("invalid scene: a mesh index is out of range"s);
+        }
+        meshes.push_back(std::make_shared<const Mesh>(std::vector<float>(x.begin(), x.end()),
+            std::vector<float>(y.begin(), y.end()), std::vector<float>(z.begin(), z.end()),
+            std::vector<uint32_t>(indices.begin(), indices.end()), material(view.meshMaterial[i]),
+            meshRotation(i)));
+    }
+
+    const RGB background { view.background[0], view.background[1], view.background[2] };
+    return Scene { light, planes, spheres, cubes, meshes, background };
+}
+
+auto load_scene_file(const std::string& filename) -> Scene
+{
+    const auto mapped = std::make_shared<const MappedScene>(filename);
+    return make_scene(mapped->view(), mapped);
+}
@@ -9,128 +9,165 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "script.hpp"
 
 using namespace std::string_literals;
 
-auto tokenize(const std::string source) -> std::vector<Token>
+namespace {
+
+inline bool is_letter(char r)
+{
+    return (r >= 'a' && r <= 'z') || (r >= 'A' && r <= 'Z') || r == '_';
+}
+
+inline bool is_digit(char r) { return r >= '0' && r <= '9'; }
+
+inline bool is_operator(char r) { return r == '>' || r == '<' || r == '=' || r == '!'; }
+
+// Recognize the keywords, anything else is a name
+inline TokenType keyword_or_name(std::string_view word)
 {
-    std::string kw = ""s; // a keyword
-    std::string digits = ""s; // a number
-    std::string op = ""s; // an operator
-    std::string str = ""s; // a string literal
-    bool inString = false;
+    // TODO: Loop over a list of keywords that can be recognized
+    if (word == "if" || word == "else" || word == "for") {
+        return TokenType::KEYWORD;
+    }
+    return TokenType::NAME;
+}
+
+// Recognize the operators that can be made out of <, >, = and !
+inline TokenType operator_type(std::string_view op)
+{
+    if (op == "=") {
+        return TokenType::ASSIGN;
+    } else if (op == "<") {
+        return TokenType::LT;
+    } else if (op == ">") {
+        return TokenType::GT;
+    } else if (op == "<=") {
+        return TokenType::LTEQ;
+    } else if (op == ">=") {
+        return TokenType::GTEQ;
+    } else if (op == "==") {
+        return TokenType::EQ;
+    } else if (op == "!=") {
+        return TokenType::NOTEQ;
+    }
+    return TokenType::UNRECOGNIZED;
+}
+
+} // namespace
+
+// tokenize splits the source into tokens, in a single pass. Each token is a view into the source,
+// so no characters are copied, and the source must outlive the returned tokens.
+auto tokenize(std::string_view source) -> std::vector<Token>
+{
+    const char* const data = source.data();
+    const size_t size = source.size();
+
     std::vector<Token> tokens;
-    for (auto r : source) {
+    tokens.reserve(size / 4); // scripts have roughly one token per four characters
+
+    size_t i = 0;
+    while (i < size) {
+        const char r = data[i];
+        const size_t start = i;
+
         // First, gather strings, keywords, numbers and names
-        if (!inString && r == '"') {
-            // Start collecting letters between " and "
-            inString = true;
-            continue;
-        } else if (inString && r != '"') {
-            // Collect another letter of the string
-            str += std::string(1, r);
+        if (r == '"') {
+            // Find the closing ", and push the letters between the two as a string token.
+            // An unterminated string continues until the end of the source.
+            const size_t end = source.find('"', start + 1);
+            const size_t stop = (end == std::string_view::npos) ? size : end;
+            tokens.push_back(Token { TokenType::STRING, source.substr(start + 1, stop - start - 1) });
+            i = (end == std::string_view::npos) ? size : end + 1;
             continue;
-        } else if (inString && r == '"') {
-            // No longer collecting, push a string token
-            tokens.push_back(Token { TokenType::STRING, str });
-            str = ""s;
-            inString = false;
-            continue;
-        } else if ((r >= 'a' && r <= 'z') || (r >= 'A' && r <= 'Z')) {
-            // Collect keyword letters
-            kw += std::string(1, r);
+        } else if (is_letter(r)) {
+            // A keyword or name, which may contain digits after the first letter
+            while (i < size && (is_letter(data[i]) || is_digit(data[i]))) {
+                ++i;
+            }
+            const std::string_view word = source.substr(start, i - start);
+            tokens.push_back(Token { keyword_or_name(word), word });
             continue;
-        } else if (r >= '0' && r <= '9') {
-            // Collect number digits
-            digits += std::string(1, r);
+        } else if (is_digit(r)) {
+            // A number, which may have a decimal point
+            while (i < size && is_digit(data[i])) {
+                ++i;
+            }
+            if (i + 1 < size && data[i] == '.' && is_digit(data[i + 1])) {
+                ++i;
+                while (i < size && is_digit(data[i])) {
+                    ++i;
+                }
+            }
+            tokens.push_back(Token { TokenType::NUMBER, source.substr(start, i - start) });
             continue;
-        } else if (r == '>' || r == '<' || r == '=') {
+        } else if (is_operator(r)) {
             // Collect operators longer than 1 rune
-            op += std::string(1, r);
-            continue;
-        } else {
-            // If no longer gathering, push non-empty keywords and numbers, then go on
-            if (!kw.empty()) {
-                // TODO: Loop over a list of keywords that can be recognized
-                if (kw == "if") {
-                    tokens.push_back(Token { TokenType::KEYWORD, kw });
-                } else if (kw == "for") {
-                    tokens.push_back(Token { TokenType::KEYWORD, kw });
-                } else {
-                    // not a recognized keyword, assume it's a name/literal
-                    tokens.push_back(Token { TokenType::NAME, kw });
-                }
-                // then reset the kw string
-                kw = ""s;
-            } else if (!digits.empty()) {
-                tokens.push_back(Token { TokenType::NUMBER, digits });
-                // then reset the digits string
-                digits = ""s;
-            } else if (!op.empty()) {
-                if (op == "<") {
-                    tokens.push_back(Token { TokenType::LT, "<" });
-                } else if (op == ">") {
-                    tokens.push_back(Token { TokenType::GT, ">" });
-                } else if (op == "<=") {
-                    tokens.push_back(Token { TokenType::LTEQ, "<=" });
-                } else if (op == ">=") {
-                    tokens.push_back(Token { TokenType::GTEQ, ">=" });
-                } else if (op == "==") {
-                    tokens.push_back(Token { TokenType::EQ, "==" });
-                }
-                // then reset the operator string
-                op = ""s;
+            while (i < size && is_operator(data[i])) {
+                ++i;
             }
+            const std::string_view op = source.substr(start, i - start);
+            tokens.push_back(Token { operator_type(op), op });
+            continue;
+        } else if (r == '/' && i + 1 < size && data[i + 1] == '/') {
+            // Skip comments, until the end of the line
+            const size_t end = source.find('\n', start);
+            i = (end == std::string_view::npos) ? size : end;
+            continue;
         }
+
         // Then handle the other characters that aren't collectable strings
+        const std::string_view one = source.substr(start, 1);
         switch (r) {
         case ';':
-            tokens.push_back(Token { TokenType::SEMICOLON, ";" });
+            tokens.push_back(Token { TokenType::SEMICOLON, one });
+            break;
+        case ',':
+            tokens.push_back(Token { TokenType::COMMA, one });
             break;
         case '(':
-            tokens.push_back(Token { TokenType::PAROPEN, "(" });
+            tokens.push_back(Token { TokenType::PAROPEN, one });
             break;
         case ')':
-            tokens.push_back(Token { TokenType::PARCLOSE, ")" });
+            tokens.push_back(Token { TokenType::PARCLOSE, one });
             break;
         case '{':
-            tokens.push_back(Token { TokenType::BLOCKOPEN, "{" });
+            tokens.push_back(Token { TokenType::BLOCKOPEN, one });
             break;
         case '}':
-            tokens.push_back(Token { TokenType::BLOCKCLOSE, "}" });
+            tokens.push_back(Token { TokenType::BLOCKCLOSE, one });
+            break;
+        case '+':
+            tokens.push_back(Token { TokenType::PLUS, one });
+            break;
+        case '-':
+            tokens.push_back(Token { TokenType::MINUS, one });
+            break;
+        case '*':
+            tokens.push_back(Token { TokenType::STAR, one });
+            break;
+        case '/':
+            tokens.push_back(Token { TokenType::SLASH, one });
             break;
         case ' ':
         case '\t':
+        case '\r':
         case '\n':
             // Ignore whitespace and newlines
             break;
         default:
             // Unrecognized runes
-            tokens.push_back(Token { TokenType::UNRECOGNIZED, std::string(1, r) });
+            tokens.push_back(Token { TokenType::UNRECOGNIZED, one });
             std::cout << "UNRECOGNIZED LETTER: "s << r << std::endl;
             break;
         }
-    }
-
-    // Final token push, for gathered keywords and numbers
-    if (!kw.empty()) {
-        tokens.push_back(Token { TokenType::KEYWORD, kw });
-    } else if (!digits.empty()) {
-        tokens.push_back(Token { TokenType::NUMBER, digits });
+        ++i;
     }
 
     // Return all tokens
     return tokens;
 }
-
-auto interpret(std::vector<Token> tokens) -> int
-{
-    for (auto tok : tokens) {
-        std::cout << "TOKEN "s << tok.source << " ("s << tok.type << ")"s << std::endl;
-    }
-    // success
-    return 0;
-}
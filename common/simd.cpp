@@ -0,0 +1,849 @@
+// The SIMD kernels, one version per instruction set, and selecting between them at startup.
+//
+// Only this file uses instruction set specific code. Each version is compiled with a target
+// attribute, so the rest of the program is still built for any x86-64 CPU, and the version that
+// is used is picked with CPUID when the program starts.
+//
+// The versions must give the same results, bit for bit. They do the same operations in the same
+// order as the scalar version, and fused multiply-add is not used, since it rounds differently.
+// Like the scalar version, they skip the square root and the division when no sphere is hit,
+// which is the common case. The color conversion only uses integers, so it is exact anyway.
+// The tone mapping curves only use IEEE operations that round exactly, divisions included.
+//
+// The AVX versions clear the upper halves of the registers before they call scalar code, and
+// before they return. GCC does not always do that by itself for functions with a target
+// attribute, and all the SSE code that runs after that, in any function, gets much slower.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#include "simd.hpp"
+
+using namespace std::string_literals;
+
+namespace {
+
+using ClosestSphere = size_t (*)(const SphereLanes&, const Vec3a&, double&);
+using ArgbToYuv420 = void (*)(const uint32_t*, int, int, uint8_t*, uint8_t*, uint8_t*);
+using PackArgb
+    = void (*)(const float*, const float*, const float*, size_t, const uint32_t*, uint32_t*);
+using ToneMapChannel = void (*)(float*, size_t, ToneMap, float);
+
+// For looking up a color from 0 to 255 in a gamma table
+constexpr float lutScale = (gammaLutSize - 1) / 255.0f;
+
+// reduce picks the closest hit from the best hit of each lane. Each lane only has the first of its
+// closest hits, so picking the smallest index among the equally close ones gives the first one.
+size_t reduce(const double* best, const double* index, size_t width, size_t count, double& t)
+{
+    size_t closest = count;
+    t = std::numeric_limits<double>::infinity();
+    for (size_t lane = 0; lane < width; ++lane) {
+        if (best[lane] < t || (best[lane] == t && index[lane] < static_cast<double>(closest))) {
+            t = best[lane];
+            closest = static_cast<size_t>(index[lane]);
+        }
+    }
+    return closest;
+}
+
+size_t closest_sphere_scalar(const SphereLanes& lanes, const Vec3a& d, double& t)
+{
+    const double a = d.x * d.x + d.y * d.y + d.z * d.z;
+    double best = std::numeric_limits<double>::infinity();
+    size_t closest = lanes.count;
+    for (size_t i = 0; i < lanes.count; ++i) {
+        const double b = d.x * lanes.x[i] + d.y * lanes.y[i] + d.z * lanes.z[i];
+        const double discriminant = b * b - a * lanes.c[i];
+        if (discriminant <= 0) {
+            continue;
+        }
+        const double ti = (b - std::sqrt(discriminant)) / a;
+        if (ti >= 0 && ti < best) {
+            best = ti;
+            closest = i;
+        }
+    }
+    t = best;
+    return closest;
+}
+
+// The BT.601 conversion from RGB to studio range YUV, in 8.8 fixed point, as video players
+// expect it. The shifts of negative numbers round down, just like the SIMD versions do.
+int luma(int r, int g, int b) { return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16; }
+int chromaU(int r, int g, int b) { return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128; }
+int chromaV(int r, int g, int b) { return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128; }
+
+// lumaRow converts the pixels from x to width of a row
+void lumaRow(const uint32_t* row, int x, int width, uint8_t* y)
+{
+    for (; x < width; ++x) {
+        const uint32_t p = row[x];
+        y[x] = static_cast<uint8_t>(luma((p >> 16) & 0xFF, (p >> 8) & 0xFF, p & 0xFF));
+    }
+}
+
+// chromaRow converts the pixels of two rows to one row of chroma, from chroma sample cx to the
+// end. Each sample is the average of 2x2 pixels, and if the width is odd, the last sample is
+// the average of the last pixel of each row, counted twice.
+void chromaRow(const uint32_t* row0, const uint32_t* row1, int cx, int width, uint8_t* u,
+    uint8_t* v)
+{
+    for (; cx < (width + 1) / 2; ++cx) {
+        const int x0 = cx * 2;
+        const int x1 = std::min(x0 + 1, width - 1);
+        int r = 0;
+        int g = 0;
+        int b = 0;
+        for (const uint32_t p : { row0[x0], row0[x1], row1[x0], row1[x1] }) {
+            r += static_cast<int>((p >> 16) & 0xFF);
+            g += static_cast<int>((p >> 8) & 0xFF);
+            b += static_cast<int>(p & 0xFF);
+        }
+        r = (r + 2) >> 2;
+        g = (g + 2) >> 2;
+        b = (b + 2) >> 2;
+        u[cx] = static_cast<uint8_t>(chromaU(r, g, b));
+        v[cx] = static_cast<uint8_t>(chromaV(r, g, b));
+    }
+}
+
+void argb_to_yuv420_scalar(
+    const uint32_t* argb, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v)
+{
+    const int chromaWidth = (width + 1) / 2;
+    for (int row = 0; row < height; ++row) {
+        lumaRow(argb + static_cast<size_t>(row) * width, 0, width,
+            y + static_cast<size_t>(row) * width);
+    }
+    for (int cy = 0; cy < (height + 1) / 2; ++cy) {
+        const uint32_t* row0 = argb + static_cast<size_t>(cy * 2) * width;
+        const uint32_t* row1
+            = argb + static_cast<size_t>(std::min(cy * 2 + 1, height - 1)) * width;
+        chromaRow(row0, row1, 0, width, u + static_cast<size_t>(cy) * chromaWidth,
+            v + static_cast<size_t>(cy) * chromaWidth);
+    }
+}
+
+// channel clamps a color to 0..255, and turns it into a byte, or looks it up. NaN becomes 0, like
+// it does with the SIMD max instructions, which return the second operand if one is NaN.
+uint32_t channel(float c, const uint32_t* lut)
+{
+    const float x = std::min(c > 0 ? c : 0.0f, 255.0f);
+    return lut ? lut[static_cast<int>(x * lutScale)] : static_cast<uint32_t>(x);
+}
+
+void pack_argb_scalar(const float* r, const float* g, const float* b, size_t count,
+    const uint32_t* lut, uint32_t* argb)
+{
+    for (size_t i = 0; i < count; ++i) {
+        argb[i] = 0xFF000000 | (channel(r[i], lut) << 16) | (channel(g[i], lut) << 8)
+            | channel(b[i], lut);
+    }
+}
+
+// tone maps one color. The curves are for colors where 1 is white, so the scale is the exposure
+// divided by 255, and the result is multiplied by 255 again.
+float tone(float c, ToneMap curve, float scale)
+{
+    const float x = c * scale;
+    const float y = x > 0 ? x : 0.0f;
+    switch (curve) {
+    case ToneMap::REINHARD:
+        return y / (y + 1.0f) * 255.0f;
+    case ToneMap::ACES:
+        return y * (y * 2.51f + 0.03f) / (y * (y * 2.43f + 0.59f) + 0.14f) * 255.0f;
+    default:
+        return y * 255.0f;
+    }
+}
+
+void tone_map_scalar(float* c, size_t count, ToneMap curve, float scale)
+{
+    for (size_t i = 0; i < count; ++i) {
+        c[i] = tone(c[i], curve, scale);
+    }
+}
+
+#ifdef SIMD_X86
+
+__attribute__((target("sse4.2"))) size_t closest_sphere_sse42(
+    const SphereLanes& lanes, const Vec3a& d, double& t)
+{
+    const __m128d dx = _mm_set1_pd(d.x);
+    const __m128d dy = _mm_set1_pd(d.y);
+    const __m128d dz = _mm_set1_pd(d.z);
+    const __m128d a = _mm_set1_pd(d.x * d.x + d.y * d.y + d.z * d.z);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d step = _mm_set1_pd(2);
+    __m128d best = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    __m128d bestIndex = _mm_set1_pd(static_cast<double>(lanes.count));
+    __m128d index = _mm_setr_pd(0, 1);
+    for (size_t i = 0; i < lanes.count; i += 2) {
+        const __m128d bx = _mm_mul_pd(dx, _mm_load_pd(lanes.x + i));
+        const __m128d by = _mm_mul_pd(dy, _mm_load_pd(lanes.y + i));
+        const __m128d bz = _mm_mul_pd(dz, _mm_load_pd(lanes.z + i));
+        const __m128d b = _mm_add_pd(_mm_add_pd(bx, by), bz);
+        const __m128d discriminant
+            = _mm_sub_pd(_mm_mul_pd(b, b), _mm_mul_pd(a, _mm_load_pd(lanes.c + i)));
+        const __m128d crosses = _mm_cmpgt_pd(discriminant, zero);
+        if (_mm_movemask_pd(crosses) == 0) {
+            index = _mm_add_pd(index, step);
+            continue;
+        }
+        const __m128d ti = _mm_div_pd(_mm_sub_pd(b, _mm_sqrt_pd(discriminant)), a);
+        const __m128d hit = _mm_and_pd(
+            crosses, _mm_and_pd(_mm_cmpge_pd(ti, zero), _mm_cmplt_pd(ti, best)));
+        best = _mm_blendv_pd(best, ti, hit);
+        bestIndex = _mm_blendv_pd(bestIndex, index, hit);
+        index = _mm_add_pd(index, step);
+    }
+    alignas(16) double bests[2];
+    alignas(16) double indices[2];
+    _mm_store_pd(bests, best);
+    _mm_store_pd(indices, bestIndex);
+    return reduce(bests, indices, 2, lanes.count, t);
+}
+
+__attribute__((target("avx2"))) size_t closest_sphere_avx2(
+    const SphereLanes& lanes, const Vec3a& d, double& t)
+{
+    const __m256d dx = _mm256_set1_pd(d.x);
+    const __m256d dy = _mm256_set1_pd(d.y);
+    const __m256d dz = _mm256_set1_pd(d.z);
+    const __m256d a = _mm256_set1_pd(d.x * d.x + d.y * d.y + d.z * d.z);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d step = _mm256_set1_pd(4);
+    __m256d best = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d bestIndex = _mm256_set1_pd(static_cast<double>(lanes.count));
+    __m256d index = _mm256_setr_pd(0, 1, 2, 3);
+    for (size_t i = 0; i < lanes.count; i += 4) {
+        const __m256d bx = _mm256_mul_pd(dx, _mm256_load_pd(lanes.x + i));
+        const __m256d by = _mm256_mul_pd(dy, _mm256_load_pd(lanes.y + i));
+        const __m256d bz = _mm256_mul_pd(dz, _mm256_load_pd(lanes.z + i));
+        const __m256d b = _mm256_add_pd(_mm256_add_pd(bx, by), bz);
+        const __m256d discriminant
+            = _mm256_sub_pd(_mm256_mul_pd(b, b), _mm256_mul_pd(a, _mm256_load_pd(lanes.c + i)));
+        const __m256d crosses = _mm256_cmp_pd(discriminant, zero, _CMP_GT_OQ);
+        if (_mm256_movemask_pd(crosses) == 0) {
+            index = _mm256_add_pd(index, step);
+            continue;
+        }
+        const __m256d ti = _mm256_div_pd(_mm256_sub_pd(b, _mm256_sqrt_pd(discriminant)), a);
+        const __m256d hit = _mm256_and_pd(crosses,
+            _mm256_and_pd(
+                _mm256_cmp_pd(ti, zero, _CMP_GE_OQ), _mm256_cmp_pd(ti, best, _CMP_LT_OQ)));
+        best = _mm256_blendv_pd(best, ti, hit);
+        bestIndex = _mm256_blendv_pd(bestIndex, index, hit);
+        index = _mm256_add_pd(index, step);
+    }
+    alignas(32) double bests[4];
+    alignas(32) double indices[4];
+    _mm256_store_pd(bests, best);
+    _mm256_store_pd(indices, bestIndex);
+    return reduce(bests, indices, 4, lanes.count, t);
+}
+
+// AVX-512 comes with fused multiply-add, which the compiler would otherwise use for b * b - a * c.
+// The sqrt intrinsic starts from an undefined register, which some versions of GCC warn about.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f"), optimize("fp-contract=off"))) size_t closest_sphere_avx512(
+    const SphereLanes& lanes, const Vec3a& d, double& t)
+{
+    const __m512d dx = _mm512_set1_pd(d.x);
+    const __m512d dy = _mm512_set1_pd(d.y);
+    const __m512d dz = _mm512_set1_pd(d.z);
+    const __m512d a = _mm512_set1_pd(d.x * d.x + d.y * d.y + d.z * d.z);
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d step = _mm512_set1_pd(8);
+    __m512d best = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    __m512d bestIndex = _mm512_set1_pd(static_cast<double>(lanes.count));
+    __m512d index = _mm512_setr_pd(0, 1, 2, 3, 4, 5, 6, 7);
+    for (size_t i = 0; i < lanes.count; i += 8) {
+        const __m512d bx = _mm512_mul_pd(dx, _mm512_load_pd(lanes.x + i));
+        const __m512d by = _mm512_mul_pd(dy, _mm512_load_pd(lanes.y + i));
+        const __m512d bz = _mm512_mul_pd(dz, _mm512_load_pd(lanes.z + i));
+        const __m512d b = _mm512_add_pd(_mm512_add_pd(bx, by), bz);
+        const __m512d discriminant
+            = _mm512_sub_pd(_mm512_mul_pd(b, b), _mm512_mul_pd(a, _mm512_load_pd(lanes.c + i)));
+        const __mmask8 crosses = _mm512_cmp_pd_mask(discriminant, zero, _CMP_GT_OQ);
+        if (crosses == 0) {
+            index = _mm512_add_pd(index, step);
+            continue;
+        }
+        const __m512d ti = _mm512_div_pd(_mm512_sub_pd(b, _mm512_sqrt_pd(discriminant)), a);
+        const __mmask8 hit = crosses & _mm512_cmp_pd_mask(ti, zero, _CMP_GE_OQ)
+            & _mm512_cmp_pd_mask(ti, best, _CMP_LT_OQ);
+        best = _mm512_mask_blend_pd(hit, best, ti);
+        bestIndex = _mm512_mask_blend_pd(hit, bestIndex, index);
+        index = _mm512_add_pd(index, step);
+    }
+    alignas(64) double bests[8];
+    alignas(64) double indices[8];
+    _mm512_store_pd(bests, best);
+    _mm512_store_pd(indices, bestIndex);
+    return reduce(bests, indices, 8, lanes.count, t);
+}
+#pragma GCC diagnostic pop
+
+// The color conversion works on 32-bit integers, four pixels at a time with SSE4.2 and eight with
+// AVX2. For chroma, the pixels of two rows are added up, and then neighbouring pixels are added
+// with a horizontal add. The ends of the rows are converted by the scalar code. AVX-512 uses the
+// AVX2 version, since the conversion is limited by memory rather than by arithmetic.
+
+// store4 stores the lowest byte of each 32-bit number
+__attribute__((target("sse4.2"))) inline void store4(__m128i x, uint8_t* dst)
+{
+    const __m128i bytes = _mm_shuffle_epi8(
+        x, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const int packed = _mm_cvtsi128_si32(bytes);
+    std::memcpy(dst, &packed, 4);
+}
+
+// channels4 splits four pixels into red, green and blue
+__attribute__((target("sse4.2"))) inline void channels4(
+    const uint32_t* pixels, __m128i& r, __m128i& g, __m128i& b)
+{
+    const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    r = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+    g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+    b = _mm_and_si128(p, mask);
+}
+
+// average4 averages 2x2 pixels, from four pixels of two rows in a and the next four in b
+__attribute__((target("sse4.2"))) inline __m128i average4(
+    __m128i a0, __m128i a1, __m128i b0, __m128i b1)
+{
+    const __m128i sums = _mm_hadd_epi32(_mm_add_epi32(a0, a1), _mm_add_epi32(b0, b1));
+    return _mm_srli_epi32(_mm_add_epi32(sums, _mm_set1_epi32(2)), 2);
+}
+
+// yuv4 converts the red, green and blue of four pixels
+__attribute__((target("sse4.2"))) inline __m128i yuv4(
+    __m128i r, __m128i g, __m128i b, int kr, int kg, int kb, int offset)
+{
+    const __m128i rg = _mm_add_epi32(
+        _mm_mullo_epi32(r, _mm_set1_epi32(kr)), _mm_mullo_epi32(g, _mm_set1_epi32(kg)));
+    const __m128i sum = _mm_add_epi32(
+        rg, _mm_add_epi32(_mm_mullo_epi32(b, _mm_set1_epi32(kb)), _mm_set1_epi32(128)));
+    return _mm_add_epi32(_mm_srai_epi32(sum, 8), _mm_set1_epi32(offset));
+}
+
+__attribute__((target("sse4.2"))) void argb_to_yuv420_sse42(
+    const uint32_t* argb, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v)
+{
+    const int chromaWidth = (width + 1) / 2;
+    for (int row = 0; row < height; ++row) {
+        const uint32_t* src = argb + static_cast<size_t>(row) * width;
+        uint8_t* dst = y + static_cast<size_t>(row) * width;
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            __m128i r, g, b;
+            channels4(src + x, r, g, b);
+            store4(yuv4(r, g, b, 66, 129, 25, 16), dst + x);
+        }
+        lumaRow(src, x, width, dst);
+    }
+    for (int cy = 0; cy < (height + 1) / 2; ++cy) {
+        const uint32_t* row0 = argb + static_cast<size_t>(cy * 2) * width;
+        const uint32_t* row1
+            = argb + static_cast<size_t>(std::min(cy * 2 + 1, height - 1)) * width;
+        uint8_t* du = u + static_cast<size_t>(cy) * chromaWidth;
+        uint8_t* dv = v + static_cast<size_t>(cy) * chromaWidth;
+        int cx = 0;
+        for (; cx * 2 + 8 <= width; cx += 4) {
+            __m128i r0, g0, b0, r1, g1, b1, r2, g2, b2, r3, g3, b3;
+            channels4(row0 + cx * 2, r0, g0, b0);
+            channels4(row1 + cx * 2, r1, g1, b1);
+            channels4(row0 + cx * 2 + 4, r2, g2, b2);
+            channels4(row1 + cx * 2 + 4, r3, g3, b3);
+            const __m128i r = average4(r0, r1, r2, r3);
+            const __m128i g = average4(g0, g1, g2, g3);
+            const __m128i b = average4(b0, b1, b2, b3);
+            store4(yuv4(r, g, b, -38, -74, 112, 128), du + cx);
+            store4(yuv4(r, g, b, 112, -94, -18, 128), dv + cx);
+        }
+        chromaRow(row0, row1, cx, width, du, dv);
+    }
+}
+
+// store8 stores the lowest byte of each 32-bit number
+__attribute__((target("avx2"))) inline void store8(__m256i x, uint8_t* dst)
+{
+    const __m256i bytes = _mm256_shuffle_epi8(x,
+        _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8,
+            12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m256i packed
+        = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(packed));
+}
+
+// channels8 splits eight pixels into red, green and blue
+__attribute__((target("avx2"))) inline void channels8(
+    const uint32_t* pixels, __m256i& r, __m256i& g, __m256i& b)
+{
+    const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels));
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    r = _mm256_and_si256(_mm256_srli_epi32(p, 16), mask);
+    g = _mm256_and_si256(_mm256_srli_epi32(p, 8), mask);
+    b = _mm256_and_si256(p, mask);
+}
+
+// average8 averages 2x2 pixels, from eight pixels of two rows in a and the next eight in b. The
+// horizontal add works within each 128-bit half, so the 64-bit parts of the sums are put back in
+// order afterwards.
+__attribute__((target("avx2"))) inline __m256i average8(
+    __m256i a0, __m256i a1, __m256i b0, __m256i b1)
+{
+    const __m256i sums = _mm256_hadd_epi32(_mm256_add_epi32(a0, a1), _mm256_add_epi32(b0, b1));
+    const __m256i ordered = _mm256_permute4x64_epi64(sums, _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm256_srli_epi32(_mm256_add_epi32(ordered, _mm256_set1_epi32(2)), 2);
+}
+
+// yuv8 converts the red, green and blue of eight pixels
+__attribute__((target("avx2"))) inline __m256i yuv8(
+    __m256i r, __m256i g, __m256i b, int kr, int kg, int kb, int offset)
+{
+    const __m256i rg = _mm256_add_epi32(
+        _mm256_mullo_epi32(r, _mm256_set1_epi32(kr)), _mm256_mullo_epi32(g, _mm256_set1_epi32(kg)));
+    const __m256i sum = _mm256_add_epi32(
+        rg, _mm256_add_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(kb)), _mm256_set1_epi32(128)));
+    return _mm256_add_epi32(_mm256_srai_epi32(sum, 8), _mm256_set1_epi32(offset));
+}
+
+__attribute__((target("avx2"))) void argb_to_yuv420_avx2(
+    const uint32_t* argb, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v)
+{
+    const int chromaWidth = (width + 1) / 2;
+    for (int row = 0; row < height; ++row) {
+        const uint32_t* src = argb + static_cast<size_t>(row) * width;
+        uint8_t* dst = y + static_cast<size_t>(row) * width;
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m256i r, g, b;
+            channels8(src + x, r, g, b);
+            store8(yuv8(r, g, b, 66, 129, 25, 16), dst + x);
+        }
+        _mm256_zeroupper();
+        lumaRow(src, x, width, dst);
+    }
+    for (int cy = 0; cy < (height + 1) / 2; ++cy) {
+        const uint32_t* row0 = argb + static_cast<size_t>(cy * 2) * width;
+        const uint32_t* row1
+            = argb + static_cast<size_t>(std::min(cy * 2 + 1, height - 1)) * width;
+        uint8_t* du = u + static_cast<size_t>(cy) * chromaWidth;
+        uint8_t* dv = v + static_cast<size_t>(cy) * chromaWidth;
+        int cx = 0;
+        for (; cx * 2 + 16 <= width; cx += 8) {
+            __m256i r0, g0, b0, r1, g1, b1, r2, g2, b2, r3, g3, b3;
+            channels8(row0 + cx * 2, r0, g0, b0);
+            channels8(row1 + cx * 2, r1, g1, b1);
+            channels8(row0 + cx * 2 + 8, r2, g2, b2);
+            channels8(row1 + cx * 2 + 8, r3, g3, b3);
+            const __m256i r = average8(r0, r1, r2, r3);
+            const __m256i g = average8(g0, g1, g2, g3);
+            const __m256i b = average8(b0, b1, b2, b3);
+            store8(yuv8(r, g, b, -38, -74, 112, 128), du + cx);
+            store8(yuv8(r, g, b, 112, -94, -18, 128), dv + cx);
+        }
+        _mm256_zeroupper();
+        chromaRow(row0, row1, cx, width, du, dv);
+    }
+}
+
+// The pack kernels handle four, eight or sixteen pixels at a time. SSE4.2 has no gather, so the
+// table is read one channel at a time there. The pixels at the end are packed by the scalar code.
+
+// clamp4 clamps four colors to 0..255 and turns them into integers, or looks them up
+__attribute__((target("sse4.2"))) inline __m128i clamp4(const float* c, const uint32_t* lut)
+{
+    const __m128 x
+        = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(c), _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    if (!lut) {
+        return _mm_cvttps_epi32(x);
+    }
+    alignas(16) int32_t index[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(index),
+        _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(lutScale))));
+    return _mm_setr_epi32(static_cast<int>(lut[index[0]]), static_cast<int>(lut[index[1]]),
+        static_cast<int>(lut[index[2]]), static_cast<int>(lut[index[3]]));
+}
+
+__attribute__((target("sse4.2"))) void pack_argb_sse42(const float* r, const float* g,
+    const float* b, size_t count, const uint32_t* lut, uint32_t* argb)
+{
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i rg = _mm_or_si128(
+            _mm_slli_epi32(clamp4(r + i, lut), 16), _mm_slli_epi32(clamp4(g + i, lut), 8));
+        const __m128i pixels = _mm_or_si128(_mm_or_si128(rg, clamp4(b + i, lut)), alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(argb + i), pixels);
+    }
+    pack_argb_scalar(r + i, g + i, b + i, count - i, lut, argb + i);
+}
+
+// tone4 maps four colors, like tone does
+__attribute__((target("sse4.2"))) inline __m128 tone4(__m128 c, ToneMap curve, __m128 scale)
+{
+    const __m128 y = _mm_max_ps(_mm_mul_ps(c, scale), _mm_setzero_ps());
+    const __m128 white = _mm_set1_ps(255.0f);
+    switch (curve) {
+    case ToneMap::REINHARD:
+        return _mm_mul_ps(_mm_div_ps(y, _mm_add_ps(y, _mm_set1_ps(1.0f))), white);
+    case ToneMap::ACES: {
+        const __m128 numerator
+            = _mm_mul_ps(y, _mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+        const __m128 inner = _mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f));
+        const __m128 denominator = _mm_add_ps(_mm_mul_ps(y, inner), _mm_set1_ps(0.14f));
+        return _mm_mul_ps(_mm_div_ps(numerator, denominator), white);
+    }
+    default:
+        return _mm_mul_ps(y, white);
+    }
+}
+
+__attribute__((target("sse4.2"))) void tone_map_sse42(
+    float* c, size_t count, ToneMap curve, float scale)
+{
+    const __m128 s = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(c + i, tone4(_mm_loadu_ps(c + i), curve, s));
+    }
+    tone_map_scalar(c + i, count - i, curve, scale);
+}
+
+// clamp8 clamps eight colors to 0..255 and turns them into integers, or looks them up
+__attribute__((target("avx2"))) inline __m256i clamp8(const float* c, const uint32_t* lut)
+{
+    const __m256 x = _mm256_min_ps(
+        _mm256_max_ps(_mm256_loadu_ps(c), _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    if (!lut) {
+        return _mm256_cvttps_epi32(x);
+    }
+    const __m256i index = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(lutScale)));
+    return _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), index, 4);
+}
+
+__attribute__((target("avx2"))) void pack_argb_avx2(const float* r, const float* g,
+    const float* b, size_t count, const uint32_t* lut, uint32_t* argb)
+{
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i rg = _mm256_or_si256(
+            _mm256_slli_epi32(clamp8(r + i, lut), 16), _mm256_slli_epi32(clamp8(g + i, lut), 8));
+        const __m256i pixels = _mm256_or_si256(_mm256_or_si256(rg, clamp8(b + i, lut)), alpha);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(argb + i), pixels);
+    }
+    _mm256_zeroupper();
+    pack_argb_scalar(r + i, g + i, b + i, count - i, lut, argb + i);
+}
+
+// tone8 maps eight colors, like tone does
+__attribute__((target("avx2"))) inline __m256 tone8(__m256 c, ToneMap curve, __m256 scale)
+{
+    const __m256 y = _mm256_max_ps(_mm256_mul_ps(c, scale), _mm256_setzero_ps());
+    const __m256 white = _mm256_set1_ps(255.0f);
+    switch (curve) {
+    case ToneMap::REINHARD:
+        return _mm256_mul_ps(_mm256_div_ps(y, _mm256_add_ps(y, _mm256_set1_ps(1.0f))), white);
+    case ToneMap::ACES: {
+        const __m256 numerator = _mm256_mul_ps(
+            y, _mm256_add_ps(_mm256_mul_ps(y, _mm256_set1_ps(2.51f)), _mm256_set1_ps(0.03f)));
+        const __m256 inner
+            = _mm256_add_ps(_mm256_mul_ps(y, _mm256_set1_ps(2.43f)), _mm256_set1_ps(0.59f));
+        const __m256 denominator
+            = _mm256_add_ps(_mm256_mul_ps(y, inner), _mm256_set1_ps(0.14f));
+        return _mm256_mul_ps(_mm256_div_ps(numerator, denominator), white);
+    }
+    default:
+        return _mm256_mul_ps(y, white);
+    }
+}
+
+__attribute__((target("avx2"))) void tone_map_avx2(
+    float* c, size_t count, ToneMap curve, float scale)
+{
+    const __m256 s = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(c + i, tone8(_mm256_loadu_ps(c + i), curve, s));
+    }
+    _mm256_zeroupper();
+    tone_map_scalar(c + i, count - i, curve, scale);
+}
+
+// As with the sphere kernel, the intrinsics start from undefined registers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// clamp16 clamps sixteen colors to 0..255 and turns them into integers, or looks them up
+__attribute__((target("avx512f"))) inline __m512i clamp16(const float* c, const uint32_t* lut)
+{
+    const __m512 x = _mm512_min_ps(
+        _mm512_max_ps(_mm512_loadu_ps(c), _mm512_setzero_ps()), _mm512_set1_ps(255.0f));
+    if (!lut) {
+        return _mm512_cvttps_epi32(x);
+    }
+    const __m512i index = _mm512_cvttps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(lutScale)));
+    return _mm512_i32gather_epi32(index, lut, 4);
+}
+
+__attribute__((target("avx512f"))) void pack_argb_avx512(const float* r, const float* g,
+    const float* b, size_t count, const uint32_t* lut, uint32_t* argb)
+{
+    const __m512i alpha = _mm512_set1_epi32(static_cast<int>(0xFF000000));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m512i rg = _mm512_or_si512(
+            _mm512_slli_epi32(clamp16(r + i, lut), 16), _mm512_slli_epi32(clamp16(g + i, lut), 8));
+        const __m512i pixels = _mm512_or_si512(_mm512_or_si512(rg, clamp16(b + i, lut)), alpha);
+        _mm512_storeu_si512(argb + i, pixels);
+    }
+    _mm256_zeroupper();
+    pack_argb_scalar(r + i, g + i, b + i, count - i, lut, argb + i);
+}
+
+// tone16 maps sixteen colors, like tone does. AVX-512 has fused multiply-add, so contracting is
+// turned off, as for the sphere kernel.
+__attribute__((target("avx512f"), optimize("fp-contract=off"))) inline __m512 tone16(
+    __m512 c, ToneMap curve, __m512 scale)
+{
+    const __m512 y = _mm512_max_ps(_mm512_mul_ps(c, scale), _mm512_setzero_ps());
+    const __m512 white = _mm512_set1_ps(255.0f);
+    switch (curve) {
+    case ToneMap::REINHARD:
+        return _mm512_mul_ps(_mm512_div_ps(y, _mm512_add_ps(y, _mm512_set1_ps(1.0f))), white);
+    case ToneMap::ACES: {
+        const __m512 numerator = _mm512_mul_ps(
+            y, _mm512_add_ps(_mm512_mul_ps(y, _mm512_set1_ps(2.51f)), _mm512_set1_ps(0.03f)));
+        const __m512 inner
+            = _mm512_add_ps(_mm512_mul_ps(y, _mm512_set1_ps(2.43f)), _mm512_set1_ps(0.59f));
+        const __m512 denominator
+            = _mm512_add_ps(_mm512_mul_ps(y, inner), _mm512_set1_ps(0.14f));
+        return _mm512_mul_ps(_mm512_div_ps(numerator, denominator), white);
+    }
+    default:
+        return _mm512_mul_ps(y, white);
+    }
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off"))) void tone_map_avx512(
+    float* c, size_t count, ToneMap curve, float scale)
+{
+    const __m512 s = _mm512_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_ps(c + i, tone16(_mm512_loadu_ps(c + i), curve, s));
+    }
+    _mm256_zeroupper();
+    tone_map_scalar(c + i, count - i, curve, scale);
+}
+#pragma GCC diagnostic pop
+
+#endif
+
+bool supported(SimdLevel level)
+{
+#ifdef SIMD_X86
+    // This may run before the constructor that checks the CPU, when the statics below are set up
+    __builtin_cpu_init();
+    switch (level) {
+    case SimdLevel::SSE42:
+        return __builtin_cpu_supports("sse4.2");
+    case SimdLevel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SimdLevel::AVX512:
+        return __builtin_cpu_supports("avx512f");
+    default:
+        return true;
+    }
+#else
+    return level == SimdLevel::SCALAR;
+#endif
+}
+
+ClosestSphere kernel(SimdLevel level)
+{
+#ifdef SIMD_X86
+    switch (level) {
+    case SimdLevel::SSE42:
+        return closest_sphere_sse42;
+    case SimdLevel::AVX2:
+        return closest_sphere_avx2;
+    case SimdLevel::AVX512:
+        return closest_sphere_avx512;
+    default:
+        break;
+    }
+#endif
+    return closest_sphere_scalar;
+}
+
+ArgbToYuv420 yuvKernel(SimdLevel level)
+{
+#ifdef SIMD_X86
+    switch (level) {
+    case SimdLevel::SSE42:
+        return argb_to_yuv420_sse42;
+    case SimdLevel::AVX2:
+    case SimdLevel::AVX512:
+        return argb_to_yuv420_avx2;
+    default:
+        break;
+    }
+#endif
+    return argb_to_yuv420_scalar;
+}
+
+PackArgb packKernel(SimdLevel level)
+{
+#ifdef SIMD_X86
+    switch (level) {
+    case SimdLevel::SSE42:
+        return pack_argb_sse42;
+    case SimdLevel::AVX2:
+        return pack_argb_avx2;
+    case SimdLevel::AVX512:
+        return pack_argb_avx512;
+    default:
+        break;
+    }
+#endif
+    return pack_argb_scalar;
+}
+
+ToneMapChannel toneMapKernel(SimdLevel level)
+{
+#ifdef SIMD_X86
+    switch (level) {
+    case SimdLevel::SSE42:
+        return tone_map_sse42;
+    case SimdLevel::AVX2:
+        return tone_map_avx2;
+    case SimdLevel::AVX512:
+        return tone_map_avx512;
+    default:
+        break;
+    }
+#endif
+    return tone_map_scalar;
+}
+
+// The selected level, and its kernels
+SimdLevel selectedLevel = simd_detect();
+ClosestSphere selectedClosestSphere = kernel(selectedLevel);
+ArgbToYuv420 selectedArgbToYuv420 = yuvKernel(selectedLevel);
+PackArgb selectedPackArgb = packKernel(selectedLevel);
+ToneMapChannel selectedToneMap = toneMapKernel(selectedLevel);
+
+}
+
+SimdLevel simd_detect()
+{
+    for (const auto level : { SimdLevel::AVX512, SimdLevel::AVX2, SimdLevel::SSE42 }) {
+        if (supported(level)) {
+            return level;
+        }
+    }
+    return SimdLevel::SCALAR;
+}
+
+SimdLevel simd_level() { return selectedLevel; }
+
+bool simd_select(SimdLevel level)
+{
+    if (!supported(level)) {
+        return false;
+    }
+    selectedLevel = level;
+    selectedClosestSphere = kernel(level);
+    selectedArgbToYuv420 = yuvKernel(level);
+    selectedPackArgb = packKernel(level);
+    selectedToneMap = toneMapKernel(level);
+    return true;
+}
+
+const char* simd_name(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::SSE42:
+        return "sse4.2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+std::optional<SimdLevel> simd_parse(const std::string& name)
+{
+    for (const auto level :
+        { SimdLevel::SCALAR, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512 }) {
+        if (name == simd_name(level)) {
+            return level;
+        }
+    }
+    return std::nullopt;
+}
+
+const char* tone_map_name(ToneMap curve)
+{
+    switch (curve) {
+    case ToneMap::REINHARD:
+        return "reinhard";
+    case ToneMap::ACES:
+        return "aces";
+    default:
+        return "linear";
+    }
+}
+
+std::optional<ToneMap> tone_map_parse(const std::string& name)
+{
+    for (const auto curve : { ToneMap::LINEAR, ToneMap::REINHARD, ToneMap::ACES }) {
+        if (name == tone_map_name(curve)) {
+            return curve;
+        }
+    }
+    return std::nullopt;
+}
+
+size_t closest_sphere(const SphereLanes& lanes, const Vec3a& direction, double& t)
+{
+    return selectedClosestSphere(lanes, direction, t);
+}
+
+void argb_to_yuv420(
+    const uint32_t* argb, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v)
+{
+    selectedArgbToYuv420(argb, width, height, y, u, v);
+}
+
+void pack_argb(const float* r, const float* g, const float* b, size_t count, const uint32_t* lut,
+    uint32_t* argb)
+{
+    selectedPackArgb(r, g, b, count, lut, argb);
+}
+
+void tone_map(float* c, size_t count, ToneMap curve, float exposure)
+{
+    selectedToneMap(c, count, curve, exposure / 255.0f);
+}
@@ -0,0 +1,151 @@
+// The virtual machine that runs compiled scripts
+
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "vm.hpp"
+
+using namespace std::string_literals;
+
+void VM::load(std::shared_ptr<const Bytecode> code)
+{
+    std::unordered_map<std::string_view, size_t> old;
+    for (size_t i = 0; i < m_code->variables.size(); ++i) {
+        old.emplace(m_code->variables[i], i);
+    }
+    std::vector<Value> registers(code->registerCount);
+    for (size_t i = 0; i < code->variables.size(); ++i) {
+        if (const auto it = old.find(code->variables[i]); it != old.end()) {
+            // Only the number is kept, since strings belong to the old bytecode
+            registers[i] = Value { m_registers[it->second].number, nullptr };
+        }
+    }
+    m_registers = std::move(registers);
+    m_code = std::move(code);
+}
+
+bool VM::set(std::string_view name, double value)
+{
+    for (size_t i = 0; i < m_code->variables.size(); ++i) {
+        if (m_code->variables[i] == name) {
+            m_registers[i] = Value { value, nullptr };
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<double> VM::get(std::string_view name) const
+{
+    for (size_t i = 0; i < m_code->variables.size(); ++i) {
+        if (m_code->variables[i] == name) {
+            return m_registers[i].number;
+        }
+    }
+    return std::nullopt;
+}
+
+void VM::run()
+{
+    const Bytecode& code = *m_code;
+    const Instruction* const program = code.code.data();
+    const double* const constants = code.constants.data();
+    Value* const r = m_registers.data();
+
+    // The instructions are counted when a jump is taken, for the instructions since the last
+    // jump, so that the budget costs nothing for the instructions in between
+    uint64_t executed = 0;
+    uint32_t from = 0;
+    const auto jump = [&](uint32_t pc, uint32_t to) {
+        executed += pc - from;
+        if (executed > m_budget) {
+            throw std::runtime_error("the script was stopped after "s + std::to_string(m_budget)
+                + " instructions, it may have an endless loop"s);
+        }
+        from = to;
+        return to;
+    };
+
+    for (uint32_t pc = 0;;) {
+        const Instruction& in = program[pc++];
+        switch (in.op) {
+        case OpCode::LOADK:
+            r[in.a] = Value { constants[in.wide()], nullptr };
+            break;
+        case OpCode::LOADS:
+            r[in.a] = Value { 0, &code.strings[in.wide()] };
+            break;
+        case OpCode::MOVE:
+            r[in.a] = r[in.b];
+            break;
+        case OpCode::NEG:
+            r[in.a] = Value { -r[in.b].number, nullptr };
+            break;
+        case OpCode::ADD:
+            r[in.a] = Value { r[in.b].number + r[in.c].number, nullptr };
+            break;
+        case OpCode::SUB:
+            r[in.a] = Value { r[in.b].number - r[in.c].number, nullptr };
+            break;
+        case OpCode::MUL:
+            r[in.a] = Value { r[in.b].number * r[in.c].number, nullptr };
+            break;
+        case OpCode::DIV:
+            r[in.a] = Value { r[in.b].number / r[in.c].number, nullptr };
+            break;
+        case OpCode::LT:
+            r[in.a] = Value { r[in.b].number < r[in.c].number ? 1.0 : 0.0, nullptr };
+            break;
+        case OpCode::GT:
+            r[in.a] = Value { r[in.b].number > r[in.c].number ? 1.0 : 0.0, nullptr };
+            break;
+        case OpCode::LTEQ:
+            r[in.a] = Value { r[in.b].number <= r[in.c].number ? 1.0 : 0.0, nullptr };
+            break;
+        case OpCode::GTEQ:
+            r[in.a] = Value { r[in.b].number >= r[in.c].number ? 1.0 : 0.0, nullptr };
+            break;
+        case OpCode::EQ:
+            r[in.a] = Value { r[in.b].number == r[in.c].number ? 1.0 : 0.0, nullptr };
+            break;
+        case OpCode::NOTEQ:
+            r[in.a] = Value { r[in.b].number != r[in.c].number ? 1.0 : 0.0, nullptr };
+            break;
+        case OpCode::JUMP:
+            pc = jump(pc, in.wide());
+            break;
+        case OpCode::JUMPIFNOT:
+            if (r[in.a].number == 0) {
+                pc = jump(pc, in.wide());
+            }
+            break;
+        case OpCode::CALL: {
+            const double result = m_builtins.call(in.n)(std::span<const Value> { r + in.c, in.b });
+            r[in.a] = Value { result, nullptr };
+            break;
+        }
+        case OpCode::HALT:
+            return;
+        }
+    }
+}
+
+auto interpret(const Script& script, const Builtins& builtins) -> int
+{
+    try {
+        VM vm { builtins, std::make_shared<const Bytecode>(compile_script(script, builtins)) };
+        vm.run();
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Script error: "s << e.what() << std::endl;
+        return 1;
+    }
+    // success
+    return 0;
+}
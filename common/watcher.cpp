@@ -0,0 +1,163 @@
+// Watching scripts for changes, and recompiling them on a background thread
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "watcher.hpp"
+
+using namespace std::string_literals;
+
+ScriptWatcher::ScriptWatcher(const Builtins& builtins, const std::vector<std::string>& filenames)
+    : m_builtins { builtins }
+{
+    for (const auto& filename : filenames) {
+        auto slot = std::make_unique<Slot>();
+        const std::filesystem::path path { filename };
+        slot->path = filename;
+        slot->directory = path.has_parent_path() ? path.parent_path().string() : "."s;
+        slot->name = path.filename().string();
+
+        // The first compilation happens right away, so that errors can be reported. Like when
+        // they are reloaded, the scripts are copied, since they may be saved at any moment.
+        try {
+            const Script script { filename, true };
+            slot->program = std::make_shared<const Bytecode>(compile_script(script, builtins));
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(filename + ": "s + e.what());
+        }
+        slot->changed = true;
+        m_slots.push_back(std::move(slot));
+    }
+    m_thread = std::thread { &ScriptWatcher::watch, this };
+}
+
+ScriptWatcher::~ScriptWatcher()
+{
+    m_stop = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+size_t ScriptWatcher::size() const { return m_slots.size(); }
+
+std::shared_ptr<const Bytecode> ScriptWatcher::take(size_t index)
+{
+    Slot& slot = *m_slots[index];
+    if (!slot.changed.exchange(false)) {
+        return nullptr;
+    }
+    std::lock_guard lock { slot.mutex };
+    return slot.program;
+}
+
+bool ScriptWatcher::recompile(Slot& slot)
+{
+    std::shared_ptr<const Bytecode> program;
+    try {
+        const Script script { slot.path, true };
+        program = std::make_shared<const Bytecode>(compile_script(script, m_builtins));
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error in " << slot.path << ": " << e.what() << std::endl;
+        return false;
+    }
+    {
+        std::lock_guard lock { slot.mutex };
+        slot.program.swap(program);
+    }
+    slot.changed = true;
+    // The old program is released here, outside of the lock
+    return true;
+}
+
+#ifdef __linux__
+
+void ScriptWatcher::watch()
+{
+    const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Could not watch the scripts for changes" << std::endl;
+        return;
+    }
+
+    // One watch per directory, which also sees editors that save by renaming a new file
+    std::vector<int> watches(m_slots.size(), -1);
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        watches[i] = inotify_add_watch(
+            fd, m_slots[i]->directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    std::vector<bool> dirty(m_slots.size());
+    while (!m_stop) {
+        // Wake up now and then, to check if the watcher should stop
+        pollfd pfd { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        // Collect all the changed scripts first, so that a script that is saved in several
+        // steps is only compiled once
+        std::fill(dirty.begin(), dirty.end(), false);
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + n;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(p);
+                if (event->len > 0) {
+                    const std::string name { event->name };
+                    for (size_t i = 0; i < m_slots.size(); ++i) {
+                        if (watches[i] == event->wd && m_slots[i]->name == name) {
+                            dirty[i] = true;
+                        }
+                    }
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            if (dirty[i]) {
+                recompile(*m_slots[i]);
+            }
+        }
+    }
+    close(fd);
+}
+
+#else
+
+void ScriptWatcher::watch()
+{
+    // Check the modification times instead
+    std::vector<std::filesystem::file_time_type> times(m_slots.size());
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        std::error_code ec;
+        times[i] = std::filesystem::last_write_time(m_slots[i]->path, ec);
+    }
+    while (!m_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            std::error_code ec;
+            const auto time = std::filesystem::last_write_time(m_slots[i]->path, ec);
+            if (!ec && time != times[i]) {
+                times[i] = time;
+                recompile(*m_slots[i]);
+            }
+        }
+    }
+}
+
+#endif
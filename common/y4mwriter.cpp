@@ -0,0 +1,193 @@
+// Writing YUV4MPEG2 video on a background thread
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "simd.hpp"
+#include "y4mwriter.hpp"
+
+using namespace std::string_literals;
+
+namespace {
+
+// writeAll writes all the given bytes, even if the pipe only takes some of them at a time
+bool writeAll(int fd, const uint8_t* data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}
+
+Y4MWriter::Y4MWriter(const std::string& filename, int width, int height, int fps)
+    : m_width { width }
+    , m_height { height }
+    , m_frameSize { 6 + static_cast<size_t>(width) * height
+          + 2 * static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2) }
+{
+    if (filename == "-"s) {
+        // Keep standard output for the video, and let everything else go to standard error
+        std::cout.flush();
+        std::fflush(stdout);
+        m_fd = ::dup(STDOUT_FILENO);
+        if (m_fd >= 0) {
+            ::dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+    } else {
+        m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (m_fd < 0) {
+        throw std::runtime_error("could not open "s + filename + ": "s + std::strerror(errno));
+    }
+
+    // If the reader quits, writes fail with EPIPE instead of ending the program
+    std::signal(SIGPIPE, SIG_IGN);
+
+#ifdef F_SETPIPE_SZ
+    // A larger pipe lets the encoder fall further behind before the writer has to wait. This
+    // fails for anything that is not a pipe, which is fine.
+    ::fcntl(m_fd, F_SETPIPE_SZ, 1 << 20);
+#endif
+
+    const std::string header = "YUV4MPEG2 W"s + std::to_string(width) + " H"s
+        + std::to_string(height) + " F"s + std::to_string(fps) + ":1 Ip A1:1 C420jpeg\n"s;
+    m_failed = !writeAll(m_fd, reinterpret_cast<const uint8_t*>(header.data()), header.size());
+
+    m_thread = std::thread { [this] { run(); } };
+}
+
+Y4MWriter::~Y4MWriter()
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+    ::close(m_fd);
+}
+
+bool Y4MWriter::ready()
+{
+    std::lock_guard lock { m_mutex };
+    if (m_failed) {
+        return false;
+    }
+    if (m_queue.size() + m_writing >= maxQueued) {
+        ++m_dropped;
+        return false;
+    }
+    return true;
+}
+
+bool Y4MWriter::write(const uint32_t* argb, bool wait)
+{
+    std::vector<uint8_t> frame;
+    {
+        std::unique_lock lock { m_mutex };
+        const auto room = [this] { return m_failed || m_queue.size() + m_writing < maxQueued; };
+        if (!room()) {
+            if (!wait) {
+                ++m_dropped;
+                return false;
+            }
+            m_changed.wait(lock, room);
+        }
+        if (m_failed) {
+            return false;
+        }
+        if (!m_spare.empty()) {
+            frame = std::move(m_spare.back());
+            m_spare.pop_back();
+        }
+        ++m_writing; // the room in the queue is taken, while the frame is converted
+    }
+
+    frame.resize(m_frameSize);
+    std::memcpy(frame.data(), "FRAME\n", 6);
+    uint8_t* y = frame.data() + 6;
+    uint8_t* u = y + static_cast<size_t>(m_width) * m_height;
+    uint8_t* v = u + static_cast<size_t>((m_width + 1) / 2) * ((m_height + 1) / 2);
+    argb_to_yuv420(argb, m_width, m_height, y, u, v);
+
+    {
+        std::lock_guard lock { m_mutex };
+        --m_writing;
+        m_queue.push_back(std::move(frame));
+    }
+    m_changed.notify_all();
+    return true;
+}
+
+bool Y4MWriter::finish()
+{
+    std::unique_lock lock { m_mutex };
+    m_changed.wait(lock, [this] { return m_queue.empty() && m_writing == 0; });
+    return !m_failed;
+}
+
+size_t Y4MWriter::written()
+{
+    std::lock_guard lock { m_mutex };
+    return m_written;
+}
+
+size_t Y4MWriter::dropped()
+{
+    std::lock_guard lock { m_mutex };
+    return m_dropped;
+}
+
+// Take one frame at a time from the queue, and write it without holding the lock
+void Y4MWriter::run()
+{
+    while (true) {
+        std::vector<uint8_t> frame;
+        bool failed;
+        {
+            std::unique_lock lock { m_mutex };
+            m_changed.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+            ++m_writing;
+            failed = m_failed;
+        }
+
+        // Once a write has failed, the rest of the frames are thrown away
+        const bool ok = !failed && writeAll(m_fd, frame.data(), frame.size());
+
+        {
+            std::lock_guard lock { m_mutex };
+            --m_writing;
+            if (ok) {
+                ++m_written;
+            } else {
+                m_failed = true;
+            }
+            m_spare.push_back(std::move(frame));
+        }
+        m_changed.notify_all();
+    }
+}
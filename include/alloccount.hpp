@@ -0,0 +1,41 @@
+#pragma once
+
+// Counting the memory allocations that are made with operator new, for finding allocations in
+// code that runs every frame.
+//
+// Counting replaces the global operator new and operator delete, so it is only compiled in when
+// COUNT_ALLOCATIONS is defined, as it is for the spheremover_counted build that ctest runs.
+// Otherwise, the counts are always zero, and the tests that need them are skipped.
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef COUNT_ALLOCATIONS
+constexpr bool allocationsCounted = true;
+#else
+constexpr bool allocationsCounted = false;
+#endif
+
+// AllocationCount is a number of allocations, and how many bytes they asked for
+struct AllocationCount {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+inline AllocationCount operator+(const AllocationCount& a, const AllocationCount& b)
+{
+    return AllocationCount { a.allocations + b.allocations, a.bytes + b.bytes };
+}
+
+inline AllocationCount operator-(const AllocationCount& a, const AllocationCount& b)
+{
+    return AllocationCount { a.allocations - b.allocations, a.bytes - b.bytes };
+}
+
+// allocation_count returns the number of allocations that all threads have made so far.
+// Each thread counts in its own cache line, so counting does not slow down threads that allocate
+// at the same time, and the counts are only added up here.
+AllocationCount allocation_count();
+
+// thread_allocation_count returns the number of allocations that the calling thread has made
+AllocationCount thread_allocation_count();
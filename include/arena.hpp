@@ -0,0 +1,149 @@
+#pragma once
+
+// A bump-pointer allocator for many small objects that are freed all at once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Arena hands out memory from large blocks, by moving a pointer forward. There is no way to free
+// a single object. Instead, reset frees everything at once, in constant time, by moving the
+// pointer back to the start of the first block. The blocks are kept, so that the next round of
+// allocations does not need to ask the system for memory again.
+//
+// Destructors are never called, so only trivially destructible objects can be created.
+class Arena {
+protected:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> m_blocks;
+    size_t m_current = 0; // the block that is being allocated from
+    std::byte* m_ptr = nullptr; // the next free byte in the current block
+    std::byte* m_end = nullptr; // the end of the current block
+
+    const size_t m_blockSize;
+    size_t m_used = 0; // bytes handed out since the last reset, including padding
+    size_t m_reserved = 0; // the size of all blocks
+
+    void* next_block(size_t size, size_t align);
+
+public:
+    explicit Arena(size_t blockSize = 64 * 1024)
+        : m_blockSize { blockSize }
+    {
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Allocate uninitialized memory
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    // Create an object in the arena
+    template <typename T, typename... Args> T* make(Args&&... args);
+
+    // Create an array of default initialized objects in the arena
+    template <typename T> std::span<T> array(size_t count);
+
+    // Free everything that has been allocated, in constant time
+    void reset();
+
+    // Free everything, and make sure that the first block holds at least size bytes. If it does
+    // not, all blocks are replaced by one block of that size, so that allocations that needed
+    // several blocks before fit in one block after this.
+    void reset(size_t size);
+
+    // The number of bytes allocated since the last reset
+    size_t used() const;
+
+    // The number of bytes that have been reserved from the system, which is the peak memory use
+    size_t reserved() const;
+};
+
+inline void* Arena::allocate(size_t size, size_t align)
+{
+    const auto p = reinterpret_cast<uintptr_t>(m_ptr);
+    const uintptr_t aligned = (p + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    if (m_ptr == nullptr || aligned + size > reinterpret_cast<uintptr_t>(m_end)) {
+        return next_block(size, align);
+    }
+    m_used += aligned + size - p;
+    m_ptr = reinterpret_cast<std::byte*>(aligned + size);
+    return reinterpret_cast<void*>(aligned);
+}
+
+// Move on to the next block that has room, reserving a new one if there is none
+inline void* Arena::next_block(size_t size, size_t align)
+{
+    const size_t needed = size + align;
+    size_t next = m_ptr == nullptr ? 0 : m_current + 1;
+    while (next < m_blocks.size() && m_blocks[next].size < needed) {
+        ++next;
+    }
+    if (next >= m_blocks.size()) {
+        const size_t blockSize = std::max(m_blockSize, needed);
+        m_blocks.push_back(Block { std::make_unique_for_overwrite<std::byte[]>(blockSize), blockSize });
+        m_reserved += blockSize;
+        next = m_blocks.size() - 1;
+    }
+    // Whatever is left of the current block is counted as used
+    m_used += static_cast<size_t>(m_end - m_ptr);
+    m_current = next;
+    m_ptr = m_blocks[next].data.get();
+    m_end = m_ptr + m_blocks[next].size;
+    return allocate(size, align);
+}
+
+template <typename T, typename... Args> inline T* Arena::make(Args&&... args)
+{
+    static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+template <typename T> inline std::span<T> Arena::array(size_t count)
+{
+    static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+    if (count == 0) {
+        return {};
+    }
+    T* p = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    std::uninitialized_default_construct_n(p, count);
+    return std::span<T> { p, count };
+}
+
+inline void Arena::reset()
+{
+    m_current = 0;
+    m_used = 0;
+    if (m_blocks.empty()) {
+        m_ptr = m_end = nullptr;
+        return;
+    }
+    m_ptr = m_blocks[0].data.get();
+    m_end = m_ptr + m_blocks[0].size;
+}
+
+inline void Arena::reset(size_t size)
+{
+    if (size > 0 && (m_blocks.empty() || m_blocks[0].size < size)) {
+        const size_t blockSize = std::max(m_blockSize, size);
+        m_blocks.clear();
+        m_blocks.push_back(
+            Block { std::make_unique_for_overwrite<std::byte[]>(blockSize), blockSize });
+        m_reserved = blockSize;
+    }
+    reset();
+}
+
+inline size_t Arena::used() const { return m_used; }
+
+inline size_t Arena::reserved() const { return m_reserved; }
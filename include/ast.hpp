@@ -0,0 +1,72 @@
+#pragma once
+
+// The syntax tree of a script, and the parser that creates it from the tokens
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+#include "interner.hpp"
+#include "script.hpp"
+
+enum class NodeType : uint8_t {
+    NUMBER, // a number literal
+    STRING, // a string literal
+    NAME, // a variable
+    NEGATE, // -first
+    BINARY, // first op second, where op is an arithmetic or comparison operator
+    CALL, // name(children...)
+    ASSIGN, // name = first
+    IF, // if (first) second else third
+    FOR, // for (; first; third) second, where the initialization is a statement before the loop
+    BLOCK // { children... }
+};
+
+// Node is one node in the syntax tree. Which of the fields are used depends on the type.
+// Nodes live in an arena, and are freed all at once, together with the rest of the tree.
+// The fields are packed into 64 bytes, since large scripts have millions of nodes.
+class Node {
+public:
+    NodeType type;
+    TokenType op = TokenType::UNRECOGNIZED; // the operator of a BINARY node
+    uint32_t name = 0; // the interned name of the variable or function
+    uint32_t position = 0; // where the node starts in the source, for error messages
+    uint32_t length = 0; // the length of a string, which follows the " at the position
+
+    double number = 0; // the value of a NUMBER node
+
+    const Node* first = nullptr; // the operand, the assigned value or the condition
+    const Node* second = nullptr; // the right hand side, or the body
+    const Node* third = nullptr; // the else branch, or the step of a loop
+
+    std::span<const Node* const> children; // the arguments, or the statements of a block
+
+    // The contents of a STRING node
+    std::string_view text(std::string_view source) const
+    {
+        return source.substr(position + 1, length);
+    }
+};
+
+static_assert(sizeof(Node) == 64);
+
+// SyntaxTree holds the nodes of a parsed script, and the interned names they refer to.
+// Parsing another script into the same tree frees the previous tree in constant time, and reuses
+// its memory.
+class SyntaxTree {
+public:
+    Arena arena;
+    Interner names { arena };
+    const Node* root = nullptr; // a BLOCK with all the statements in the script
+};
+
+// parse fills in a syntax tree from the tokens of a script. Strings in the tree refer to the
+// source, while names are interned in the tree. Scripts can be up to 4 GiB.
+// Throws std::runtime_error, with the line number, if the script has a syntax error, or if it is
+// nested more than 256 levels deep.
+void parse(const std::vector<Token>& tokens, std::string_view source, SyntaxTree& tree);
+
+// line_number returns the line that the given position in the source is on, starting at 1
+auto line_number(std::string_view source, size_t position) -> size_t;
@@ -0,0 +1,53 @@
+#pragma once
+
+// Lists of images to render offline, read from a manifest
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// SphereMove moves one sphere of the scene of an image, before it is rendered
+struct SphereMove {
+    uint32_t index;
+    double x;
+    double y;
+    double z;
+};
+
+// BatchImage is one image to render, and where to write it
+struct BatchImage {
+    std::string output; // a PPM file
+    std::string scene; // a scene file, a .txt description, or "demo" for the demo scene
+    int width = 0;
+    int height = 0;
+
+    // Where the camera is, and how it is turned, if not from the start of the main loop
+    std::optional<std::array<double, 3>> camera;
+    double yaw = 0;
+    double pitch = 0;
+
+    std::vector<SphereMove> moves;
+};
+
+// numbered_filename adds a number to a filename, before the extension if there is one, as in
+// "out_7.ppm". The number is padded with zeros to the given number of digits.
+auto numbered_filename(const std::string& filename, int number, int digits = 0) -> std::string;
+
+// parse_manifest reads a list of images to render. Each line describes one thing:
+//
+//   image OUTPUT.ppm SCENE [WIDTH HEIGHT]
+//   camera X Y Z [YAW PITCH]
+//   move INDEX X Y Z
+//   sweep INDEX X Y Z COUNT
+//
+// SCENE is a scene file, a .txt description, or "demo" for the demo scene, and the image is
+// 495x270 if no size is given. The other lines change the image on the line before them: camera
+// places the camera, and move moves a sphere by an offset, and can be repeated. sweep replaces
+// the image with COUNT images, where the sphere is moved by 0, 1, ..., COUNT - 1 times the
+// offset, and a number is added to the name of each output, as in "out_0.ppm".
+//
+// Scenes and outputs are relative to the manifest. Empty lines and lines starting with # are
+// ignored. Throws std::runtime_error if the manifest is invalid.
+auto parse_manifest(const std::string& filename) -> std::vector<BatchImage>;
@@ -0,0 +1,123 @@
+#pragma once
+
+// The functions that scripts can call
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <span>
+
+#include "commands.hpp"
+#include "scene.hpp"
+#include "vm.hpp"
+
+// add_standard_builtins adds print and a few math functions
+inline void add_standard_builtins(Builtins& builtins)
+{
+    // print writes the arguments, separated by spaces, followed by a newline
+    builtins.function("print", -1, [](std::span<const Value> args) {
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (i > 0) {
+                std::cout << " ";
+            }
+            if (args[i].string) {
+                std::cout << *args[i].string;
+            } else {
+                std::cout << args[i].number;
+            }
+        }
+        std::cout << std::endl;
+        return 0.0;
+    });
+    builtins.function(
+        "sin", 1, [](std::span<const Value> args) { return std::sin(args[0].number); });
+    builtins.function(
+        "cos", 1, [](std::span<const Value> args) { return std::cos(args[0].number); });
+    builtins.function(
+        "sqrt", 1, [](std::span<const Value> args) { return std::sqrt(args[0].number); });
+    builtins.function(
+        "abs", 1, [](std::span<const Value> args) { return std::fabs(args[0].number); });
+}
+
+// sphere_range converts a first index and a count from a script to a range of spheres, limited to
+// the given number of spheres. Returns false if the range is empty, or if either number is NaN
+// or infinite. The count is limited while it is still a double, since converting a double that
+// does not fit in a size_t is undefined.
+inline bool sphere_range(double first, double count, size_t total, size_t& start, size_t& length)
+{
+    if (!std::isfinite(first) || !std::isfinite(count) || first < 0 || count < 1
+        || first >= static_cast<double>(total)) {
+        return false;
+    }
+    start = static_cast<size_t>(first);
+    length = static_cast<size_t>(std::min(count, static_cast<double>(total - start)));
+    return true;
+}
+
+// add_scene_builtins adds functions for changing the scene that the given pointer points to.
+// The changes are recorded in the command buffer, and take effect when the buffer is applied to
+// the scene, once per frame. The pointer and the buffer must outlive the builtins.
+inline void add_scene_builtins(
+    Builtins& builtins, const std::unique_ptr<Scene>& scene, CommandBuffer& commands)
+{
+    // The spheres that the scripts can refer to, including the ones spawned this frame
+    const auto total = [&scene, &commands] { return scene->sphere_count() + commands.spawned(); };
+
+    // sphere_move(i, x, y, z) moves sphere i by the given offset
+    builtins.function("sphere_move", 4, [&commands, total](std::span<const Value> args) {
+        size_t first, count;
+        if (sphere_range(args[0].number, 1, total(), first, count)) {
+            commands.move(first, count, Vec3 { args[1].number, args[2].number, args[3].number });
+        }
+        return 0.0;
+    });
+    // sphere_move_range(first, count, x, y, z) moves count spheres by the given offset
+    builtins.function("sphere_move_range", 5, [&commands, total](std::span<const Value> args) {
+        size_t first, count;
+        if (sphere_range(args[0].number, args[1].number, total(), first, count)) {
+            commands.move(first, count, Vec3 { args[2].number, args[3].number, args[4].number });
+        }
+        return 0.0;
+    });
+    // sphere_set(i, x, y, z) places sphere i at the given position
+    builtins.function("sphere_set", 4, [&commands, total](std::span<const Value> args) {
+        size_t first, count;
+        if (sphere_range(args[0].number, 1, total(), first, count)) {
+            commands.set_position(
+                first, Point3 { args[1].number, args[2].number, args[3].number });
+        }
+        return 0.0;
+    });
+    // light_move(x, y, z) moves the light by the given offset
+    builtins.function("light_move", 3, [&commands](std::span<const Value> args) {
+        commands.light_move(Vec3 { args[0].number, args[1].number, args[2].number });
+        return 0.0;
+    });
+    // spawn(x, y, z, r) adds a sphere, and returns the index of the new sphere
+    builtins.function("spawn", 4, [&scene, &commands](std::span<const Value> args) {
+        const size_t spawned = commands.spawn(
+            Point3 { args[0].number, args[1].number, args[2].number }, args[3].number);
+        return static_cast<double>(scene->sphere_count() + spawned);
+    });
+    // destroy(i) removes sphere i, at the end of the frame
+    builtins.function("destroy", 1, [&commands, total](std::span<const Value> args) {
+        size_t first, count;
+        if (sphere_range(args[0].number, 1, total(), first, count)) {
+            commands.destroy(first, count);
+        }
+        return 0.0;
+    });
+    // destroy_range(first, count) removes count spheres, at the end of the frame
+    builtins.function("destroy_range", 2, [&commands, total](std::span<const Value> args) {
+        size_t first, count;
+        if (sphere_range(args[0].number, args[1].number, total(), first, count)) {
+            commands.destroy(first, count);
+        }
+        return 0.0;
+    });
+    // sphere_count() returns the number of spheres, including the ones spawned this frame
+    builtins.function("sphere_count", 0, [total](std::span<const Value>) {
+        return static_cast<double>(total());
+    });
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+#include <numbers>
+#include <sstream>
+#include <string>
+
+#include "point.hpp"
+#include "quat.hpp"
+#include "ray.hpp"
+#include "vec3.hpp"
+
+using namespace std::string_literals;
+
+// Camera has a position, an orientation and a vertical field of view.
+// Like the screen, the camera has x pointing right and y pointing down, and looks along z, before
+// it is rotated. The basis vectors and the size of the view are calculated once, when the camera
+// is created, so that creating a ray for a pixel is only a few multiplications.
+class Camera {
+protected:
+    const Point3 m_pos;
+    const Quat m_orientation;
+    const double m_fov; // vertical field of view, in radians
+
+    const Vec3 m_right;
+    const Vec3 m_down;
+    const Vec3 m_forward;
+    const double m_tanHalfFov; // half the height of the view, at a distance of 1
+
+public:
+    Camera(const Point3 _pos, const Quat _orientation, double _fov)
+        : m_pos { _pos }
+        , m_orientation { _orientation }
+        , m_fov { _fov }
+        , m_right { _orientation.rotate(Vec3 { 1, 0, 0 }) }
+        , m_down { _orientation.rotate(Vec3 { 0, 1, 0 }) }
+        , m_forward { _orientation.rotate(Vec3 { 0, 0, 1 }) }
+        , m_tanHalfFov { std::tan(_fov / 2) }
+    {
+    }
+
+    const std::string str() const;
+
+    const Point3 pos() const;
+    const Quat orientation() const;
+    double fov() const;
+
+    const Vec3 right() const;
+    const Vec3 down() const;
+    const Vec3 forward() const;
+    double tan_half_fov() const;
+
+    // ray returns the ray through a point on the screen, where (0, 0) is the top left corner and
+    // (1, 1) is the bottom right corner. aspect is the width of the screen divided by the height.
+    const Ray ray(double u, double v, double aspect) const;
+
+    // Create a new camera that is moved, relative to where the camera is looking
+    const Camera move(double right, double down, double forward) const;
+};
+
+// str returns a string representation of the camera
+inline const std::string Camera::str() const
+{
+    std::stringstream ss;
+    ss << "camera: ("s << m_pos << ", "s << m_forward << ", "s << m_fov * 180 / std::numbers::pi
+       << " degrees)"s;
+    return ss.str();
+}
+
+// Implement support for the << operator, by calling the Camera str method
+inline std::ostream& operator<<(std::ostream& os, const Camera& c)
+{
+    os << c.str();
+    return os;
+}
+
+inline const Point3 Camera::pos() const { return m_pos; }
+
+inline const Quat Camera::orientation() const { return m_orientation; }
+
+inline double Camera::fov() const { return m_fov; }
+
+inline const Vec3 Camera::right() const { return m_right; }
+
+inline const Vec3 Camera::down() const { return m_down; }
+
+inline const Vec3 Camera::forward() const { return m_forward; }
+
+inline double Camera::tan_half_fov() const { return m_tanHalfFov; }
+
+inline const Ray Camera::ray(double u, double v, double aspect) const
+{
+    const double x = (2 * u - 1) * m_tanHalfFov * aspect;
+    const double y = (2 * v - 1) * m_tanHalfFov;
+    return Ray { m_pos, m_pos + m_forward + m_right * x + m_down * y };
+}
+
+inline const Camera Camera::move(double right, double down, double forward) const
+{
+    return Camera { m_pos + m_right * right + m_down * down + m_forward * forward, m_orientation,
+        m_fov };
+}
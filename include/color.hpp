@@ -8,18 +8,20 @@ using RG = Vec2;
 using RGB = Vec3;
 using RGBA = Vec4;
 
+// The colors are constant expressions, so that they can be used in scenes that are defined at
+// compile time, and need no initialization when the program starts
 namespace Color {
 
-const RGB red = RGB { 255, 0, 0 };
-const RGB green = RGB { 0, 255, 0 };
-const RGB blue = RGB { 0, 0, 255 };
+inline constexpr RGB red = RGB { 255, 0, 0 };
+inline constexpr RGB green = RGB { 0, 255, 0 };
+inline constexpr RGB blue = RGB { 0, 0, 255 };
 
-const RGB black = RGB { 0, 0, 0 };
-const RGB white = RGB { 255, 255, 255 };
+inline constexpr RGB black = RGB { 0, 0, 0 };
+inline constexpr RGB white = RGB { 255, 255, 255 };
 
-const RGB blueish { 80, 140, 255 };
-const RGB gray { 128, 128, 128 };
+inline constexpr RGB blueish { 80, 140, 255 };
+inline constexpr RGB gray { 128, 128, 128 };
 
-const RGB darkgray { 32, 32, 32 };
+inline constexpr RGB darkgray { 32, 32, 32 };
 
 }
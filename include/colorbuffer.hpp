@@ -0,0 +1,161 @@
+#pragma once
+
+// The colors of a frame as floats, between shading them and packing them into pixels
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "omp.h"
+
+#include "simd.hpp"
+
+// ToneMapping says how the linear colors of a frame, which can be brighter than white, are turned
+// into the colors of the window or of an image. The default leaves the colors as they are.
+struct ToneMapping {
+    ToneMap curve = ToneMap::LINEAR;
+    double exposure = 0; // in stops, so that 1 is twice as bright, added to the automatic exposure
+    bool autoExposure = false; // expose the frame so that its average brightness is middle gray
+    bool gamma = false; // encode the colors as sRGB when they are packed
+};
+
+// ColorBuffer holds the color of each pixel of a frame as floats, with one plane per channel, so
+// that the SIMD kernels can load the same channel of many pixels at once. The colors are linear,
+// where 255 is white, and brighter colors are kept as they are until the frame is tone mapped.
+//
+// The planes are kept from one frame to the next, and only grow, so that after the first frames,
+// a frame does not allocate.
+struct ColorBuffer {
+    // The kernels run on chunks of whole cache lines, with one chunk at a time per thread
+    static constexpr size_t chunk = 16384;
+
+    int width = 0;
+    int height = 0;
+    AlignedVector<float> r;
+    AlignedVector<float> g;
+    AlignedVector<float> b;
+
+    void resize(int w, int h);
+
+    // autoExposure returns the exposure that makes the average brightness of the colors middle
+    // gray. The average is taken from a histogram of the luminance of every 4th pixel in each
+    // direction, in quarter stops, leaving out black and the darkest and brightest tenth.
+    auto autoExposure() const -> float;
+
+    // toneMap applies the exposure and the curve of the mapping to the colors, in place, on all
+    // threads, and returns the exposure that was used, as a factor
+    auto toneMap(const ToneMapping& mapping) -> float;
+
+    // pack packs the colors into ARGB8888 pixels, on all threads. If gamma is set, the colors
+    // are taken to be linear, and are encoded as sRGB.
+    void pack(uint32_t* argb, bool gamma = false) const;
+};
+
+// srgb_lut returns the table that the pack kernel uses for encoding linear colors as sRGB
+inline const uint32_t* srgb_lut()
+{
+    static const auto lut = [] {
+        std::array<uint32_t, gammaLutSize> table;
+        for (size_t i = 0; i < table.size(); ++i) {
+            const double linear = static_cast<double>(i) / (gammaLutSize - 1);
+            const double encoded = (linear <= 0.0031308)
+                ? linear * 12.92
+                : 1.055 * std::pow(linear, 1 / 2.4) - 0.055;
+            table[i] = static_cast<uint32_t>(std::lround(encoded * 255));
+        }
+        return table;
+    }();
+    return lut.data();
+}
+
+inline void ColorBuffer::resize(int w, int h)
+{
+    width = w;
+    height = h;
+    const auto size = static_cast<size_t>(w) * h;
+    r.resize(size);
+    g.resize(size);
+    b.resize(size);
+}
+
+inline auto ColorBuffer::autoExposure() const -> float
+{
+    constexpr int step = 4;
+    constexpr int bins = 64;
+    constexpr double binsPerStop = 4;
+    constexpr double darkest = -12; // the stops below white where the first bin starts
+
+    // Count the pixels on all threads. The brightest bin also counts anything brighter.
+    uint32_t histogram[bins] = {};
+#pragma omp parallel for reduction(+ : histogram[:bins])
+    for (int y = 0; y < height; y += step) {
+        for (int x = 0; x < width; x += step) {
+            const size_t i = static_cast<size_t>(y) * width + x;
+            const double luminance = (0.2126 * r[i] + 0.7152 * g[i] + 0.0722 * b[i]) / 255;
+            if (!(luminance >= std::exp2(darkest))) { // black, or NaN
+                continue;
+            }
+            const auto bin = static_cast<int>((std::log2(luminance) - darkest) * binsPerStop);
+            ++histogram[std::min(bin, bins - 1)];
+        }
+    }
+
+    double total = 0;
+    for (const auto count : histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 1.0f;
+    }
+
+    // Average the stops of the pixels between the darkest and the brightest tenth, where the
+    // pixels of each bin are at its middle
+    double seen = 0;
+    double sum = 0;
+    double weight = 0;
+    for (int bin = 0; bin < bins; ++bin) {
+        const double from = std::max(seen, total * 0.1);
+        const double to = std::min(seen + histogram[bin], total * 0.9);
+        seen += histogram[bin];
+        if (to > from) {
+            sum += (to - from) * (darkest + (bin + 0.5) / binsPerStop);
+            weight += to - from;
+        }
+    }
+    return static_cast<float>(0.18 / std::exp2(sum / weight));
+}
+
+inline auto ColorBuffer::toneMap(const ToneMapping& mapping) -> float
+{
+    const float exposure = static_cast<float>(std::exp2(mapping.exposure))
+        * (mapping.autoExposure ? autoExposure() : 1.0f);
+    if (mapping.curve == ToneMap::LINEAR && exposure == 1.0f) {
+        return exposure;
+    }
+    const size_t size = static_cast<size_t>(width) * height;
+    const auto chunks = static_cast<int>((size + chunk - 1) / chunk);
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < chunks; ++c) {
+        const size_t first = static_cast<size_t>(c) * chunk;
+        const size_t count = std::min(chunk, size - first);
+        tone_map(r.data() + first, count, mapping.curve, exposure);
+        tone_map(g.data() + first, count, mapping.curve, exposure);
+        tone_map(b.data() + first, count, mapping.curve, exposure);
+    }
+    return exposure;
+}
+
+inline void ColorBuffer::pack(uint32_t* argb, bool gamma) const
+{
+    const uint32_t* lut = gamma ? srgb_lut() : nullptr;
+    const size_t size = static_cast<size_t>(width) * height;
+    const auto chunks = static_cast<int>((size + chunk - 1) / chunk);
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < chunks; ++c) {
+        const size_t first = static_cast<size_t>(c) * chunk;
+        const size_t count = std::min(chunk, size - first);
+        pack_argb(r.data() + first, g.data() + first, b.data() + first, count, lut, argb + first);
+    }
+}
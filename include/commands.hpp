@@ -0,0 +1,296 @@
+#pragma once
+
+// Recording changes to the scene, and applying them all at once, once per frame
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "point.hpp"
+#include "sphere.hpp"
+#include "vec3.hpp"
+
+enum class CommandType : uint8_t {
+    MOVE, // move the spheres first .. first + count - 1 by (x, y, z)
+    SET, // place the spheres first .. first + count - 1 at (x, y, z)
+    SPAWN, // add a sphere at (x, y, z) with radius r
+    DESTROY, // remove the spheres first .. first + count - 1
+    LIGHT // move the light by (x, y, z)
+};
+
+// Command is one recorded change
+struct Command {
+    CommandType type;
+    uint32_t first = 0;
+    uint32_t count = 0;
+    double x = 0;
+    double y = 0;
+    double z = 0;
+    double r = 0;
+};
+
+// CommandBuffer records changes to the spheres and the light of a scene, so that a script can
+// change thousands of spheres per frame without creating a new scene for every change.
+//
+// All indices refer to the spheres as they were when the recording started, followed by the
+// spheres that have been spawned since then, in order. Destroyed spheres are removed when the
+// buffer is applied, so indices do not shift while recording.
+//
+// When the buffer is applied, the commands that change ranges of spheres are split into pieces
+// that run on all threads. If no ranges overlap, every piece can run at the same time. If some
+// do, the commands run one after the other, in the order they were recorded.
+class CommandBuffer {
+protected:
+    // Edit is what happens to a single sphere, when all the commands are combined
+    struct Edit {
+        double x = 0; // the offset, or the new position if placed is set
+        double y = 0;
+        double z = 0;
+        bool placed = false;
+        bool destroyed = false;
+    };
+
+    // Work is a piece of a command, that one thread handles
+    struct Work {
+        uint32_t command;
+        uint32_t first;
+        uint32_t end;
+    };
+
+    static constexpr uint32_t chunkSize = 4096; // spheres per piece of work
+
+    std::vector<Command> m_commands;
+    size_t m_spawned = 0;
+
+    // Only used while applying, and kept so that the memory can be reused the next frame
+    std::vector<Edit> m_edits;
+    std::vector<Work> m_work;
+    std::vector<uint32_t> m_spawns; // the SPAWN commands, in order
+    std::vector<std::pair<uint32_t, uint32_t>> m_ranges;
+
+    bool disjoint();
+    void edit(const Command& command, uint32_t first, uint32_t end);
+
+public:
+    void move(size_t first, size_t count, const Vec3 offset);
+    void set_position(size_t index, const Point3 pos);
+    void destroy(size_t first, size_t count);
+    void light_move(const Vec3 offset);
+
+    // spawn records a new sphere, and returns how many spheres were spawned before it
+    size_t spawn(const Point3 pos, double r);
+
+    size_t size() const; // the number of recorded commands
+    size_t spawned() const; // the number of recorded spheres
+    bool empty() const;
+
+    // Forget all recorded commands
+    void clear();
+
+    // apply returns the given spheres with all the commands applied, in a single pass
+    std::vector<Sphere> apply(const std::vector<Sphere>& spheres);
+
+    // The same, but the spheres are placed in result, replacing what was there. The memory of
+    // result is reused, so nothing is allocated if it already has room for the spheres.
+    void apply(const std::vector<Sphere>& spheres, std::vector<Sphere>& result);
+
+    // apply_light returns the given light, moved by all the commands that move the light
+    Sphere apply_light(const Sphere& light) const;
+};
+
+inline void CommandBuffer::move(size_t first, size_t count, const Vec3 offset)
+{
+    m_commands.push_back(Command { CommandType::MOVE, static_cast<uint32_t>(first),
+        static_cast<uint32_t>(count), offset.x(), offset.y(), offset.z() });
+}
+
+inline void CommandBuffer::set_position(size_t index, const Point3 pos)
+{
+    m_commands.push_back(Command {
+        CommandType::SET, static_cast<uint32_t>(index), 1, pos.x(), pos.y(), pos.z() });
+}
+
+inline void CommandBuffer::destroy(size_t first, size_t count)
+{
+    m_commands.push_back(Command {
+        CommandType::DESTROY, static_cast<uint32_t>(first), static_cast<uint32_t>(count) });
+}
+
+inline void CommandBuffer::light_move(const Vec3 offset)
+{
+    m_commands.push_back(
+        Command { CommandType::LIGHT, 0, 0, offset.x(), offset.y(), offset.z() });
+}
+
+inline size_t CommandBuffer::spawn(const Point3 pos, double r)
+{
+    m_commands.push_back(Command { CommandType::SPAWN, 0, 0, pos.x(), pos.y(), pos.z(), r });
+    return m_spawned++;
+}
+
+inline size_t CommandBuffer::size() const { return m_commands.size(); }
+
+inline size_t CommandBuffer::spawned() const { return m_spawned; }
+
+inline bool CommandBuffer::empty() const { return m_commands.empty(); }
+
+inline void CommandBuffer::clear()
+{
+    m_commands.clear();
+    m_spawned = 0;
+}
+
+// disjoint checks if none of the pieces of work overlap. Scripts usually loop over the spheres in
+// order, so the pieces are only sorted if they are not sorted already.
+inline bool CommandBuffer::disjoint()
+{
+    m_ranges.clear();
+    for (const auto& work : m_work) {
+        m_ranges.emplace_back(work.first, work.end);
+    }
+    if (!std::is_sorted(m_ranges.begin(), m_ranges.end())) {
+        std::sort(m_ranges.begin(), m_ranges.end());
+    }
+    for (size_t i = 1; i < m_ranges.size(); ++i) {
+        if (m_ranges[i].first < m_ranges[i - 1].second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// edit applies a command to the edits of the spheres from first up to, but not including, end
+inline void CommandBuffer::edit(const Command& command, uint32_t first, uint32_t end)
+{
+    switch (command.type) {
+    case CommandType::MOVE:
+        for (uint32_t i = first; i < end; ++i) {
+            m_edits[i].x += command.x;
+            m_edits[i].y += command.y;
+            m_edits[i].z += command.z;
+        }
+        break;
+    case CommandType::SET:
+        for (uint32_t i = first; i < end; ++i) {
+            m_edits[i].x = command.x;
+            m_edits[i].y = command.y;
+            m_edits[i].z = command.z;
+            m_edits[i].placed = true;
+        }
+        break;
+    case CommandType::DESTROY:
+        for (uint32_t i = first; i < end; ++i) {
+            m_edits[i].destroyed = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+inline std::vector<Sphere> CommandBuffer::apply(const std::vector<Sphere>& spheres)
+{
+    std::vector<Sphere> result;
+    apply(spheres, result);
+    return result;
+}
+
+inline void CommandBuffer::apply(const std::vector<Sphere>& spheres, std::vector<Sphere>& result)
+{
+    const size_t existing = spheres.size();
+    const size_t total = existing + m_spawned;
+    m_edits.assign(total, Edit {});
+
+    // Split the commands that change ranges of spheres into pieces of work
+    m_work.clear();
+    m_spawns.clear();
+    for (size_t i = 0; i < m_commands.size(); ++i) {
+        const auto& command = m_commands[i];
+        if (command.type == CommandType::SPAWN) {
+            m_spawns.push_back(static_cast<uint32_t>(i));
+            continue;
+        }
+        if (command.type == CommandType::LIGHT) {
+            continue;
+        }
+        const size_t end = std::min(static_cast<size_t>(command.first) + command.count, total);
+        for (size_t first = command.first; first < end; first += chunkSize) {
+            m_work.push_back(Work { static_cast<uint32_t>(i), static_cast<uint32_t>(first),
+                static_cast<uint32_t>(std::min(first + chunkSize, end)) });
+        }
+    }
+
+    if (disjoint()) {
+        // Every sphere is changed by at most one command, so all the work can be done at once
+#pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < m_work.size(); ++i) {
+            const auto& work = m_work[i];
+            edit(m_commands[work.command], work.first, work.end);
+        }
+    } else {
+        // One command at a time, with the pieces of each command running at the same time
+        for (size_t i = 0; i < m_work.size();) {
+            size_t next = i + 1;
+            while (next < m_work.size() && m_work[next].command == m_work[i].command) {
+                ++next;
+            }
+#pragma omp parallel for if (next - i > 1)
+            for (size_t j = i; j < next; ++j) {
+                const auto& work = m_work[j];
+                edit(m_commands[work.command], work.first, work.end);
+            }
+            i = next;
+        }
+    }
+
+    // Create the new list of spheres, in a single pass
+    result.clear();
+    result.reserve(total);
+    for (size_t i = 0; i < total; ++i) {
+        const auto& e = m_edits[i];
+        if (e.destroyed) {
+            continue;
+        }
+        if (i < existing) {
+            const auto& sphere = spheres[i];
+            if (e.placed) {
+                result.emplace_back(Point3 { e.x, e.y, e.z }, sphere.r(), sphere.color());
+            } else if (e.x != 0 || e.y != 0 || e.z != 0) {
+                result.emplace_back(sphere.pos() + Vec3 { e.x, e.y, e.z }, sphere.r(),
+                    sphere.color());
+            } else {
+                result.push_back(sphere);
+            }
+        } else {
+            const auto& command = m_commands[m_spawns[i - existing]];
+            if (e.placed) {
+                result.emplace_back(e.x, e.y, e.z, command.r);
+            } else {
+                result.emplace_back(
+                    command.x + e.x, command.y + e.y, command.z + e.z, command.r);
+            }
+        }
+    }
+}
+
+inline Sphere CommandBuffer::apply_light(const Sphere& light) const
+{
+    double x = 0;
+    double y = 0;
+    double z = 0;
+    bool moved = false;
+    for (const auto& command : m_commands) {
+        if (command.type == CommandType::LIGHT) {
+            x += command.x;
+            y += command.y;
+            z += command.z;
+            moved = true;
+        }
+    }
+    if (!moved) {
+        return light;
+    }
+    return Sphere { light.pos() + Vec3 { x, y, z }, light.r(), light.color() };
+}
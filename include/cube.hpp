@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cmath>
 #include <iomanip>
 #include <limits>
@@ -7,50 +8,84 @@
 #include <string>
 #include <vector>
 
+#include "color.hpp"
 #include "points.hpp"
+#include "quat.hpp"
 #include "vec3.hpp"
 
 using namespace std::string_literals;
 
-// Cube has a position, a width (x), a height (y) and a depth (z)
+// Cube has a position, a width (x), a height (y), a depth (z), a rotation and a color.
+// The rotation is around the center of the cube.
 class Cube {
 protected:
     const Vec3 m_pos; // center position of the cube
     const double m_whd[3]; // width, height and depth
+    const Quat m_rotation = Quat::identity();
+    const RGB m_color;
 
 public:
-    Cube(double _x, double _y, double _z, double _w, double _h, double _d)
+    constexpr Cube(double _x, double _y, double _z, double _w, double _h, double _d,
+        const RGB _color = Color::blueish)
         : m_pos { _x, _y, _z }
         , m_whd { _w, _h, _d }
+        , m_color { _color }
     {
     }
 
-    Cube(double _x, double _y, double _z, double _whd) // same width, height and depth
+    constexpr Cube(double _x, double _y, double _z, double _whd,
+        const RGB _color = Color::blueish) // same width, height and depth
         : m_pos { _x, _y, _z }
         , m_whd { _whd, _whd, _whd }
+        , m_color { _color }
     {
     }
 
-    Cube(const Vec3 _pos, double _w, double _h, double _d)
+    constexpr Cube(
+        const Vec3 _pos, double _w, double _h, double _d, const RGB _color = Color::blueish)
         : m_pos { _pos }
         , m_whd { _w, _h, _d }
+        , m_color { _color }
     {
     }
 
-    Cube(const Vec3 _pos, double _whd) // same width, height and depth
+    constexpr Cube(const Vec3 _pos, double _whd,
+        const RGB _color = Color::blueish) // same width, height and depth
         : m_pos { _pos }
         , m_whd { _whd, _whd, _whd }
+        , m_color { _color }
+    {
+    }
+
+    constexpr Cube(double _x, double _y, double _z, double _w, double _h, double _d,
+        const Quat _rotation, const RGB _color = Color::blueish)
+        : m_pos { _x, _y, _z }
+        , m_whd { _w, _h, _d }
+        , m_rotation { _rotation }
+        , m_color { _color }
+    {
+    }
+
+    constexpr Cube(const Vec3 _pos, double _w, double _h, double _d, const Quat _rotation,
+        const RGB _color = Color::blueish)
+        : m_pos { _pos }
+        , m_whd { _w, _h, _d }
+        , m_rotation { _rotation }
+        , m_color { _color }
     {
     }
 
     const std::string str() const;
-    double x() const;
-    double y() const;
-    double z() const;
-    double w() const;
-    double h() const;
-    double d() const;
-    const Vec3 pos() const;
+    constexpr double x() const;
+    constexpr double y() const;
+    constexpr double z() const;
+    constexpr double w() const;
+    constexpr double h() const;
+    constexpr double d() const;
+    constexpr const Vec3 pos() const;
+    constexpr const Quat rotation() const;
+    double bounding_radius() const; // the radius of a sphere around the cube, for any rotation
+    constexpr const RGB color() const;
     const Vec3 normal(const Vec3 p) const;
 
     const Vec3 p0() const;
@@ -63,6 +98,9 @@ public:
     const Vec3 p7() const;
 
     const Points points() const;
+
+    // corners returns the same points as points, without allocating
+    const std::array<Vec3, 8> corners() const;
 };
 
 // str returns a string representation of the cube
@@ -71,8 +109,11 @@ public:
 inline const std::string Cube::str() const
 {
     std::stringstream ss;
-    ss << "cube: ("s << m_pos << ", "s << m_whd[0] << ", "s << m_whd[1] << ", "s << m_whd[2]
-       << ")"s;
+    ss << "cube: ("s << m_pos << ", "s << m_whd[0] << ", "s << m_whd[1] << ", "s << m_whd[2];
+    if (!m_rotation.is_identity()) {
+        ss << ", "s << m_rotation;
+    }
+    ss << ")"s;
     return ss.str();
 }
 
@@ -83,25 +124,35 @@ inline std::ostream& operator<<(std::ostream& os, const Cube& s)
     return os;
 }
 
-double Cube::x() const { return m_pos.x(); }
+constexpr double Cube::x() const { return m_pos.x(); }
+
+constexpr double Cube::y() const { return m_pos.y(); }
+
+constexpr double Cube::z() const { return m_pos.z(); }
+
+constexpr double Cube::w() const { return m_whd[0]; }
 
-double Cube::y() const { return m_pos.y(); }
+constexpr double Cube::h() const { return m_whd[1]; }
 
-double Cube::z() const { return m_pos.z(); }
+constexpr double Cube::d() const { return m_whd[2]; }
 
-double Cube::w() const { return m_whd[0]; }
+constexpr const Vec3 Cube::pos() const { return m_pos; }
 
-double Cube::h() const { return m_whd[1]; }
+constexpr const Quat Cube::rotation() const { return m_rotation; }
 
-double Cube::d() const { return m_whd[2]; }
+inline double Cube::bounding_radius() const
+{
+    return 0.5 * std::sqrt(w() * w() + h() * h() + d() * d());
+}
 
-const Vec3 Cube::pos() const { return m_pos; }
+constexpr const RGB Cube::color() const { return m_color; }
 
 // m_pos is the center position
 // rv is the "radius offset
+// The corners are rotated around the center
 
 // left bottom front point of the cube (-, -, -)
-const Vec3 Cube::p0() const
+inline const Vec3 Cube::p0() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
@@ -109,11 +160,11 @@ const Vec3 Cube::p0() const
 
     // const double r = m_w / 2.0;
 
-    return m_pos + Vec3 { -r0, -r1, -r2 };
+    return m_pos + m_rotation.rotate(Vec3 { -r0, -r1, -r2 });
 }
 
 // right bottom front point of the cube (+, -, -)
-const Vec3 Cube::p1() const
+inline const Vec3 Cube::p1() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
@@ -121,11 +172,11 @@ const Vec3 Cube::p1() const
 
     // const double r = m_w / 2.0;
 
-    return m_pos + Vec3 { r0, -r1, -r2 };
+    return m_pos + m_rotation.rotate(Vec3 { r0, -r1, -r2 });
 }
 
 // right bottom back point of the cube (+, -, +)
-const Vec3 Cube::p2() const
+inline const Vec3 Cube::p2() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
@@ -133,11 +184,11 @@ const Vec3 Cube::p2() const
 
     // const double r = m_w / 2.0;
 
-    return m_pos + Vec3 { r0, -r1, r2 };
+    return m_pos + m_rotation.rotate(Vec3 { r0, -r1, r2 });
 }
 
 // left bottom back point of the cube (-, -, +)
-const Vec3 Cube::p3() const
+inline const Vec3 Cube::p3() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
@@ -145,11 +196,11 @@ const Vec3 Cube::p3() const
 
     // const double r = m_w / 2.0;
 
-    return m_pos + Vec3 { -r0, -r1, r2 };
+    return m_pos + m_rotation.rotate(Vec3 { -r0, -r1, r2 });
 }
 
 // left top front point of the cube (-, +, -)
-const Vec3 Cube::p4() const
+inline const Vec3 Cube::p4() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
@@ -157,11 +208,11 @@ const Vec3 Cube::p4() const
 
     // const double r = m_w / 2.0;
 
-    return m_pos + Vec3 { -r0, r1, -r2 };
+    return m_pos + m_rotation.rotate(Vec3 { -r0, r1, -r2 });
 }
 
 // right top front point of the cube (+, +, -)
-const Vec3 Cube::p5() const
+inline const Vec3 Cube::p5() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
@@ -169,50 +220,57 @@ const Vec3 Cube::p5() const
 
     // const double r = m_w / 2.0;
 
-    return m_pos + Vec3 { r0, r1, -r2 };
+    return m_pos + m_rotation.rotate(Vec3 { r0, r1, -r2 });
 }
 
 // right top back point of the cube (+, +, +)
-const Vec3 Cube::p6() const
+inline const Vec3 Cube::p6() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
     const double r2 = m_whd[2] / 2.0;
 
-    return m_pos + Vec3 { r0, r1, r2 };
+    return m_pos + m_rotation.rotate(Vec3 { r0, r1, r2 });
 }
 
 // left top back point of the cube (-, +, +)
-const Vec3 Cube::p7() const
+inline const Vec3 Cube::p7() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
     const double r2 = m_whd[2] / 2.0;
 
-    return m_pos + Vec3 { -r0, r1, r2 };
+    return m_pos + m_rotation.rotate(Vec3 { -r0, r1, r2 });
 }
 
 // points returns a vector of ordered points for this cube
-const Points Cube::points() const
+inline const Points Cube::points() const
+{
+    const auto xs = corners();
+    return Points(xs.begin(), xs.end());
+}
+
+// corners returns the ordered points of this cube in an array
+inline const std::array<Vec3, 8> Cube::corners() const
 {
     const double r0 = m_whd[0] / 2.0;
     const double r1 = m_whd[1] / 2.0;
     const double r2 = m_whd[2] / 2.0;
 
-    return Points {
-        std::move(m_pos + Vec3 { -r0, -r1, -r2 }),
-        std::move(m_pos + Vec3 { r0, -r1, -r2 }),
-        std::move(m_pos + Vec3 { r0, -r1, r2 }),
-        std::move(m_pos + Vec3 { -r0, -r1, r2 }),
-        std::move(m_pos + Vec3 { -r0, r1, -r2 }),
-        std::move(m_pos + Vec3 { r0, r1, -r2 }),
-        std::move(m_pos + Vec3 { r0, r1, r2 }),
-        std::move(m_pos + Vec3 { -r0, r1, r2 }),
+    return std::array<Vec3, 8> {
+        m_pos + m_rotation.rotate(Vec3 { -r0, -r1, -r2 }),
+        m_pos + m_rotation.rotate(Vec3 { r0, -r1, -r2 }),
+        m_pos + m_rotation.rotate(Vec3 { r0, -r1, r2 }),
+        m_pos + m_rotation.rotate(Vec3 { -r0, -r1, r2 }),
+        m_pos + m_rotation.rotate(Vec3 { -r0, r1, -r2 }),
+        m_pos + m_rotation.rotate(Vec3 { r0, r1, -r2 }),
+        m_pos + m_rotation.rotate(Vec3 { r0, r1, r2 }),
+        m_pos + m_rotation.rotate(Vec3 { -r0, r1, r2 }),
     };
 }
 
 // Get the normal sticking out from the cube at the point p on the surface of the cube
-const Vec3 Cube::normal(const Vec3 p) const
+inline const Vec3 Cube::normal(const Vec3 p) const
 {
 
     // BAH. None of the plans work. This function is a work in progress.
@@ -221,16 +279,14 @@ const Vec3 Cube::normal(const Vec3 p) const
     // 2. Treat those three points as a face and find the normal from that.
     // 3. ::intify that normal to get a cube normal.
 
-    Points xs = this->points();
+    const auto xs = corners();
 
     // TODO: This can be made faster by passing in a distance_squared cache pointer to
     //       each *_closest_* function call.
     size_t smallest_ai = index_closest(xs, p);
-    size_t smallest_bi = index_closest_except(xs, p, std::vector<size_t> { smallest_ai });
-    size_t smallest_ci
-        = index_closest_except(xs, p, std::vector<size_t> { smallest_ai, smallest_bi });
-    size_t smallest_di = index_closest_except(
-        xs, p, std::vector<size_t> { smallest_ai, smallest_bi, smallest_ci });
+    size_t smallest_bi = index_closest_except(xs, p, { smallest_ai });
+    size_t smallest_ci = index_closest_except(xs, p, { smallest_ai, smallest_bi });
+    size_t smallest_di = index_closest_except(xs, p, { smallest_ai, smallest_bi, smallest_ci });
 
     // Okay, now create vectors that are from the center of the cube to these 3 closest points
     const Vec3 av = xs[smallest_ai] - m_pos;
@@ -0,0 +1,58 @@
+#pragma once
+
+// The demo scene, defined at compile time
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "color.hpp"
+#include "cube.hpp"
+#include "plane.hpp"
+#include "point.hpp"
+#include "scene.hpp"
+#include "sphere.hpp"
+#include "staticscene.hpp"
+#include "vec3.hpp"
+
+// DemoScene is the scene that is shown when no scene file is given: a light, a plane, three
+// spheres and a cube, placed for a screen of W x H. Everything in it is a constant expression,
+// so when it is declared constexpr, nothing is calculated when the program runs. This includes
+// the terms and the bounds of its static scene, for rays from the view point.
+struct DemoScene {
+    const Sphere light;
+    const Plane plane;
+    const std::array<Sphere, 3> spheres;
+    const Cube cube;
+    const RGB backgroundColor;
+
+    const Point3 viewPoint; // where the camera starts, see demoCamera in main.cpp
+
+    // scene creates a Scene that can be changed while the program runs
+    const Scene scene() const;
+
+    // static_scene creates a scene with the same content, that has a fixed number of objects,
+    // and the sphere terms for rays from the view point
+    constexpr const StaticScene<3, 1, 1> static_scene() const;
+};
+
+constexpr auto demo_scene(double W, double H) -> DemoScene
+{
+    const std::array<Sphere, 3> spheres { Sphere { Vec3 { W * .4, H * .5, 50 }, 50 },
+        Sphere { Vec3 { W * .5, H * .5, 50 }, 50 }, Sphere { Vec3 { W * .6, H * .5, 50 }, 50 } };
+    const Cube cube { Vec3 { W * .7, H * .5, 50 }, 50 };
+    const Point3 viewPoint { W * .5, H * .5, -W * 2.0 };
+    return DemoScene { Sphere { Vec3 { 0, 0, 50 }, 1 },
+        Plane { Vec3 { 0, 0, 100 }, Vec3 { 0, 0, 1 } }, spheres, cube, Color::darkgray, viewPoint };
+}
+
+inline const Scene DemoScene::scene() const
+{
+    return Scene { light, plane, std::vector<Sphere>(spheres.begin(), spheres.end()), cube,
+        backgroundColor };
+}
+
+constexpr const StaticScene<3, 1, 1> DemoScene::static_scene() const
+{
+    return StaticScene<3, 1, 1> { light, { plane }, spheres, { cube }, backgroundColor, viewPoint };
+}
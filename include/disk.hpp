@@ -74,21 +74,21 @@ inline std::ostream& operator<<(std::ostream& os, const Disk& s)
     return os;
 }
 
-double Disk::x() const { return m_pos.x(); }
+inline double Disk::x() const { return m_pos.x(); }
 
-double Disk::y() const { return m_pos.y(); }
+inline double Disk::y() const { return m_pos.y(); }
 
-double Disk::z() const { return m_pos.z(); }
+inline double Disk::z() const { return m_pos.z(); }
 
-double Disk::rx() const { return m_radius_vector.x(); }
+inline double Disk::rx() const { return m_radius_vector.x(); }
 
-double Disk::ry() const { return m_radius_vector.y(); }
+inline double Disk::ry() const { return m_radius_vector.y(); }
 
-double Disk::rz() const { return m_radius_vector.z(); }
+inline double Disk::rz() const { return m_radius_vector.z(); }
 
-const Vec3 Disk::radius() const { return m_radius_vector; }
+inline const Vec3 Disk::radius() const { return m_radius_vector; }
 
-const Vec3 Disk::pos() const { return m_pos; }
+inline const Vec3 Disk::pos() const { return m_pos; }
 
 // Get the normal sticking out from the disk at the point p on the surface of the disk
 /*const Vec3 Disk::normal(const Vec3 p) const
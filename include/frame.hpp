@@ -0,0 +1,262 @@
+#pragma once
+
+// What is needed for tracing one frame: the view frustum of the camera, and the visible objects
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "arena.hpp"
+#include "camera.hpp"
+#include "colorbuffer.hpp"
+#include "framearenas.hpp"
+#include "point.hpp"
+#include "simd.hpp"
+#include "vec3.hpp"
+
+// Frustum is the part of the scene that a camera can see: a pyramid going out from the camera,
+// bounded by the four sides of the screen. It has no far plane.
+class Frustum {
+protected:
+    const Point3 m_pos;
+    const Vec3 m_right;
+    const Vec3 m_down;
+    const Vec3 m_forward;
+    const double m_tanX; // half the width and height of the view, at a distance of 1
+    const double m_tanY;
+    const double m_normX; // for turning plane equations into distances
+    const double m_normY;
+
+public:
+    Frustum(const Camera& camera, double aspect)
+        : m_pos { camera.pos() }
+        , m_right { camera.right() }
+        , m_down { camera.down() }
+        , m_forward { camera.forward() }
+        , m_tanX { camera.tan_half_fov() * aspect }
+        , m_tanY { camera.tan_half_fov() }
+        , m_normX { 1 / std::sqrt(1 + m_tanX * m_tanX) }
+        , m_normY { 1 / std::sqrt(1 + m_tanY * m_tanY) }
+    {
+    }
+
+    // contains checks if any part of a sphere with the given center and radius is inside
+    bool contains(const Point3 center, double radius) const;
+
+    // bounds finds the part of the screen that a sphere may cover, where (0, 0) is the top left
+    // corner and (1, 1) is the bottom right corner. If the sphere reaches the plane that the
+    // camera is in, it may cover any part of the screen, and false is returned.
+    bool bounds(const Point3 center, double radius, double& u0, double& v0, double& u1,
+        double& v1) const;
+};
+
+// The center is moved into the space of the camera, and then checked against each side of the
+// pyramid, and against the plane that the camera is in
+inline bool Frustum::contains(const Point3 center, double radius) const
+{
+    const Vec3 q = center - m_pos;
+    const double x = q.dot(m_right);
+    const double y = q.dot(m_down);
+    const double z = q.dot(m_forward);
+    return z >= -radius && (z * m_tanX - x) * m_normX >= -radius
+        && (z * m_tanX + x) * m_normX >= -radius && (z * m_tanY - y) * m_normY >= -radius
+        && (z * m_tanY + y) * m_normY >= -radius;
+}
+
+// The sphere is inside of a box in the space of the camera, and every point in that box is in
+// front of the camera. x / z and y / z are then largest and smallest in the corners of the box.
+inline bool Frustum::bounds(const Point3 center, double radius, double& u0, double& v0,
+    double& u1, double& v1) const
+{
+    const Vec3 q = center - m_pos;
+    const double x = q.dot(m_right);
+    const double y = q.dot(m_down);
+    const double z = q.dot(m_forward);
+    if (z - radius <= 0) {
+        return false;
+    }
+    const double x0 = std::min((x - radius) / (z - radius), (x - radius) / (z + radius));
+    const double x1 = std::max((x + radius) / (z - radius), (x + radius) / (z + radius));
+    const double y0 = std::min((y - radius) / (z - radius), (y - radius) / (z + radius));
+    const double y1 = std::max((y + radius) / (z - radius), (y + radius) / (z + radius));
+    u0 = (x0 / m_tanX + 1) / 2;
+    u1 = (x1 / m_tanX + 1) / 2;
+    v0 = (y0 / m_tanY + 1) / 2;
+    v1 = (y1 / m_tanY + 1) / 2;
+    return true;
+}
+
+// SphereTerms is the part of the intersection test for a sphere that is the same for every ray
+// that starts at the camera: the center of the sphere relative to the camera, and c, which is the
+// squared distance from the camera to the center, minus the squared radius.
+struct SphereTerms {
+    double x;
+    double y;
+    double z;
+    double c;
+};
+
+// TileRect is the tiles that an object may cover, from (x0, y0) to (x1, y1). If x0 > x1, no
+// tiles are covered.
+struct TileRect {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// TileLists has one list of object indices per tile, stored after each other in one array. The
+// objects of tile t are items[start[t]] up to, but not including, items[start[t + 1]].
+struct TileLists {
+    std::vector<uint32_t> start;
+    std::vector<uint32_t> items;
+};
+
+// TileObjects is the objects that the rays of one tile may hit, in the same order as in the
+// frame. It can be passed to Scene::color, like a Frame.
+// The arena is the one of the thread that traces the tile. Data that is only needed while the
+// tile is traced can be placed there, and is freed when the next frame starts.
+struct TileObjects {
+    const uint32_t* spheres;
+    size_t sphereCount;
+    const uint32_t* cubes;
+    size_t cubeCount;
+    const uint32_t* meshes;
+    size_t meshCount;
+    const SphereTerms* terms; // for all spheres in the scene, by index
+    SphereLanes lanes; // the sphere terms of this tile, in the same order as the spheres
+    Arena* memory;
+
+    size_t sphere_count() const { return sphereCount; }
+    size_t cube_count() const { return cubeCount; }
+    size_t mesh_count() const { return meshCount; }
+
+    uint32_t sphere(size_t i) const { return spheres[i]; }
+    uint32_t cube(size_t i) const { return cubes[i]; }
+    uint32_t mesh(size_t i) const { return meshes[i]; }
+
+    const SphereTerms* sphere_terms() const { return terms; }
+    const SphereLanes& sphere_lanes() const { return lanes; }
+    Arena& arena() const { return *memory; }
+};
+
+// Frame lists the objects that are inside of the view frustum, as indices into the lists of the
+// scene. It is filled in once per frame by Scene::cull, so that objects that are off-screen are
+// never tested for each pixel. Planes are infinite, and are always tested.
+// After Scene::bin, the objects are also sorted into tiles of 16x16 pixels, so that the rays of
+// a tile only test the objects that cover that part of the screen.
+// The lists are kept from one frame to the next, so that their memory can be reused.
+class Frame {
+protected:
+    std::vector<uint32_t> m_cursor; // only used while binning
+
+public:
+    static constexpr int tileSize = 16;
+
+    std::vector<uint32_t> spheres;
+    std::vector<uint32_t> cubes;
+    std::vector<uint32_t> meshes;
+
+    // One per sphere in the scene, by index, but only filled in for the visible spheres
+    std::vector<SphereTerms> sphereTerms;
+
+    // The size of the screen in pixels, and in tiles, from the last call to Scene::bin
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+
+    TileLists tileSpheres;
+    TileLists tileCubes;
+    TileLists tileMeshes;
+
+    // The memory for data that is only needed while the frame is traced, one arena per thread.
+    // Scene::cull starts a new frame.
+    FrameArenas arenas;
+
+    std::vector<TileRect> rects; // one per object, filled in by Scene::bin before calling bin
+
+    // The colors that are traced for each pixel, before they are packed into pixels
+    ColorBuffer colors;
+
+    // bin sorts the given objects into the given tile lists, using one rect per object
+    void bin(const std::vector<uint32_t>& objects, TileLists& lists);
+
+    // tile returns the objects of the tile at (tx, ty). The sphere terms of the spheres of the
+    // tile are copied to the arena of the calling thread, with each term in its own array, for
+    // the SIMD kernels, so the tile should be fetched once by the thread that traces it.
+    const TileObjects tile(int tx, int ty);
+
+    size_t sphere_count() const { return spheres.size(); }
+    size_t cube_count() const { return cubes.size(); }
+    size_t mesh_count() const { return meshes.size(); }
+
+    uint32_t sphere(size_t i) const { return spheres[i]; }
+    uint32_t cube(size_t i) const { return cubes[i]; }
+    uint32_t mesh(size_t i) const { return meshes[i]; }
+
+    const SphereTerms* sphere_terms() const { return sphereTerms.data(); }
+};
+
+// bin is a counting sort: first count the objects of each tile, then find where each list starts,
+// and then place the objects. The objects stay in the same order within each list.
+inline void Frame::bin(const std::vector<uint32_t>& objects, TileLists& lists)
+{
+    const size_t tiles = static_cast<size_t>(tilesX) * tilesY;
+    lists.start.assign(tiles + 1, 0);
+    for (const auto& r : rects) {
+        for (int ty = r.y0; ty <= r.y1; ++ty) {
+            for (int tx = r.x0; tx <= r.x1; ++tx) {
+                ++lists.start[static_cast<size_t>(ty) * tilesX + tx + 1];
+            }
+        }
+    }
+    for (size_t t = 0; t < tiles; ++t) {
+        lists.start[t + 1] += lists.start[t];
+    }
+    lists.items.resize(lists.start[tiles]);
+    m_cursor.assign(lists.start.begin(), lists.start.end() - 1);
+    for (size_t k = 0; k < objects.size(); ++k) {
+        const auto& r = rects[k];
+        for (int ty = r.y0; ty <= r.y1; ++ty) {
+            for (int tx = r.x0; tx <= r.x1; ++tx) {
+                lists.items[m_cursor[static_cast<size_t>(ty) * tilesX + tx]++] = objects[k];
+            }
+        }
+    }
+}
+
+// The lanes are padded with spheres that are never hit, up to a multiple of simdWidth. The four
+// arrays are placed after each other, in one allocation that starts at a cache line.
+inline const TileObjects Frame::tile(int tx, int ty)
+{
+    const size_t t = static_cast<size_t>(ty) * tilesX + tx;
+    const uint32_t* tiled = tileSpheres.items.data() + tileSpheres.start[t];
+    const size_t count = tileSpheres.start[t + 1] - tileSpheres.start[t];
+    const size_t padded = (count + simdWidth - 1) / simdWidth * simdWidth;
+    Arena& arena = arenas.local();
+    double* lanes = static_cast<double*>(arena.allocate(4 * padded * sizeof(double), 64));
+    double* x = lanes;
+    double* y = lanes + padded;
+    double* z = lanes + 2 * padded;
+    double* c = lanes + 3 * padded;
+    for (size_t k = 0; k < count; ++k) {
+        const auto& terms = sphereTerms[tiled[k]];
+        x[k] = terms.x;
+        y[k] = terms.y;
+        z[k] = terms.z;
+        c[k] = terms.c;
+    }
+    for (size_t k = count; k < padded; ++k) {
+        x[k] = y[k] = z[k] = 0;
+        c[k] = std::numeric_limits<double>::infinity();
+    }
+    return TileObjects { tiled, count, tileCubes.items.data() + tileCubes.start[t],
+        tileCubes.start[t + 1] - tileCubes.start[t],
+        tileMeshes.items.data() + tileMeshes.start[t],
+        tileMeshes.start[t + 1] - tileMeshes.start[t], sphereTerms.data(),
+        SphereLanes { x, y, z, c, padded }, &arena };
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// One arena per thread, for the data that is only needed while a frame is traced
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "omp.h"
+
+#include "arena.hpp"
+
+using namespace std::string_literals;
+
+// ArenaStats is how much memory the arenas of a frame use, added up over the threads
+struct ArenaStats {
+    size_t threads; // the number of arenas
+    size_t used; // bytes handed out since the frame started
+    size_t peak; // the most bytes that each arena has handed out in any one frame so far
+    size_t reserved; // bytes reserved from the system
+};
+
+// FrameArenas has an arena for each OpenMP thread. Each thread only allocates from its own arena,
+// so threads never wait for each other or for the global heap, and each arena is in cache lines
+// of its own, so that the threads never write to the same cache line.
+//
+// All arenas are reset by begin_frame. Each arena then keeps one block that is as large as the
+// most that it has used in any one frame so far, so that after the first frames, a frame does not
+// allocate. The peak never goes down, so a scene that was once crowded keeps its memory until the
+// FrameArenas is destroyed.
+class FrameArenas {
+protected:
+    struct alignas(64) ThreadArena {
+        Arena arena;
+        size_t peak = 0;
+    };
+
+    std::vector<std::unique_ptr<ThreadArena>> m_arenas;
+
+public:
+    // begin_frame frees everything that was allocated in the last frame, in all arenas, and makes
+    // sure that there is an arena for each thread that OpenMP may start. It is the only function
+    // that adds arenas, and must not be called while the threads are using the arenas.
+    void begin_frame();
+
+    // local returns the arena of the calling thread. It throws if the thread has no arena, which
+    // means that begin_frame was not called, or that a loop was started with more threads.
+    Arena& local();
+
+    ArenaStats stats() const;
+};
+
+inline void FrameArenas::begin_frame()
+{
+    const auto threads = static_cast<size_t>(std::max(omp_get_max_threads(), 1));
+    while (m_arenas.size() < threads) {
+        m_arenas.push_back(std::make_unique<ThreadArena>());
+    }
+    for (auto& thread : m_arenas) {
+        thread->peak = std::max(thread->peak, thread->arena.used());
+        // A new block may start at a different alignment, which can take up to a cache line more
+        thread->arena.reset(thread->peak + 64);
+    }
+}
+
+inline Arena& FrameArenas::local()
+{
+    const auto i = static_cast<size_t>(omp_get_thread_num());
+    if (i >= m_arenas.size()) {
+        throw std::runtime_error("no frame arena for thread "s + std::to_string(i)
+            + ", begin_frame must be called first"s);
+    }
+    return m_arenas[i]->arena;
+}
+
+inline ArenaStats FrameArenas::stats() const
+{
+    ArenaStats stats { m_arenas.size(), 0, 0, 0 };
+    for (const auto& thread : m_arenas) {
+        stats.used += thread->arena.used();
+        stats.peak += std::max(thread->peak, thread->arena.used());
+        stats.reserved += thread->arena.reserved();
+    }
+    return stats;
+}
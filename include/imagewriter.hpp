@@ -0,0 +1,59 @@
+#pragma once
+
+// Writing images to disk on a background thread
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ImageWriter writes images as binary PPM files, on a thread of its own, so that the render
+// threads can go on with the next image while the last one is written. If images are queued
+// faster than they can be written, write waits until there is room, so that no more than
+// maxQueued images are kept in memory.
+class ImageWriter {
+protected:
+    struct Image {
+        std::string filename;
+        int width;
+        int height;
+        std::vector<uint8_t> rgb; // three bytes per pixel, row by row
+    };
+
+    static constexpr size_t maxQueued = 16;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<Image> m_queue;
+    size_t m_writing = 0; // images that have been taken from the queue, but not written yet
+    size_t m_written = 0;
+    std::vector<std::string> m_failed;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    void run();
+
+public:
+    ImageWriter();
+
+    // Write everything that is queued, and then stop the thread
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    // write queues an image of width x height pixels, with three bytes per pixel. It can be
+    // called from any thread.
+    void write(std::string filename, int width, int height, std::vector<uint8_t> rgb);
+
+    // wait waits until every queued image has been written, and returns the filenames of the
+    // images that could not be written since the last call
+    std::vector<std::string> wait();
+
+    // The number of images that have been written so far
+    size_t written();
+};
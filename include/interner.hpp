@@ -0,0 +1,106 @@
+#pragma once
+
+// Interned strings, where each distinct string is stored once and gets a small number
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+
+// Interner gives each distinct string a number, starting at 0, and keeps a copy of the string in
+// an arena. Comparing two interned strings is then just comparing two numbers. The lookup table
+// uses open addressing, so that interning a string that has been seen before allocates nothing.
+class Interner {
+protected:
+    Arena& m_arena;
+    std::vector<std::string_view> m_strings; // the string for each number
+    std::vector<uint32_t> m_slots; // the number + 1 for each slot, or 0 if the slot is empty
+
+    void grow();
+
+public:
+    explicit Interner(Arena& arena)
+        : m_arena { arena }
+    {
+    }
+
+    // Find the number for a string, adding the string if it has not been seen before
+    uint32_t intern(std::string_view s);
+
+    // Find the number for a string, or -1 if the string has not been interned
+    int64_t find(std::string_view s) const;
+
+    // The string with the given number. It stays valid until the arena is reset.
+    std::string_view str(uint32_t id) const;
+
+    // The number of distinct strings
+    size_t size() const;
+
+    // Forget all strings. This must be done when the arena is reset.
+    void clear();
+};
+
+inline uint32_t Interner::intern(std::string_view s)
+{
+    if ((m_strings.size() + 1) * 2 > m_slots.size()) {
+        grow();
+    }
+    const size_t mask = m_slots.size() - 1;
+    for (size_t i = std::hash<std::string_view> {}(s) & mask;; i = (i + 1) & mask) {
+        const uint32_t slot = m_slots[i];
+        if (slot == 0) {
+            // Not seen before, copy the string into the arena
+            char* copy = static_cast<char*>(m_arena.allocate(s.size(), 1));
+            std::memcpy(copy, s.data(), s.size());
+            const auto id = static_cast<uint32_t>(m_strings.size());
+            m_strings.emplace_back(copy, s.size());
+            m_slots[i] = id + 1;
+            return id;
+        }
+        if (m_strings[slot - 1] == s) {
+            return slot - 1;
+        }
+    }
+}
+
+inline int64_t Interner::find(std::string_view s) const
+{
+    if (m_slots.empty()) {
+        return -1;
+    }
+    const size_t mask = m_slots.size() - 1;
+    for (size_t i = std::hash<std::string_view> {}(s) & mask; m_slots[i] != 0; i = (i + 1) & mask) {
+        if (m_strings[m_slots[i] - 1] == s) {
+            return m_slots[i] - 1;
+        }
+    }
+    return -1;
+}
+
+// Double the size of the table, and place all strings again
+inline void Interner::grow()
+{
+    m_slots.assign(m_slots.empty() ? 64 : m_slots.size() * 2, 0);
+    const size_t mask = m_slots.size() - 1;
+    for (uint32_t id = 0; id < m_strings.size(); ++id) {
+        size_t i = std::hash<std::string_view> {}(m_strings[id]) & mask;
+        while (m_slots[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        m_slots[i] = id + 1;
+    }
+}
+
+inline std::string_view Interner::str(uint32_t id) const { return m_strings[id]; }
+
+inline size_t Interner::size() const { return m_strings.size(); }
+
+inline void Interner::clear()
+{
+    m_strings.clear();
+    std::fill(m_slots.begin(), m_slots.end(), 0);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+// Read-only memory mapped files
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+// MappedFile maps the contents of a file into memory, read-only. The pages are only read from
+// disk when they are first accessed, and the contents stay valid for as long as the MappedFile
+// exists. Throws std::runtime_error if the file can not be opened or mapped.
+class MappedFile {
+protected:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : m_data { std::exchange(other.m_data, nullptr) }
+        , m_size { std::exchange(other.m_size, 0) }
+    {
+    }
+
+    const char* data() const;
+    size_t size() const;
+    const std::string_view view() const;
+};
+
+inline MappedFile::MappedFile(const std::string& filename)
+{
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("could not open "s + filename + ": "s + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const int err = errno;
+        close(fd);
+        throw std::runtime_error("could not stat "s + filename + ": "s + std::strerror(err));
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    if (m_size == 0) { // empty files can not be mapped, but there is nothing to read anyway
+        close(fd);
+        return;
+    }
+    void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    const int err = errno;
+    close(fd); // the mapping stays valid after the file is closed
+    if (p == MAP_FAILED) {
+        m_size = 0;
+        throw std::runtime_error("could not map "s + filename + ": "s + std::strerror(err));
+    }
+    m_data = static_cast<const char*>(p);
+}
+
+inline MappedFile::~MappedFile()
+{
+    if (m_data != nullptr) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+// data returns a pointer to the first byte of the file, or nullptr if the file is empty
+inline const char* MappedFile::data() const { return m_data; }
+
+// size returns the size of the file, in bytes
+inline size_t MappedFile::size() const { return m_size; }
+
+// view returns the contents of the file as a string_view
+inline const std::string_view MappedFile::view() const
+{
+    return m_data ? std::string_view { m_data, m_size } : std::string_view {};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Math policies, for choosing between exact and fast square roots at compile time
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+#include "point.hpp"
+#include "vec3.hpp"
+
+// ExactMath uses std::sqrt, and gives the same results as the Vec3 methods
+struct ExactMath {
+    static double rsqrt(double x) { return 1.0 / std::sqrt(x); }
+    static const Vec3 normalize(const Vec3 v) { return v.normalize(); }
+    static double distance(const Point3 a, const Point3 b) { return a.distance(b); }
+};
+
+// FastMath uses the reciprocal square root estimate of the CPU, followed by one Newton-Raphson
+// step, which gives about 22 correct bits. There is no division and no full square root.
+// The results are close enough for shading, but should not be used for intersection tests.
+struct FastMath {
+    static double rsqrt(double x);
+    static const Vec3 normalize(const Vec3 v);
+    static double distance(const Point3 a, const Point3 b);
+};
+
+inline double FastMath::rsqrt(double x)
+{
+#if defined(__SSE__)
+    // rsqrtss is only available for floats, and is accurate to about 12 bits
+    const double y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(static_cast<float>(x))));
+#else
+    // Without SSE, start from the well known bit pattern trick instead. It is only accurate to
+    // about 5 bits, so two more Newton-Raphson steps are needed to get as close.
+    double y = std::bit_cast<double>(0x5fe6eb50c7b537a9 - (std::bit_cast<uint64_t>(x) >> 1));
+    y = y * (1.5 - 0.5 * x * y * y);
+    y = y * (1.5 - 0.5 * x * y * y);
+#endif
+    // One Newton-Raphson step roughly doubles the number of correct bits
+    return y * (1.5 - 0.5 * x * y * y);
+}
+
+inline const Vec3 FastMath::normalize(const Vec3 v) { return v * rsqrt(v.len_squared()); }
+
+inline double FastMath::distance(const Point3 a, const Point3 b)
+{
+    const double d = a.distance_squared(b);
+    if (d == 0) {
+        return 0;
+    }
+    return d * rsqrt(d);
+}
@@ -1,10 +1,441 @@
 #pragma once
 
-// WORK IN PROGRESS
+// An indexed triangle mesh
 
-// A mesh is a collection of faces?
-// A face is a collection of vertex indices + the lookup table? Hash map?
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
-// Go: map[VertexIndex]Vec3
+#include "color.hpp"
+#include "point.hpp"
+#include "quat.hpp"
+#include "triangle.hpp"
+#include "vec3.hpp"
 
-// An object is a position + rot + scale + a mesh?
+using namespace std::string_literals;
+
+// TriangleBlock holds the data the ray/triangle test needs for several triangles at once:
+// the first corner and the two edges going out from it. The data is stored one array per
+// coordinate, so that the same coordinate of all the triangles in a block can be loaded
+// into a single SIMD register. Unused lanes are filled with degenerate triangles that can
+// never be hit.
+struct alignas(32) TriangleBlock {
+    static constexpr size_t size = 8;
+
+    float v0x[size], v0y[size], v0z[size]; // first corner
+    float e1x[size], e1y[size], e1z[size]; // edge from the first to the second corner
+    float e2x[size], e2y[size], e2z[size]; // edge from the first to the third corner
+};
+
+// Intersect a ray with all triangles in a block, using the Möller–Trumbore algorithm.
+// The distance along the ray (in units of the ray direction) is written to t for each triangle,
+// or infinity if the triangle is not hit. The loop has no branches, so that it can be vectorized.
+inline void intersect_block(const TriangleBlock& b, const float o[3], const float d[3],
+    float t[TriangleBlock::size])
+{
+    constexpr float epsilon = 1e-7f;
+    constexpr float inf = std::numeric_limits<float>::infinity();
+
+#pragma omp simd
+    for (size_t i = 0; i < TriangleBlock::size; ++i) {
+        // p = d x e2
+        const float px = d[1] * b.e2z[i] - d[2] * b.e2y[i];
+        const float py = d[2] * b.e2x[i] - d[0] * b.e2z[i];
+        const float pz = d[0] * b.e2y[i] - d[1] * b.e2x[i];
+
+        // The determinant is close to 0 if the ray is parallel to the triangle
+        const float det = b.e1x[i] * px + b.e1y[i] * py + b.e1z[i] * pz;
+        const float invDet = 1.0f / det;
+
+        // s = o - v0, from the first corner to the ray origin
+        const float sx = o[0] - b.v0x[i];
+        const float sy = o[1] - b.v0y[i];
+        const float sz = o[2] - b.v0z[i];
+
+        // First barycentric coordinate
+        const float u = (sx * px + sy * py + sz * pz) * invDet;
+
+        // q = s x e1
+        const float qx = sy * b.e1z[i] - sz * b.e1y[i];
+        const float qy = sz * b.e1x[i] - sx * b.e1z[i];
+        const float qz = sx * b.e1y[i] - sy * b.e1x[i];
+
+        // Second barycentric coordinate, and the distance along the ray
+        const float v = (d[0] * qx + d[1] * qy + d[2] * qz) * invDet;
+        const float dist = (b.e2x[i] * qx + b.e2y[i] * qy + b.e2z[i] * qz) * invDet;
+
+        const bool hit = std::fabs(det) > epsilon && u >= 0 && v >= 0 && u + v <= 1
+            && dist > epsilon;
+        t[i] = hit ? dist : inf;
+    }
+}
+
+// Mesh is a collection of triangles that share corners. The corners are stored once, in a vertex
+// buffer, and each triangle is three indices into the vertex buffer. The mesh can be rotated
+// around the center of its bounding box, without changing the vertices.
+// Rays are only tested against the triangle blocks, so the indices are not read while tracing.
+class Mesh {
+protected:
+    // Geometry is everything that stays the same when the mesh is rotated, so that a rotated mesh
+    // can share it with the mesh that it was rotated from
+    struct Geometry {
+        // The vertex buffer, one array per coordinate
+        std::span<const float> x;
+        std::span<const float> y;
+        std::span<const float> z;
+
+        // Three vertex indices per triangle
+        std::span<const uint32_t> indices;
+
+        // The triangles, prepared for the ray/triangle test
+        std::span<const TriangleBlock> blocks;
+
+        // The bounding box of all the vertices
+        float min[3];
+        float max[3];
+
+        // The memory that the spans point into: the vectors, for a mesh that is prepared when it
+        // is created, or memory that the owner keeps alive, like a mapped scene file
+        std::vector<float> storedX;
+        std::vector<float> storedY;
+        std::vector<float> storedZ;
+        std::vector<uint32_t> storedIndices;
+        std::vector<TriangleBlock> storedBlocks;
+        std::shared_ptr<const void> owner;
+
+        void build();
+    };
+
+    const std::shared_ptr<const Geometry> m_geometry;
+    const RGB m_color;
+    const Quat m_rotation;
+
+    static auto make_geometry(std::vector<float> x, std::vector<float> y, std::vector<float> z,
+        std::vector<uint32_t> indices) -> std::shared_ptr<const Geometry>;
+    static auto map_geometry(std::span<const float> x, std::span<const float> y,
+        std::span<const float> z, std::span<const uint32_t> indices,
+        std::span<const TriangleBlock> blocks, const Point3 min, const Point3 max,
+        std::shared_ptr<const void> owner) -> std::shared_ptr<const Geometry>;
+
+    Mesh(std::shared_ptr<const Geometry> geometry, const RGB color, const Quat rotation)
+        : m_geometry { std::move(geometry) }
+        , m_color { color }
+        , m_rotation { rotation }
+    {
+    }
+
+public:
+    Mesh(std::vector<float> x, std::vector<float> y, std::vector<float> z,
+        std::vector<uint32_t> indices, const RGB color = Color::gray,
+        const Quat rotation = Quat::identity())
+        : Mesh { make_geometry(std::move(x), std::move(y), std::move(z), std::move(indices)),
+            color, rotation }
+    {
+    }
+
+    // Create a mesh from triangle blocks and a bounding box that are already prepared, without
+    // copying anything. The spans must stay valid for as long as the owner exists, like the
+    // columns of a mapped scene file.
+    Mesh(std::span<const float> x, std::span<const float> y, std::span<const float> z,
+        std::span<const uint32_t> indices, std::span<const TriangleBlock> blocks,
+        const Point3 min, const Point3 max, std::shared_ptr<const void> owner, const RGB color,
+        const Quat rotation)
+        : Mesh { map_geometry(x, y, z, indices, blocks, min, max, std::move(owner)), color,
+            rotation }
+    {
+    }
+
+    const std::string str() const;
+
+    size_t vertex_count() const;
+    size_t triangle_count() const;
+
+    const Point3 vertex(size_t i) const;
+    const Triangle triangle(size_t i) const;
+    const Vec3 normal(size_t i) const; // the normal of triangle i, from its triangle block
+
+    const Point3 min() const;
+    const Point3 max() const;
+    const Point3 center() const; // the center of the bounding box
+    double bounding_radius() const; // the radius of a sphere around the center, for any rotation
+
+    const RGB color() const;
+    const Quat rotation() const;
+
+    // The vertex buffer, the index buffer and the prepared triangles
+    const std::span<const float> xs() const;
+    const std::span<const float> ys() const;
+    const std::span<const float> zs() const;
+    const std::span<const uint32_t> indices() const;
+    const std::span<const TriangleBlock> blocks() const;
+
+    const std::optional<std::pair<double, size_t>> closest_hit(
+        const Point3 origin, const Vec3 direction) const;
+
+    // Create a new mesh that is moved and scaled to fit within a cube
+    const Mesh fit(const Point3 center, double size) const;
+
+    // Create a new mesh that is rotated some more, around the center of the bounding box.
+    // The vertices are not changed, and are shared with this mesh, so this does not copy them.
+    // Instead, rays are rotated the other way when testing.
+    const Mesh rotate(const Quat rotation) const;
+};
+
+inline auto Mesh::make_geometry(std::vector<float> x, std::vector<float> y, std::vector<float> z,
+    std::vector<uint32_t> indices) -> std::shared_ptr<const Geometry>
+{
+    auto geometry = std::make_shared<Geometry>();
+    geometry->storedX = std::move(x);
+    geometry->storedY = std::move(y);
+    geometry->storedZ = std::move(z);
+    geometry->storedIndices = std::move(indices);
+    geometry->x = geometry->storedX;
+    geometry->y = geometry->storedY;
+    geometry->z = geometry->storedZ;
+    geometry->indices = geometry->storedIndices;
+    geometry->build();
+    return geometry;
+}
+
+inline auto Mesh::map_geometry(std::span<const float> x, std::span<const float> y,
+    std::span<const float> z, std::span<const uint32_t> indices,
+    std::span<const TriangleBlock> blocks, const Point3 min, const Point3 max,
+    std::shared_ptr<const void> owner) -> std::shared_ptr<const Geometry>
+{
+    auto geometry = std::make_shared<Geometry>();
+    geometry->x = x;
+    geometry->y = y;
+    geometry->z = z;
+    geometry->indices = indices;
+    geometry->blocks = blocks;
+    geometry->min[0] = static_cast<float>(min.x());
+    geometry->min[1] = static_cast<float>(min.y());
+    geometry->min[2] = static_cast<float>(min.z());
+    geometry->max[0] = static_cast<float>(max.x());
+    geometry->max[1] = static_cast<float>(max.y());
+    geometry->max[2] = static_cast<float>(max.z());
+    geometry->owner = std::move(owner);
+    return geometry;
+}
+
+// Prepare the triangle blocks and the bounding box
+inline void Mesh::Geometry::build()
+{
+    const size_t count = indices.size() / 3;
+    const auto blockCount
+        = static_cast<long>((count + TriangleBlock::size - 1) / TriangleBlock::size);
+    storedBlocks.assign(blockCount, TriangleBlock {});
+    blocks = storedBlocks;
+
+    // Each thread fills in whole blocks, so that no two threads write to the same block
+#pragma omp parallel for if (blockCount > 4096)
+    for (long bi = 0; bi < blockCount; ++bi) {
+        TriangleBlock& block = storedBlocks[bi];
+        for (size_t lane = 0; lane < TriangleBlock::size; ++lane) {
+            const size_t i = bi * TriangleBlock::size + lane;
+            if (i >= count) {
+                break; // the remaining lanes stay degenerate
+            }
+            const uint32_t a = indices[i * 3];
+            const uint32_t b = indices[i * 3 + 1];
+            const uint32_t c = indices[i * 3 + 2];
+            block.v0x[lane] = x[a];
+            block.v0y[lane] = y[a];
+            block.v0z[lane] = z[a];
+            block.e1x[lane] = x[b] - x[a];
+            block.e1y[lane] = y[b] - y[a];
+            block.e1z[lane] = z[b] - z[a];
+            block.e2x[lane] = x[c] - x[a];
+            block.e2y[lane] = y[c] - y[a];
+            block.e2z[lane] = z[c] - z[a];
+        }
+    }
+
+    const auto [minx, maxx] = std::minmax_element(x.begin(), x.end());
+    const auto [miny, maxy] = std::minmax_element(y.begin(), y.end());
+    const auto [minz, maxz] = std::minmax_element(z.begin(), z.end());
+    if (x.empty()) {
+        min[0] = min[1] = min[2] = 0;
+        max[0] = max[1] = max[2] = 0;
+        return;
+    }
+    min[0] = *minx;
+    min[1] = *miny;
+    min[2] = *minz;
+    max[0] = *maxx;
+    max[1] = *maxy;
+    max[2] = *maxz;
+}
+
+// str returns a string representation of the mesh
+// The string function returns a constant string ("const std::string"),
+// and does not modify anything ("const").
+inline const std::string Mesh::str() const
+{
+    std::stringstream ss;
+    ss << "mesh: ("s << vertex_count() << " vertices, "s << triangle_count() << " triangles, "s
+       << min() << " - "s << max();
+    if (!m_rotation.is_identity()) {
+        ss << ", "s << m_rotation;
+    }
+    ss << ")"s;
+    return ss.str();
+}
+
+// Implement support for the << operator, by calling the Mesh str method
+inline std::ostream& operator<<(std::ostream& os, const Mesh& m)
+{
+    os << m.str();
+    return os;
+}
+
+inline size_t Mesh::vertex_count() const { return m_geometry->x.size(); }
+
+inline size_t Mesh::triangle_count() const { return m_geometry->indices.size() / 3; }
+
+inline const Point3 Mesh::vertex(size_t i) const
+{
+    return Point3 { m_geometry->x[i], m_geometry->y[i], m_geometry->z[i] };
+}
+
+inline const Triangle Mesh::triangle(size_t i) const
+{
+    const auto& indices = m_geometry->indices;
+    return Triangle { vertex(indices[i * 3]), vertex(indices[i * 3 + 1]),
+        vertex(indices[i * 3 + 2]) };
+}
+
+// The normal is the cross product of the two edges in the triangle block, which is the same as
+// for the triangle, without looking up its corners through the indices
+inline const Vec3 Mesh::normal(size_t i) const
+{
+    const TriangleBlock& b = m_geometry->blocks[i / TriangleBlock::size];
+    const size_t lane = i % TriangleBlock::size;
+    const Vec3 e1 { b.e1x[lane], b.e1y[lane], b.e1z[lane] };
+    const Vec3 e2 { b.e2x[lane], b.e2y[lane], b.e2z[lane] };
+    return e1.cross(e2).normalize();
+}
+
+// The corner of the bounding box with the smallest coordinates
+inline const Point3 Mesh::min() const
+{
+    return Point3 { m_geometry->min[0], m_geometry->min[1], m_geometry->min[2] };
+}
+
+// The corner of the bounding box with the largest coordinates
+inline const Point3 Mesh::max() const
+{
+    return Point3 { m_geometry->max[0], m_geometry->max[1], m_geometry->max[2] };
+}
+
+inline const Point3 Mesh::center() const
+{
+    const float* lo = m_geometry->min;
+    const float* hi = m_geometry->max;
+    return Point3 { (lo[0] + hi[0]) / 2.0, (lo[1] + hi[1]) / 2.0, (lo[2] + hi[2]) / 2.0 };
+}
+
+inline double Mesh::bounding_radius() const { return center().distance(max()); }
+
+inline const RGB Mesh::color() const { return m_color; }
+
+inline const Quat Mesh::rotation() const { return m_rotation; }
+
+inline const std::span<const float> Mesh::xs() const { return m_geometry->x; }
+
+inline const std::span<const float> Mesh::ys() const { return m_geometry->y; }
+
+inline const std::span<const float> Mesh::zs() const { return m_geometry->z; }
+
+inline const std::span<const uint32_t> Mesh::indices() const { return m_geometry->indices; }
+
+inline const std::span<const TriangleBlock> Mesh::blocks() const { return m_geometry->blocks; }
+
+// closest_hit finds the triangle that a ray hits first.
+// Returns the distance along the ray, in units of the direction vector, and the triangle index,
+// or nullopt if no triangle is hit.
+inline const std::optional<std::pair<double, size_t>> Mesh::closest_hit(
+    const Point3 origin, const Vec3 direction) const
+{
+    const float o[3] = { static_cast<float>(origin.x()), static_cast<float>(origin.y()),
+        static_cast<float>(origin.z()) };
+    const float d[3] = { static_cast<float>(direction.x()), static_cast<float>(direction.y()),
+        static_cast<float>(direction.z()) };
+
+    // First check if the ray hits the bounding box at all (the slab method)
+    const float* lo = m_geometry->min;
+    const float* hi = m_geometry->max;
+    float tmin = 0;
+    float tmax = std::numeric_limits<float>::infinity();
+    for (int axis = 0; axis < 3; ++axis) {
+        const float inv = 1.0f / d[axis];
+        float t0 = (lo[axis] - o[axis]) * inv;
+        float t1 = (hi[axis] - o[axis]) * inv;
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+    }
+    if (tmin > tmax) {
+        return std::nullopt;
+    }
+
+    float closest = std::numeric_limits<float>::infinity();
+    size_t closestIndex = 0;
+    alignas(32) float t[TriangleBlock::size];
+    const auto& blocks = m_geometry->blocks;
+    for (size_t bi = 0; bi < blocks.size(); ++bi) {
+        intersect_block(blocks[bi], o, d, t);
+        for (size_t lane = 0; lane < TriangleBlock::size; ++lane) {
+            if (t[lane] < closest) {
+                closest = t[lane];
+                closestIndex = bi * TriangleBlock::size + lane;
+            }
+        }
+    }
+
+    if (closest == std::numeric_limits<float>::infinity()) {
+        return std::nullopt;
+    }
+    return std::pair { static_cast<double>(closest), closestIndex };
+}
+
+// fit creates a new mesh where the bounding box is centered on the given point, and the longest
+// side of the bounding box has the given size. The indices are copied from the original mesh.
+inline const Mesh Mesh::fit(const Point3 center, double size) const
+{
+    const Geometry& g = *m_geometry;
+    const float longest
+        = std::max({ g.max[0] - g.min[0], g.max[1] - g.min[1], g.max[2] - g.min[2] });
+    const float scale = longest > 0 ? static_cast<float>(size) / longest : 1.0f;
+    const float mid[3] = { (g.min[0] + g.max[0]) / 2, (g.min[1] + g.max[1]) / 2,
+        (g.min[2] + g.max[2]) / 2 };
+    const float to[3] = { static_cast<float>(center.x()), static_cast<float>(center.y()),
+        static_cast<float>(center.z()) };
+
+    std::vector<float> x(g.x.size());
+    std::vector<float> y(g.y.size());
+    std::vector<float> z(g.z.size());
+    for (size_t i = 0; i < g.x.size(); ++i) {
+        x[i] = (g.x[i] - mid[0]) * scale + to[0];
+        y[i] = (g.y[i] - mid[1]) * scale + to[1];
+        z[i] = (g.z[i] - mid[2]) * scale + to[2];
+    }
+    return Mesh { std::move(x), std::move(y), std::move(z),
+        std::vector<uint32_t>(g.indices.begin(), g.indices.end()), m_color, m_rotation };
+}
+
+inline const Mesh Mesh::rotate(const Quat rotation) const
+{
+    return Mesh { m_geometry, m_color, rotation * m_rotation };
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// Loading Wavefront OBJ files into meshes
+
+#include <string>
+
+#include "mesh.hpp"
+
+// load_obj loads the vertices and faces of a Wavefront OBJ file into a Mesh.
+// Faces with more than three corners are split into triangles. Texture coordinates, normals,
+// groups and materials are ignored. The file is memory mapped and split into chunks at line
+// boundaries, and the chunks are parsed in parallel.
+// Throws std::runtime_error if the file can not be read or contains invalid faces.
+auto load_obj(const std::string& filename) -> Mesh;
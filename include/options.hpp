@@ -0,0 +1,271 @@
+#pragma once
+
+// Command line options
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "colorbuffer.hpp"
+#include "simd.hpp"
+
+using namespace std::string_literals;
+
+// Options contains the settings that can be given on the command line
+class Options {
+public:
+    // Run the tests instead of opening a window
+    bool test = false;
+
+    // Run the benchmarks instead of opening a window
+    bool bench = false;
+
+    // The window resolution divided by the internal render resolution, in each direction.
+    // 1 traces every window pixel, 2 traces a quarter of the pixels and so on.
+    int upscale = 4;
+
+    // The wanted time for tracing a frame, in milliseconds. If it is set, the render resolution
+    // starts at 1/upscale of the window resolution, and is adjusted between the minimum and
+    // maximum scale, relative to the window, to stay close to it. The default of 0 keeps the
+    // render resolution fixed at 1/upscale of the window resolution.
+    double targetMs = 0;
+    double minScale = 0.125;
+    double maxScale = 1.0;
+
+    // Use exact square roots for shading, instead of the faster approximation
+    bool exactMath = false;
+
+    // How the traced colors, which can be brighter than white, are turned into the colors of
+    // the window, the images and the video
+    ToneMapping toneMapping;
+
+    // The instruction set to use for the SIMD kernels, instead of the best one that the CPU
+    // supports. For comparing them in benchmarks.
+    std::optional<SimdLevel> simd;
+
+    // Wavefront OBJ files to load and add to the scene
+    std::vector<std::string> meshes;
+
+    // A scene file, or a text description of a scene, to use instead of the demo scene
+    std::string scene;
+
+    // Scripts that are run once per frame, in order, for animating the scene.
+    // They are compiled again when they are changed on disk.
+    std::vector<std::string> scripts;
+
+    // A manifest of images to render and write to disk, instead of opening a window
+    std::string batch;
+
+    // The number of frames of the scripted animation to render to numbered image files, as in
+    // frame_0000.ppm, instead of opening a window, and the size of each image
+    int animate = 0;
+    std::string output = "frame.ppm"s;
+    int width = 1980;
+    int height = 1080;
+
+    // Stream the frames as YUV4MPEG2 video to this file, or to standard output if it is "-",
+    // at the size above. With animate, the frames go to the video instead of to images.
+    std::string y4m;
+};
+
+// Print the available command line options
+inline void usage(const char* name)
+{
+    std::cout << "Usage: " << name << " [test|bench] [options]\n\n"s
+              << "  test           run the tests instead of opening a window\n"s
+              << "  bench          run the benchmarks instead of opening a window\n"s
+              << "  --upscale N    trace at 1/N of the window resolution (default 4)\n"s
+              << "  --target-ms MS adjust the render resolution to trace a frame in MS ms\n"s
+              << "                 (default 0, for a fixed render resolution)\n"s
+              << "  --min-scale S  the smallest render scale, relative to the window (0.125)\n"s
+              << "  --max-scale S  the largest render scale, relative to the window (1.0)\n"s
+              << "  --exact        use exact square roots for shading, instead of fast ones\n"s
+              << "  --tonemap NAME map bright colors with a curve: linear, reinhard or aces\n"s
+              << "                 (default linear, which clamps them)\n"s
+              << "  --exposure EV  make the colors brighter or darker by EV stops (default 0)\n"s
+              << "  --auto-exposure\n"s
+              << "                 expose each frame so that its average brightness is middle\n"s
+              << "                 gray, before adding the exposure that is given\n"s
+              << "  --gamma        encode the colors as sRGB, taking the traced ones as linear\n"s
+              << "  --simd NAME    use the given instruction set for the SIMD kernels: scalar,\n"s
+              << "                 sse4.2, avx2 or avx512 (default: the best that the CPU has)\n"s
+              << "  --scene FILE   load the scene from a scene file or a .txt description\n"s
+              << "  --script FILE  run the script in the given file once per frame, and reload\n"s
+              << "                 it when it changes (can be given more than once)\n"s
+              << "  --mesh FILE    add the mesh in the given OBJ file to the scene\n"s
+              << "  --batch FILE   render the images listed in the given manifest to PPM files,\n"s
+              << "                 without opening a window\n"s
+              << "  --animate N    render N frames of the scripts to numbered PPM files, without\n"s
+              << "                 opening a window\n"s
+              << "  --output FILE  the name of the frames, before they are numbered (frame.ppm)\n"s
+              << "  --size WxH     the size of the frames (default 1980x1080)\n"s
+              << "  --y4m FILE     stream the frames as YUV4MPEG2 video to FILE, or to stdout if\n"s
+              << "                 FILE is -, from the window or from --animate\n"s
+              << "  --help         show this help\n"s;
+}
+
+// parse_options parses the command line arguments.
+// If the arguments are invalid, an error is printed and nullopt is returned.
+inline auto parse_options(int argc, char** argv) -> std::optional<Options>
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        // next returns the value that follows the current argument, if there is one
+        const auto next = [&]() -> std::optional<std::string> {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value after " << arg << std::endl;
+                return std::nullopt;
+            }
+            return std::string { argv[++i] };
+        };
+        if (arg == "test"s) {
+            options.test = true;
+        } else if (arg == "bench"s) {
+            options.bench = true;
+        } else if (arg == "--upscale"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.upscale = std::atoi(value->c_str());
+            if (options.upscale < 1 || options.upscale > 16) {
+                std::cerr << "The upscale ratio must be from 1 to 16" << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg == "--target-ms"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.targetMs = std::atof(value->c_str());
+            if (options.targetMs < 0) {
+                std::cerr << "The target frame time can not be negative" << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg == "--min-scale"s || arg == "--max-scale"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            const double scale = std::atof(value->c_str());
+            if (scale <= 0 || scale > 1) {
+                std::cerr << arg << " must be larger than 0 and at most 1" << std::endl;
+                return std::nullopt;
+            }
+            (arg == "--min-scale"s ? options.minScale : options.maxScale) = scale;
+        } else if (arg == "--exact"s) {
+            options.exactMath = true;
+        } else if (arg == "--tonemap"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            const auto curve = tone_map_parse(*value);
+            if (!curve) {
+                std::cerr << "Unknown tone mapping curve: " << *value << std::endl;
+                return std::nullopt;
+            }
+            options.toneMapping.curve = *curve;
+        } else if (arg == "--exposure"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.toneMapping.exposure = std::atof(value->c_str());
+            if (std::fabs(options.toneMapping.exposure) > 20) {
+                std::cerr << "The exposure must be from -20 to 20 stops" << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg == "--auto-exposure"s) {
+            options.toneMapping.autoExposure = true;
+        } else if (arg == "--gamma"s) {
+            options.toneMapping.gamma = true;
+        } else if (arg == "--simd"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.simd = simd_parse(*value);
+            if (!options.simd) {
+                std::cerr << "Unknown instruction set: " << *value << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg == "--mesh"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.meshes.push_back(*value);
+        } else if (arg == "--scene"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.scene = *value;
+        } else if (arg == "--script"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.scripts.push_back(*value);
+        } else if (arg == "--batch"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.batch = *value;
+        } else if (arg == "--animate"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.animate = std::atoi(value->c_str());
+            if (options.animate < 1 || options.animate > 1000000) {
+                std::cerr << "The number of frames must be from 1 to 1000000" << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg == "--output"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.output = *value;
+        } else if (arg == "--y4m"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            options.y4m = *value;
+        } else if (arg == "--size"s) {
+            const auto value = next();
+            if (!value) {
+                return std::nullopt;
+            }
+            const auto x = value->find('x');
+            options.width = std::atoi(value->substr(0, x).c_str());
+            options.height = (x == std::string::npos) ? 0 : std::atoi(value->c_str() + x + 1);
+            if (options.width < 1 || options.height < 1 || options.width > 16384
+                || options.height > 16384) {
+                std::cerr << "The size must be given as WxH, from 1x1 to 16384x16384"
+                          << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg == "--help"s || arg == "-h"s) {
+            usage(argv[0]);
+            std::exit(EXIT_SUCCESS);
+        } else {
+            std::cerr << "Unrecognized argument: " << arg << std::endl;
+            usage(argv[0]);
+            return std::nullopt;
+        }
+    }
+    if (options.minScale > options.maxScale) {
+        std::cerr << "--min-scale can not be larger than --max-scale" << std::endl;
+        return std::nullopt;
+    }
+    return options;
+}
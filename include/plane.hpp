@@ -7,38 +7,44 @@
 #include <sstream>
 #include <string>
 
+#include "color.hpp"
 #include "point.hpp"
 #include "vec3.hpp"
 
 using namespace std::string_literals;
 
-// Plane has a position and a normal
+// Plane has a position, a normal and a color
 class Plane {
 protected:
     const Point3 m_pos; // a position on the plane
     const Vec3 m_normal; // the plane normal
+    const RGB m_color;
 
 public:
-    Plane(Point3 pos, Vec3 normal)
+    constexpr Plane(Point3 pos, Vec3 normal, const RGB color = Color::blueish)
         : m_pos { pos }
         , m_normal { normal }
+        , m_color { color }
     {
     }
 
-    Plane(double x, double y, double z, double nx, double ny, double nz)
+    constexpr Plane(double x, double y, double z, double nx, double ny, double nz,
+        const RGB color = Color::blueish)
         : m_pos { x, y, z }
         , m_normal { nx, ny, nz }
+        , m_color { color }
     {
     }
 
     const std::string str() const;
 
-    double x() const;
-    double y() const;
-    double z() const;
+    constexpr double x() const;
+    constexpr double y() const;
+    constexpr double z() const;
 
-    const Point3 pos() const;
-    const Vec3 normal() const;
+    constexpr const Point3 pos() const;
+    constexpr const Vec3 normal() const;
+    constexpr const RGB color() const;
 };
 
 // str returns a string representation of the plane
@@ -58,12 +64,14 @@ inline std::ostream& operator<<(std::ostream& os, const Plane& s)
     return os;
 }
 
-double Plane::x() const { return m_pos.x(); }
+constexpr double Plane::x() const { return m_pos.x(); }
 
-double Plane::y() const { return m_pos.y(); }
+constexpr double Plane::y() const { return m_pos.y(); }
 
-double Plane::z() const { return m_pos.z(); }
+constexpr double Plane::z() const { return m_pos.z(); }
 
-const Point3 Plane::pos() const { return m_pos; }
+constexpr const Point3 Plane::pos() const { return m_pos; }
 
-const Vec3 Plane::normal() const { return m_normal; }
+constexpr const Vec3 Plane::normal() const { return m_normal; }
+
+constexpr const RGB Plane::color() const { return m_color; }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "vec2.hpp"
+#include "vec3.hpp"
+#include "vec4.hpp"
+
 using Point2 = Vec2;
 using Point3 = Vec3;
 using Point4 = Vec4;
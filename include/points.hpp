@@ -1,10 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <initializer_list>
 #include <iomanip>
+#include <limits>
+#include <span>
 #include <string>
 #include <vector>
 
+#include "vec3.hpp"
+
 using namespace std::string_literals;
 
 using Points = std::vector<Vec3>;
@@ -24,9 +29,9 @@ inline std::ostream& operator<<(std::ostream& os, const Points& points)
     return os;
 }
 
-// Find the index to the Vec3 in a std::vector<Vec3> that is
+// Find the index to the Vec3 in a std::vector<Vec3>, or an array of them, that is
 // closest to the given point p.
-size_t index_closest(const Points xs, const Vec3 p)
+inline size_t index_closest(std::span<const Vec3> xs, const Vec3 p)
 {
     size_t smallest_i = 0; // return the first point index, by default
     double smallest_squared_dist = std::numeric_limits<double>::max(); // Largest possible value
@@ -40,10 +45,10 @@ size_t index_closest(const Points xs, const Vec3 p)
     return smallest_i;
 }
 
-// Find the index to the Vec3 in a std::vector<Vec3> that is
+// Find the index to the Vec3 in a std::vector<Vec3>, or an array of them, that is
 // closest to the given point p, except the given indices.
-size_t index_closest_except(
-    const Points xs, const Vec3 p, const std::vector<size_t> except_indices)
+inline size_t index_closest_except(
+    std::span<const Vec3> xs, const Vec3 p, std::initializer_list<size_t> except_indices)
 {
     int smallest_i = 0; // return the first point index, by default
     double smallest_squared_dist = std::numeric_limits<double>::max(); // Largest possible value
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "vec3.hpp"
+#include "vec4.hpp"
+
+using namespace std::string_literals;
+
+// Quat is a quaternion, for rotating things in 3D. It has a vector part (x, y, z) and a scalar
+// part (w). Only unit quaternions are rotations.
+// Like the vector classes, the values are constant. Calculations will need to return new
+// quaternions.
+class Quat {
+protected:
+    const Vec3 m_xyz;
+    const double m_w;
+
+public:
+    constexpr Quat(double _x, double _y, double _z, double _w)
+        : m_xyz { _x, _y, _z }
+        , m_w { _w }
+    {
+    }
+    constexpr Quat(const Vec3 _xyz, double _w)
+        : m_xyz { _xyz }
+        , m_w { _w }
+    {
+    }
+    explicit constexpr Quat(const Vec4 v) // x, y, z, w
+        : m_xyz { v.x(), v.y(), v.z() }
+        , m_w { v.t() }
+    {
+    }
+
+    static constexpr const Quat identity(); // no rotation
+    static const Quat from_axis_angle(const Vec3 axis, double radians);
+
+    constexpr const Quat operator*(const Quat& q) const; // first rotate by q, then by this
+    constexpr const Quat conjugate() const; // the opposite rotation, for unit quaternions
+    double len() const;
+    const Quat normalize() const;
+    constexpr bool is_identity() const;
+
+    constexpr const Vec3 rotate(const Vec3 v) const; // rotate a vector
+    const std::string str() const;
+
+    constexpr double x() const;
+    constexpr double y() const;
+    constexpr double z() const;
+    constexpr double w() const;
+    constexpr const Vec3 xyz() const;
+    constexpr const Vec4 vec4() const;
+};
+
+constexpr const Quat Quat::identity() { return Quat { 0, 0, 0, 1 }; }
+
+// from_axis_angle returns a rotation around the given axis, counter-clockwise when looking
+// against the direction of the axis
+inline const Quat Quat::from_axis_angle(const Vec3 axis, double radians)
+{
+    return Quat { axis.normalize() * std::sin(radians / 2), std::cos(radians / 2) };
+}
+
+// The Hamilton product, which combines two rotations
+constexpr const Quat Quat::operator*(const Quat& q) const
+{
+    return Quat { q.m_xyz * m_w + m_xyz * q.m_w + m_xyz.cross(q.m_xyz),
+        m_w * q.m_w - m_xyz.dot(q.m_xyz) };
+}
+
+constexpr const Quat Quat::conjugate() const { return Quat { m_xyz * -1.0, m_w }; }
+
+inline double Quat::len() const { return std::sqrt(m_xyz.len_squared() + m_w * m_w); }
+
+inline const Quat Quat::normalize() const
+{
+    const double l = len();
+    return Quat { m_xyz / l, m_w / l };
+}
+
+constexpr bool Quat::is_identity() const
+{
+    return m_xyz.x() == 0 && m_xyz.y() == 0 && m_xyz.z() == 0 && m_w == 1;
+}
+
+// rotate uses the faster formula for multiplying a quaternion with a vector, from
+// https://blog.molecular-matters.com/2013/05/24/a-faster-quaternion-vector-multiplication/
+//
+//     t = 2 * cross(q.xyz, v)
+//     v' = v + q.w * t + cross(q.xyz, t)
+//
+// This is two cross products, instead of the two quaternion products of q * v * conjugate(q).
+constexpr const Vec3 Quat::rotate(const Vec3 v) const
+{
+    const Vec3 t = m_xyz.cross(v) * 2.0;
+    return v + t * m_w + m_xyz.cross(t);
+}
+
+// str returns a string representation of the quaternion
+inline const std::string Quat::str() const
+{
+    std::stringstream ss;
+    ss << "quat: ("s << m_xyz << ", "s << m_w << ")"s;
+    return ss.str();
+}
+
+// Implement support for the << operator, by calling the Quat str method
+inline std::ostream& operator<<(std::ostream& os, const Quat& q)
+{
+    os << q.str();
+    return os;
+}
+
+constexpr double Quat::x() const { return m_xyz.x(); }
+
+constexpr double Quat::y() const { return m_xyz.y(); }
+
+constexpr double Quat::z() const { return m_xyz.z(); }
+
+constexpr double Quat::w() const { return m_w; }
+
+constexpr const Vec3 Quat::xyz() const { return m_xyz; }
+
+constexpr const Vec4 Quat::vec4() const
+{
+    return Vec4 { m_xyz.x(), m_xyz.y(), m_xyz.z(), m_w };
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
+#include <limits>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -11,8 +13,12 @@
 #include "vec2.hpp"
 #include "vec3.hpp"
 
+#include "cube.hpp"
+#include "mesh.hpp"
 #include "plane.hpp"
+#include "quat.hpp"
 #include "sphere.hpp"
+#include "triangle.hpp"
 
 using namespace std::string_literals;
 
@@ -45,11 +51,20 @@ public:
     const std::optional<std::pair<const Point3, const Vec3>> intersect(const Sphere& sphere) const;
     const std::optional<std::pair<const Point3, const Vec3>> intersect(const Plane& plane) const;
     const std::optional<std::pair<const Point3, const Vec3>> intersect(const Cube& cube) const;
+    const std::optional<std::pair<const Point3, const Vec3>> intersect(
+        const Triangle& triangle) const;
+    const std::optional<std::pair<const Point3, const Vec3>> intersect(const Mesh& mesh) const;
+
+    // to_object_space returns the same ray, as seen from an object that is centered on the given
+    // point and rotated by the given rotation
+    const Ray to_object_space(const Point3 center, const Quat rotation) const;
 
     const std::string str() const;
 
     // TODO: Save ray direction in class at init?
     const Vec3 direction() const;
+
+    const Point3 p0() const; // where the ray starts
 };
 
 // ray sphere intersection
@@ -88,6 +103,9 @@ inline const std::optional<std::pair<const Point3, const Vec3>> Ray::intersect(
 
     // find the intersection point and the normal vector of the sphere in the intersection point
     const auto t = (-b - std::sqrt(discriminant)) / (a * 2);
+    if (t < 0) { // the sphere is behind the ray, or the ray starts inside of it, like for cubes
+        return std::nullopt;
+    }
 
     const Point3 intersectionPoint = m_p0 + t * direction();
 
@@ -96,28 +114,116 @@ inline const std::optional<std::pair<const Point3, const Vec3>> Ray::intersect(
     return std::pair { std::move(intersectionPoint), std::move(normalVector) };
 }
 
-// ray cube intersection
+// ray cube intersection, using the slab method from
+// https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection
+// The ray is moved into the space of the cube once, where the cube is centered on (0, 0, 0) and
+// aligned with the axes, instead of rotating the cube.
 inline const std::optional<std::pair<const Point3, const Vec3>> Ray::intersect(
     const Cube& cube) const
 {
+    const Ray local = to_object_space(cube.pos(), cube.rotation());
+    const double o[3] = { local.m_p0.x(), local.m_p0.y(), local.m_p0.z() };
+    const double d[3] = { local.m_direction.x(), local.m_direction.y(), local.m_direction.z() };
+    const double half[3] = { cube.w() / 2.0, cube.h() / 2.0, cube.d() / 2.0 };
 
-    // TODO:
-    // https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection
+    // Find where the ray enters and leaves the slab between each pair of opposite faces
+    double tmin = -std::numeric_limits<double>::infinity();
+    double tmax = std::numeric_limits<double>::infinity();
+    int face = -1; // the axis of the face that the ray enters through
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::fabs(d[axis]) < 1e-12) { // parallel to the slab
+            if (o[axis] < -half[axis] || o[axis] > half[axis]) {
+                return std::nullopt;
+            }
+            continue;
+        }
+        double t0 = (-half[axis] - o[axis]) / d[axis];
+        double t1 = (half[axis] - o[axis]) / d[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        if (t0 > tmin) {
+            tmin = t0;
+            face = axis;
+        }
+        tmax = std::min(tmax, t1);
+        if (tmin > tmax) {
+            return std::nullopt;
+        }
+    }
+    if (face < 0 || tmin < 0) { // the cube is behind the ray, or the ray starts inside of it
+        return std::nullopt;
+    }
 
-    const Vec3 norm = cube.normal(m_p0);
+    // The normal of the face that was hit, pointing back towards the ray, rotated back into
+    // the space of the scene
+    double n[3] = { 0, 0, 0 };
+    n[face] = d[face] > 0 ? -1 : 1;
+    const Vec3 normal = cube.rotation().rotate(Vec3 { n[0], n[1], n[2] });
 
-    double denominator = direction().dot(norm);
+    // The rotation keeps lengths, so t is the same in both spaces
+    const Point3 intersectionPoint = m_p0 + tmin * direction();
+    return std::pair { std::move(intersectionPoint), normal };
+}
 
-    if (denominator <= 1e-6) { // smaller than a very small value (epsilon): no intersection
+// ray triangle intersection, using the Möller–Trumbore algorithm
+// The returned normal points towards the side of the triangle the ray comes from.
+inline const std::optional<std::pair<const Point3, const Vec3>> Ray::intersect(
+    const Triangle& triangle) const
+{
+    const Vec3 e1 = triangle.b() - triangle.a();
+    const Vec3 e2 = triangle.c() - triangle.a();
+
+    const Vec3 p = direction().cross(e2);
+    const double det = e1.dot(p);
+    if (std::fabs(det) < 1e-9) { // the ray is parallel to the triangle
         return std::nullopt;
     }
-    double t = (cube.pos() - m_p0).dot(norm) / denominator;
-    if (t < 0) { // plane behind ray's origin
+    const double invDet = 1.0 / det;
+
+    const Vec3 s = m_p0 - triangle.a();
+    const double u = s.dot(p) * invDet;
+    if (u < 0 || u > 1) {
+        return std::nullopt;
+    }
+
+    const Vec3 q = s.cross(e1);
+    const double v = direction().dot(q) * invDet;
+    if (v < 0 || u + v > 1) {
         return std::nullopt;
     }
+
+    const double t = e2.dot(q) * invDet;
+    if (t <= 1e-9) { // triangle behind the ray's origin
+        return std::nullopt;
+    }
+
     const Point3 intersectionPoint = m_p0 + t * direction();
-    // std::cout << "CUBE INTERSECTION POINT: " << intersectionPoint << std::endl;
-    return std::pair { std::move(intersectionPoint), norm };
+    const Vec3 normal = triangle.normal();
+    return std::pair { std::move(intersectionPoint),
+        normal.dot(direction()) > 0 ? normal * -1.0 : normal };
+}
+
+// ray mesh intersection
+// The returned normal is the normal of the closest triangle that is hit, pointing towards the
+// side of the triangle the ray comes from.
+inline const std::optional<std::pair<const Point3, const Vec3>> Ray::intersect(
+    const Mesh& mesh) const
+{
+    // Rotated meshes are tested in their own space, by moving the ray once instead of rotating
+    // the triangles
+    const bool rotated = !mesh.rotation().is_identity();
+    const Ray local = rotated ? to_object_space(mesh.center(), mesh.rotation()) : *this;
+    const auto maybeHit = mesh.closest_hit(
+        rotated ? local.m_p0 + mesh.center() : m_p0, local.direction());
+    if (!maybeHit) {
+        return std::nullopt;
+    }
+    const auto [t, index] = maybeHit.value();
+    const Point3 intersectionPoint = m_p0 + t * direction();
+    const Vec3 normal = rotated ? mesh.rotation().rotate(mesh.normal(index)) : mesh.normal(index);
+    return std::pair { std::move(intersectionPoint),
+        normal.dot(direction()) > 0 ? normal * -1.0 : normal };
 }
 
 // ray plane intersection
@@ -140,6 +246,17 @@ inline const std::optional<std::pair<const Point3, const Vec3>> Ray::intersect(
     return std::pair { std::move(intersectionPoint), norm };
 }
 
+// Move the ray so that the center is at (0, 0, 0), then undo the rotation. Both ends of the ray
+// are rotated, so this costs two rotations, once per object.
+inline const Ray Ray::to_object_space(const Point3 center, const Quat rotation) const
+{
+    if (rotation.is_identity()) {
+        return Ray { m_p0 - center, m_p1 - center };
+    }
+    const Quat inverse = rotation.conjugate();
+    return Ray { inverse.rotate(m_p0 - center), inverse.rotate(m_p1 - center) };
+}
+
 // str returns a string representation of the ray.
 // The string function returns a constant string ("const std::string"),
 // and does not modify anything ("const").
@@ -158,3 +275,5 @@ inline std::ostream& operator<<(std::ostream& os, const Ray& ray)
 }
 
 inline const Vec3 Ray::direction() const { return m_direction; }
+
+inline const Point3 Ray::p0() const { return m_p0; }
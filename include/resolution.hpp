@@ -0,0 +1,97 @@
+#pragma once
+
+// Dynamic resolution, for keeping the frame time within a budget
+
+#include <algorithm>
+#include <cmath>
+
+// ResolutionController adjusts the internal render resolution so that tracing a frame takes
+// roughly the target number of milliseconds. The resolution is given as a scale factor,
+// relative to the window resolution, in each direction.
+//
+// The trace time of each frame is smoothed with a moving average. The scale only changes when
+// the average has been outside of the target +/- the hysteresis for several frames in a row,
+// so that the resolution does not flip back and forth between two sizes.
+class ResolutionController {
+protected:
+    const double m_targetMs; // the wanted trace time per frame, in milliseconds
+    const double m_minScale; // the smallest allowed scale
+    const double m_maxScale; // the largest allowed scale
+    const double m_hysteresis; // how far from the target the average may drift, relative
+    const int m_settleFrames; // how many frames in a row must be off before the scale changes
+
+    double m_scale;
+    double m_average = -1; // the moving average of the trace time, -1 if there are no samples
+    int m_slowFrames = 0;
+    int m_fastFrames = 0;
+
+public:
+    ResolutionController(double targetMs, double minScale, double maxScale, double initialScale,
+        double hysteresis = 0.15, int settleFrames = 8)
+        : m_targetMs { targetMs }
+        , m_minScale { minScale }
+        , m_maxScale { maxScale }
+        , m_hysteresis { hysteresis }
+        , m_settleFrames { settleFrames }
+        , m_scale { std::clamp(initialScale, minScale, maxScale) }
+    {
+    }
+
+    bool update(double traceMs);
+
+    double scale() const;
+    double average() const;
+};
+
+// update records how long the last frame took to trace, in milliseconds.
+// Returns true if the scale has changed and the render buffers need to be reallocated.
+inline bool ResolutionController::update(double traceMs)
+{
+    // Exponential moving average of the trace time
+    m_average = (m_average < 0) ? traceMs : m_average * 0.8 + traceMs * 0.2;
+
+    if (m_average > m_targetMs * (1 + m_hysteresis)) {
+        ++m_slowFrames;
+        m_fastFrames = 0;
+    } else if (m_average < m_targetMs * (1 - m_hysteresis)) {
+        ++m_fastFrames;
+        m_slowFrames = 0;
+    } else {
+        m_slowFrames = 0;
+        m_fastFrames = 0;
+    }
+
+    // Going down in resolution is urgent, since frames are being missed,
+    // while going up can wait a bit longer.
+    const bool slow = m_slowFrames >= m_settleFrames;
+    const bool fast = m_fastFrames >= m_settleFrames * 2;
+    if (!slow && !fast) {
+        return false;
+    }
+    m_slowFrames = 0;
+    m_fastFrames = 0;
+
+    // The trace time is proportional to the number of pixels, which is the scale squared.
+    // Aim slightly below the target, and do not grow by more than 25% at a time.
+    double wanted = m_scale * std::sqrt(m_targetMs / std::max(m_average, 0.001)) * 0.95;
+    if (fast) {
+        wanted = std::min(wanted, m_scale * 1.25);
+    }
+    wanted = std::clamp(wanted, m_minScale, m_maxScale);
+
+    // Ignore changes that are too small to matter
+    if (std::fabs(wanted - m_scale) < m_scale * 0.02) {
+        return false;
+    }
+
+    // Predict the new average, so that the next decision is not based on the old resolution
+    m_average *= (wanted * wanted) / (m_scale * m_scale);
+    m_scale = wanted;
+    return true;
+}
+
+// scale returns the current render resolution, relative to the window resolution
+inline double ResolutionController::scale() const { return m_scale; }
+
+// average returns the moving average of the trace time, in milliseconds
+inline double ResolutionController::average() const { return m_average; }
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "color.hpp"
@@ -13,21 +16,60 @@
 
 #include "ray.hpp"
 
+#include "camera.hpp"
+#include "commands.hpp"
+#include "frame.hpp"
+#include "mathpolicy.hpp"
+#include "shading.hpp"
+
 #include "disk.hpp"
+#include "mesh.hpp"
 #include "plane.hpp"
 #include "sphere.hpp"
+#include "spherecolumns.hpp"
 
 using namespace std::string_literals;
 
-// Sphere has a position and a radius
+// Scene has a light, planes, spheres, cubes and meshes, and a background color.
+// The spheres of a scene that is loaded from a scene file are read from the columns of the file,
+// and are only copied when they are changed for the first time.
 class Scene {
 protected:
+    // AllObjects selects every object, when no Frame has been prepared
+    struct AllObjects {
+        const size_t spheres;
+        const size_t cubes;
+        const size_t meshes;
+
+        size_t sphere_count() const { return spheres; }
+        size_t cube_count() const { return cubes; }
+        size_t mesh_count() const { return meshes; }
+
+        uint32_t sphere(size_t i) const { return static_cast<uint32_t>(i); }
+        uint32_t cube(size_t i) const { return static_cast<uint32_t>(i); }
+        uint32_t mesh(size_t i) const { return static_cast<uint32_t>(i); }
+    };
+
+    // Trace a ray against the selected objects
+    template <typename Math, typename Objects>
+    const RGB trace(const Ray& ray, const Objects& objects, double& depth, int& id) const;
+
+    // sphere returns sphere i, from the list of spheres or from the columns
+    const Sphere sphere(size_t i) const;
+
+    // sphere_list returns a copy of the spheres, as a list
+    auto sphere_list() const -> std::vector<Sphere>;
+
     Sphere m_light;
     std::vector<Plane> m_planes;
     std::vector<Sphere> m_spheres;
+    SphereColumns m_sphereColumns; // used instead of m_spheres, if not empty
     std::vector<Cube> m_cubes;
+    std::vector<std::shared_ptr<const Mesh>> m_meshes; // meshes are shared between scenes
     RGB m_backgroundColor;
 
+    std::vector<Sphere> m_spareSpheres; // the memory for the spheres of the next update
+
 public:
     Scene(Sphere light, Plane plane, Sphere sphere, Cube cube, RGB backgroundColor)
         : m_light { light }
@@ -40,7 +82,7 @@ public:
 
     Scene(Sphere light, Plane plane, std::vector<Sphere> spheres, Cube cube, RGB backgroundColor)
         : m_light { light }
-        , m_spheres { spheres }
+        , m_spheres { std::move(spheres) }
         , m_backgroundColor { backgroundColor }
     {
         m_planes.push_back(plane);
@@ -50,49 +92,172 @@ public:
     Scene(Sphere light, std::vector<Plane> planes, std::vector<Sphere> spheres,
         std::vector<Cube> cubes, RGB backgroundColor)
         : m_light { light }
-        , m_planes { planes }
-        , m_spheres { spheres }
-        , m_cubes { cubes }
+        , m_planes { std::move(planes) }
+        , m_spheres { std::move(spheres) }
+        , m_cubes { std::move(cubes) }
+        , m_backgroundColor { backgroundColor }
+    {
+    }
+
+    Scene(Sphere light, std::vector<Plane> planes, std::vector<Sphere> spheres,
+        std::vector<Cube> cubes, std::vector<std::shared_ptr<const Mesh>> meshes,
+        RGB backgroundColor)
+        : m_light { light }
+        , m_planes { std::move(planes) }
+        , m_spheres { std::move(spheres) }
+        , m_cubes { std::move(cubes) }
+        , m_meshes { std::move(meshes) }
+        , m_backgroundColor { backgroundColor }
+    {
+    }
+
+    Scene(Sphere light, std::vector<Plane> planes, SphereColumns spheres, std::vector<Cube> cubes,
+        std::vector<std::shared_ptr<const Mesh>> meshes, RGB backgroundColor)
+        : m_light { light }
+        , m_planes { std::move(planes) }
+        , m_sphereColumns { std::move(spheres) }
+        , m_cubes { std::move(cubes) }
+        , m_meshes { std::move(meshes) }
         , m_backgroundColor { backgroundColor }
     {
     }
 
     const std::string str() const;
-    const RGB color(const Point3 fromPoint, int x, int y) const;
+
+    // Raytrace a single pixel, with a ray going from fromPoint towards (x, y, 0). The math
+    // policy decides how normals and distances are calculated, see mathpolicy.hpp. The colors
+    // are linear, where 255 is white, and can be brighter than white.
+    template <typename Math = ExactMath>
+    const RGB color(const Point3 fromPoint, double x, double y) const;
+    template <typename Math = ExactMath>
+    const RGB color(const Point3 fromPoint, double x, double y, double& depth, int& id) const;
+
+    // Raytrace a single ray, and also return the depth and the ID of the closest object
+    template <typename Math = ExactMath>
+    const RGB color(const Ray& ray, double& depth, int& id) const;
+
+    // Raytrace a single ray, only testing the objects that are visible in the given frame.
+    // The ray must start at the camera that the frame was culled for.
+    template <typename Math = ExactMath>
+    const RGB color(const Ray& ray, const Frame& frame, double& depth, int& id) const;
+
+    // Raytrace a single ray, only testing the objects of one tile of the frame
+    template <typename Math = ExactMath>
+    const RGB color(const Ray& ray, const TileObjects& tile, double& depth, int& id) const;
+
+    // Prepare a frame, by listing the objects that can be seen with the given camera and aspect
+    // ratio (width divided by height). This also frees the memory of the last frame, in the
+    // arenas of the frame.
+    void cull(const Camera& camera, double aspect, Frame& frame) const;
+
+    // Sort the objects of a culled frame into tiles, for a screen of width x height pixels.
+    // The camera must be the same as the one that was given to cull.
+    void bin(const Camera& camera, int width, int height, Frame& frame) const;
 
     // Methods for modifying the scene by creating an entirely new scene
     const Scene light_move(const Vec3 offset) const;
     const Scene sphere_move(const size_t index, const Vec3 offset) const;
+    const Scene sphere_add(const Sphere sphere) const;
+    const Scene mesh_add(const std::shared_ptr<const Mesh> mesh) const;
+
+    // Apply all recorded changes at once. The new scene is not const, so that it can be moved.
+    Scene apply(CommandBuffer& commands) const;
+
+    // Apply all recorded changes to this scene, instead of creating a new one. The memory of the
+    // spheres is kept for the next update, so once the number of spheres stops growing, changing
+    // the scene does not allocate. Spheres that are read from columns are copied the first time.
+    void update(CommandBuffer& commands);
+
+    size_t sphere_count() const;
 };
 
 // Move a sphere by creating an enitirely new scene
-const Scene Scene::sphere_move(const size_t index, const Vec3 offset) const
+inline const Scene Scene::sphere_move(const size_t index, const Vec3 offset) const
 {
-    if (m_spheres.empty()) {
-        return Scene { m_light, m_planes, m_spheres, m_cubes, m_backgroundColor };
+    if (sphere_count() == 0) {
+        return Scene { m_light, m_planes, sphere_list(), m_cubes, m_meshes, m_backgroundColor };
     }
 
     std::vector<Sphere> newSpheres;
-    for (size_t i = 0; i < m_spheres.size(); ++i) {
+    for (size_t i = 0; i < sphere_count(); ++i) {
+        const Sphere current = sphere(i);
         if (i == index) {
-            const auto newPos = m_spheres[i].pos() + offset;
-            const auto newRadius = m_spheres[i].r();
-            Sphere newSphere = Sphere { newPos, newRadius };
+            const auto newPos = current.pos() + offset;
+            const auto newRadius = current.r();
+            Sphere newSphere = Sphere { newPos, newRadius, current.color() };
             newSpheres.push_back(newSphere);
         } else {
-            newSpheres.push_back(m_spheres[i]);
+            newSpheres.push_back(current);
         }
     }
-    return Scene { m_light, m_planes, newSpheres, m_cubes, m_backgroundColor };
+    return Scene { m_light, m_planes, newSpheres, m_cubes, m_meshes, m_backgroundColor };
 }
 
 // Move the light by creating an enitirely new scene
-const Scene Scene::light_move(const Vec3 offset) const
+inline const Scene Scene::light_move(const Vec3 offset) const
 {
     auto newPos = m_light.pos() + offset;
     auto newRadius = m_light.r();
-    Sphere newLight = Sphere { newPos, newRadius };
-    return Scene { newLight, m_planes, m_spheres, m_cubes, m_backgroundColor };
+    Sphere newLight = Sphere { newPos, newRadius, m_light.color() };
+    return Scene { newLight, m_planes, sphere_list(), m_cubes, m_meshes, m_backgroundColor };
+}
+
+// Add a sphere by creating an entirely new scene
+inline const Scene Scene::sphere_add(const Sphere sphere) const
+{
+    std::vector<Sphere> newSpheres = sphere_list();
+    newSpheres.push_back(sphere);
+    return Scene { m_light, m_planes, newSpheres, m_cubes, m_meshes, m_backgroundColor };
+}
+
+// Add a mesh by creating an entirely new scene. The mesh itself is shared, not copied.
+inline const Scene Scene::mesh_add(const std::shared_ptr<const Mesh> mesh) const
+{
+    std::vector<std::shared_ptr<const Mesh>> newMeshes = m_meshes;
+    newMeshes.push_back(mesh);
+    return Scene { m_light, m_planes, sphere_list(), m_cubes, newMeshes, m_backgroundColor };
+}
+
+// Apply a buffer of recorded changes by creating an entirely new scene, but only once, with a
+// single pass over the spheres
+inline Scene Scene::apply(CommandBuffer& commands) const
+{
+    std::vector<Sphere> spheres = m_sphereColumns.empty()
+        ? commands.apply(m_spheres)
+        : commands.apply(m_sphereColumns.spheres());
+    return Scene { commands.apply_light(m_light), m_planes, std::move(spheres), m_cubes, m_meshes,
+        m_backgroundColor };
+}
+
+inline void Scene::update(CommandBuffer& commands)
+{
+    if (!m_sphereColumns.empty()) {
+        m_spheres = m_sphereColumns.spheres();
+        m_sphereColumns = SphereColumns {};
+    }
+    commands.apply(m_spheres, m_spareSpheres);
+    m_spheres.swap(m_spareSpheres);
+
+    // A sphere can not be assigned to, since it is constant, so the light is created again in
+    // the same place
+    const Sphere light = commands.apply_light(m_light);
+    std::destroy_at(&m_light);
+    std::construct_at(&m_light, light);
+}
+
+inline size_t Scene::sphere_count() const
+{
+    return m_sphereColumns.empty() ? m_spheres.size() : m_sphereColumns.size();
+}
+
+inline const Sphere Scene::sphere(size_t i) const
+{
+    return m_sphereColumns.empty() ? m_spheres[i] : m_sphereColumns.sphere(i);
+}
+
+inline auto Scene::sphere_list() const -> std::vector<Sphere>
+{
+    return m_sphereColumns.empty() ? m_spheres : m_sphereColumns.spheres();
 }
 
 // List the elements in this scene
@@ -101,15 +266,18 @@ inline const std::string Scene::str() const
     std::stringstream ss;
     ss << "background color: " << m_backgroundColor << "\n";
     ss << "light: " << m_light << "\n";
-    for (const auto sphere : m_spheres) {
-        ss << sphere << "\n";
+    for (size_t i = 0; i < sphere_count(); ++i) {
+        ss << sphere(i) << "\n";
     }
-    for (const auto plane : m_planes) {
+    for (const auto& plane : m_planes) {
         ss << plane << "\n";
     }
-    for (const auto cube : m_cubes) {
+    for (const auto& cube : m_cubes) {
         ss << cube << "\n";
     }
+    for (const auto& mesh : m_meshes) {
+        ss << *mesh << "\n";
+    }
     return ss.str();
 }
 
@@ -121,61 +289,235 @@ inline std::ostream& operator<<(std::ostream& os, const Scene& s)
 }
 
 // Raytrace for a single pixel
-inline const RGB Scene::color(const Point3 fromPoint, int x, int y) const
+template <typename Math>
+inline const RGB Scene::color(const Point3 fromPoint, double x, double y) const
 {
+    double depth;
+    int id;
+    return color<Math>(fromPoint, x, y, depth, id);
+}
 
-    std::unordered_map<double, RGB> depthColor;
-
+// Raytrace for a single pixel, and also return the depth and the ID of the closest object
+template <typename Math>
+inline const RGB Scene::color(
+    const Point3 fromPoint, double x, double y, double& depth, int& id) const
+{
     // Create a new ray, going from fromPoint towards (x,y,0)
-    const auto ray = Ray { fromPoint, Vec3 { static_cast<double>(x), static_cast<double>(y), 0 } };
+    return color<Math>(Ray { fromPoint, Vec3 { x, y, 0 } }, depth, id);
+}
 
-    // TODO: Loop over an object type instead of spheres and planes. They can inherent from object.
+template <typename Math>
+inline const RGB Scene::color(const Ray& ray, double& depth, int& id) const
+{
+    return trace<Math>(
+        ray, AllObjects { sphere_count(), m_cubes.size(), m_meshes.size() }, depth, id);
+}
 
-    double smallestDepth = 0;
-    bool firstFind = true;
+template <typename Math>
+inline const RGB Scene::color(const Ray& ray, const Frame& frame, double& depth, int& id) const
+{
+    return trace<Math>(ray, frame, depth, id);
+}
 
-    for (const auto sphere : m_spheres) {
+template <typename Math>
+inline const RGB Scene::color(
+    const Ray& ray, const TileObjects& tile, double& depth, int& id) const
+{
+    return trace<Math>(ray, tile, depth, id);
+}
 
-        // Check if the ray intersects with the sphere, and deal with the optional returns
-        if (const auto maybeIntersectionPointAndNormal = ray.intersect(sphere)) {
+// List the objects that are inside of the view frustum. Cubes and meshes are checked with a
+// sphere that surrounds them, which works for any rotation. For each visible sphere, the terms of
+// the intersection test that are the same for every ray from the camera are also calculated.
+// This starts a new frame, so the arenas of the last frame are reset.
+inline void Scene::cull(const Camera& camera, double aspect, Frame& frame) const
+{
+    const Frustum frustum { camera, aspect };
+
+    frame.arenas.begin_frame();
+
+    // The terms are only filled in for the visible spheres
+    const Point3 origin = camera.pos();
+    frame.spheres.clear();
+    frame.sphereTerms.resize(sphere_count());
+    for (size_t i = 0; i < sphere_count(); ++i) {
+        const Sphere s = sphere(i);
+        if (frustum.contains(s.pos(), s.r())) {
+            frame.spheres.push_back(static_cast<uint32_t>(i));
+            const Vec3 c = s.pos() - origin;
+            frame.sphereTerms[i] = SphereTerms { c.x(), c.y(), c.z(),
+                c.len_squared() - s.radius_squared() };
+        }
+    }
 
-            // Retrieve the intersection point and normal as a pair
-            const auto intersectionPointAndNormal = maybeIntersectionPointAndNormal.value();
+    frame.cubes.clear();
+    for (size_t i = 0; i < m_cubes.size(); ++i) {
+        if (frustum.contains(m_cubes[i].pos(), m_cubes[i].bounding_radius())) {
+            frame.cubes.push_back(static_cast<uint32_t>(i));
+        }
+    }
 
-            // Pick out the intersection point and the normal. The normal from the sphere is
-            // sometimes known as just "N".
-            const Point3 intersectionPoint = intersectionPointAndNormal.first;
-            const Vec3 normal = intersectionPointAndNormal.second;
+    frame.meshes.clear();
+    for (size_t i = 0; i < m_meshes.size(); ++i) {
+        if (frustum.contains(m_meshes[i]->center(), m_meshes[i]->bounding_radius())) {
+            frame.meshes.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+// Find the tiles that each object may cover, from its bounding sphere. A ray through the center of
+// a pixel can only hit an object if the pixel center is inside of the bounds of the object, and
+// one pixel is added on every side, so that rounding never leaves out a tile.
+inline void Scene::bin(const Camera& camera, int width, int height, Frame& frame) const
+{
+    const Frustum frustum { camera, static_cast<double>(width) / height };
+
+    frame.width = width;
+    frame.height = height;
+    frame.tilesX = (width + Frame::tileSize - 1) / Frame::tileSize;
+    frame.tilesY = (height + Frame::tileSize - 1) / Frame::tileSize;
 
-            // Get the vector pointing to the light from the intersection point. This is
-            // sometimes known as just "L".
-            const auto lightDirection = m_light.pos() - intersectionPoint;
+    const auto rect = [&](const Point3 center, double radius) {
+        double u0, v0, u1, v1;
+        if (!frustum.bounds(center, radius, u0, v0, u1, v1)) {
+            return TileRect { 0, 0, frame.tilesX - 1, frame.tilesY - 1 };
+        }
+        const auto pixel = [](double u, int size, int offset) {
+            return static_cast<int>(std::clamp(std::floor(u * size) + offset, -1.0,
+                static_cast<double>(size)));
+        };
+        const int x0 = std::max(pixel(u0, width, -1), 0);
+        const int x1 = std::min(pixel(u1, width, 1), width - 1);
+        const int y0 = std::max(pixel(v0, height, -1), 0);
+        const int y1 = std::min(pixel(v1, height, 1), height - 1);
+        if (x0 > x1 || y0 > y1) {
+            return TileRect { 1, 1, 0, 0 };
+        }
+        return TileRect { x0 / Frame::tileSize, y0 / Frame::tileSize, x1 / Frame::tileSize,
+            y1 / Frame::tileSize };
+    };
+
+    frame.rects.clear();
+    for (const auto i : frame.spheres) {
+        const Sphere s = sphere(i);
+        frame.rects.push_back(rect(s.pos(), s.r()));
+    }
+    frame.bin(frame.spheres, frame.tileSpheres);
 
-            // Get the dot product between the normalized light vector and the normalized
-            // normal vector. This says something about to which degree the surface normal
-            // points towards the light.
-            const double dt = lightDirection.normalize().dot(normal.normalize());
+    frame.rects.clear();
+    for (const auto i : frame.cubes) {
+        frame.rects.push_back(rect(m_cubes[i].pos(), m_cubes[i].bounding_radius()));
+    }
+    frame.bin(frame.cubes, frame.tileCubes);
 
-            // Use a formula for producting a color from dt.
-            RGB currentColor = (Color::red + Color::white * dt) * .5;
+    frame.rects.clear();
+    for (const auto i : frame.meshes) {
+        frame.rects.push_back(rect(m_meshes[i]->center(), m_meshes[i]->bounding_radius()));
+    }
+    frame.bin(frame.meshes, frame.tileMeshes);
+}
 
-            // TODO: Optimize by using distancedistance instead of distance, to avoid a sqrt?
-            double depth = fromPoint.distance(intersectionPoint);
+// Trace a ray against the selected objects, and return the color of the closest one, together
+// with the depth and the ID of that object.
+// Spheres, planes, cubes and meshes are numbered in that order, starting from 0, whether they
+// are selected or not. If nothing is hit, depth is set to infinity and id is set to -1.
+template <typename Math, typename Objects>
+inline const RGB Scene::trace(const Ray& ray, const Objects& objects, double& depth, int& id) const
+{
+    const Point3 fromPoint = ray.p0();
 
-            if (depth < smallestDepth || firstFind) {
-                smallestDepth = depth;
-                firstFind = false;
+    // The closest hit so far
+    double smallestDepth = 0;
+    bool firstFind = true;
+    double closestColor[3] = { 0, 0, 0 }; // RGB is constant, so the parts are kept instead
+    int closestID = -1;
+
+    // Keep the hit if it is closer than the closest hit so far
+    const auto found = [&](double currentDepth, const RGB& currentColor, int objectID) {
+        if (currentDepth < smallestDepth || firstFind) {
+            smallestDepth = currentDepth;
+            firstFind = false;
+            closestColor[0] = currentColor.R();
+            closestColor[1] = currentColor.G();
+            closestColor[2] = currentColor.B();
+            closestID = objectID;
+        }
+    };
+
+    // TODO: Loop over an object type instead of spheres and planes. They can inherent from object.
+
+    // Shade a point on a sphere
+    const auto shadeSphere = [&](uint32_t i, const Point3 intersectionPoint, const Vec3 normal) {
+        found(Math::distance(fromPoint, intersectionPoint),
+            shade_sphere<Math>(m_light.pos(), sphere(i).color(), intersectionPoint, normal),
+            static_cast<int>(i));
+    };
+
+    if constexpr (requires { objects.sphere_lanes(); }) {
+        // The same as below, but the terms of the spheres of the tile are next to each other in
+        // memory, and several spheres are tested at once, see simd.hpp
+        const Vec3 d = ray.direction();
+        double t;
+        const size_t k = closest_sphere(objects.sphere_lanes(), Vec3a { d.x(), d.y(), d.z() }, t);
+        if (k < objects.sphere_count()) {
+            const uint32_t i = objects.sphere(k);
+            const Point3 intersectionPoint = fromPoint + t * d;
+            shadeSphere(i, intersectionPoint, sphere(i).normal(intersectionPoint));
+        }
+    } else if constexpr (requires { objects.sphere_terms(); }) {
+        // The ray starts at the camera, and the parts of the intersection test that only depend
+        // on the camera and the sphere were calculated by Scene::cull. With the center C
+        // relative to the camera, and b = D · C, the ray hits the sphere where
+        //
+        //     t = (b - sqrt(b² - |D|² * c)) / |D|²
+        //
+        // Only the closest sphere is shaded.
+        const SphereTerms* terms = objects.sphere_terms();
+        const Vec3 d = ray.direction();
+        const double dx = d.x();
+        const double dy = d.y();
+        const double dz = d.z();
+        const double a = dx * dx + dy * dy + dz * dz;
+        double closestT = std::numeric_limits<double>::infinity();
+        uint32_t closest = 0;
+        for (size_t k = 0; k < objects.sphere_count(); ++k) {
+            const uint32_t i = objects.sphere(k);
+            const auto& s = terms[i];
+            const double b = dx * s.x + dy * s.y + dz * s.z;
+            const double discriminant = b * b - a * s.c;
+            if (discriminant <= 0) {
+                continue;
             }
+            const double t = (b - std::sqrt(discriminant)) / a;
+            if (t >= 0 && t < closestT) {
+                closestT = t;
+                closest = i;
+            }
+        }
+        if (closestT != std::numeric_limits<double>::infinity()) {
+            const Point3 intersectionPoint = fromPoint + closestT * d;
+            shadeSphere(closest, intersectionPoint, sphere(closest).normal(intersectionPoint));
+        }
+    } else {
+        for (size_t k = 0; k < objects.sphere_count(); ++k) {
+            const uint32_t i = objects.sphere(k);
+
+            // Check if the ray intersects with the sphere, and deal with the optional returns
+            if (const auto maybeIntersectionPointAndNormal = ray.intersect(sphere(i))) {
 
-            depthColor.insert(
-                std::make_pair<double, RGB>(std::move(depth), std::move(currentColor)));
+                // Retrieve the intersection point and normal as a pair
+                const auto intersectionPointAndNormal = maybeIntersectionPointAndNormal.value();
 
-            // Clamp the color values to the 0..255 range
-            // return currentColor.clamp255();
+                // Pick out the intersection point and the normal. The normal from the sphere
+                // is sometimes known as just "N".
+                shadeSphere(i, intersectionPointAndNormal.first, intersectionPointAndNormal.second);
+            }
         }
     }
 
-    for (const auto plane : m_planes) {
+    int objectID = static_cast<int>(sphere_count());
+
+    for (const auto& plane : m_planes) {
 
         // Check if the ray intersects with the plane, and deal with the optional returns
         if (const auto maybeIntersectionPointAndNormal = ray.intersect(plane)) {
@@ -188,36 +530,17 @@ inline const RGB Scene::color(const Point3 fromPoint, int x, int y) const
             const Point3 intersectionPoint = intersectionPointAndNormal.first;
             const Vec3 normal = intersectionPointAndNormal.second;
 
-            // Get the vector pointing to the light from the intersection point. This is
-            // sometimes known as just "L".
-            const auto lightDirection = m_light.pos() - intersectionPoint;
-
-            // Get the dot product between the normalized light vector and the normalized
-            // normal vector. This says something about to which degree the surface normal
-            // points towards the light.
-            const double dt = lightDirection.normalize().dot(normal.normalize());
-
-            // Use a formula for producting a color from dt.
-            RGB currentColor
-                = ((Color::blueish + Color::white * dt) * .5) * .5 + m_backgroundColor * .5;
-
-            // TODO: Optimize by using distancedistance instead of distance, to avoid a sqrt?
-            double depth = fromPoint.distance(intersectionPoint);
-
-            if (depth < smallestDepth || firstFind) {
-                smallestDepth = depth;
-                firstFind = false;
-            }
-
-            depthColor.insert(
-                std::make_pair<double, RGB>(std::move(depth), std::move(currentColor)));
-
-            // Clamp the color values to the 0..255 range
-            // return currentColor.clamp255();
+            found(Math::distance(fromPoint, intersectionPoint),
+                shade_surface<Math>(m_light.pos(), plane.color(), m_backgroundColor,
+                    intersectionPoint, normal),
+                objectID);
         }
+        ++objectID;
     }
 
-    for (const auto cube : m_cubes) {
+    for (size_t k = 0; k < objects.cube_count(); ++k) {
+        const uint32_t i = objects.cube(k);
+        const auto& cube = m_cubes[i];
 
         // Check if the ray intersects with the cube, and deal with the optional returns
         if (const auto maybeIntersectionPointAndNormal = ray.intersect(cube)) {
@@ -230,40 +553,44 @@ inline const RGB Scene::color(const Point3 fromPoint, int x, int y) const
             const Point3 intersectionPoint = intersectionPointAndNormal.first;
             const Vec3 normal = intersectionPointAndNormal.second;
 
-            // Get the vector pointing to the light from the intersection point. This is
-            // sometimes known as just "L".
-            const auto lightDirection = m_light.pos() - intersectionPoint;
-
-            // Get the dot product between the normalized light vector and the normalized
-            // normal vector. This says something about to which degree the surface normal
-            // points towards the light.
-            const double dt = lightDirection.normalize().dot(normal.normalize());
+            found(Math::distance(fromPoint, intersectionPoint),
+                shade_surface<Math>(m_light.pos(), cube.color(), m_backgroundColor,
+                    intersectionPoint, normal),
+                objectID + static_cast<int>(i));
+        }
+    }
+    objectID += static_cast<int>(m_cubes.size());
 
-            // Use a formula for producting a color from dt.
-            RGB currentColor
-                = ((Color::blueish + Color::white * dt) * .5) * .5 + m_backgroundColor * .5;
+    for (size_t k = 0; k < objects.mesh_count(); ++k) {
+        const uint32_t i = objects.mesh(k);
+        const auto& mesh = m_meshes[i];
 
-            // TODO: Optimize by using distancedistance instead of distance, to avoid a sqrt?
-            double depth = fromPoint.distance(intersectionPoint);
+        // Check if the ray intersects with the mesh, and deal with the optional returns
+        if (const auto maybeIntersectionPointAndNormal = ray.intersect(*mesh)) {
 
-            if (depth < smallestDepth || firstFind) {
-                smallestDepth = depth;
-                firstFind = false;
-            }
+            // Retrieve the intersection point and normal as a pair
+            const auto intersectionPointAndNormal = maybeIntersectionPointAndNormal.value();
 
-            depthColor.insert(
-                std::make_pair<double, RGB>(std::move(depth), std::move(currentColor)));
+            // Pick out the intersection point and the normal of the triangle that was hit.
+            const Point3 intersectionPoint = intersectionPointAndNormal.first;
+            const Vec3 normal = intersectionPointAndNormal.second;
 
-            // Clamp the color values to the 0..255 range
-            // return currentColor.clamp255();
+            found(Math::distance(fromPoint, intersectionPoint),
+                shade_surface<Math>(m_light.pos(), mesh->color(), m_backgroundColor,
+                    intersectionPoint, normal),
+                objectID + static_cast<int>(i));
         }
     }
 
     if (firstFind) { // Found no color to use
+        depth = std::numeric_limits<double>::infinity();
+        id = -1;
         return m_backgroundColor;
     }
 
-    // Now return the color that had the smallest depth, clamped to the 0..255 range
-    RGB closestColor = depthColor.at(smallestDepth);
-    return closestColor.clamp255();
+    // Now return the color that had the smallest depth. It is linear, and not clamped, so that
+    // colors that are brighter than white are kept until the frame is tone mapped.
+    depth = smallestDepth;
+    id = closestID;
+    return RGB { closestColor[0], closestColor[1], closestColor[2] };
 }
@@ -0,0 +1,321 @@
+#pragma once
+
+/*
+ * Scene files
+ *
+ * A scene file starts with a header, followed by a table of columns. Each column is one property
+ * of one kind of object, like the x coordinates of all the spheres, stored as a plain array of
+ * doubles, floats or 32-bit unsigned integers, in the byte order of the machine that wrote it.
+ * Every column starts at a 64 byte boundary.
+ *
+ * Since the columns are stored exactly like they are laid out in memory, a memory mapped scene
+ * file needs no parsing: each column is a span that points into the mapping. The meshes are also
+ * stored as the triangle blocks that rays are tested against, with their bounding boxes. A Scene
+ * that is made from a mapped file reads its spheres from the sphere columns, and its meshes use
+ * the vertices and the triangle blocks of the file, so nothing is copied or prepared again, and
+ * the pages of the file are only read when they are used. The light, the planes and the cubes are
+ * copied, since there are few of them.
+ *
+ * Loading checks that the columns have the right lengths, that every range of a mesh is inside of
+ * its columns, and that the objects have finite coordinates, known materials and unit rotations.
+ * The vertices, the indices and the triangle blocks are not read: rays are only tested against
+ * the blocks, which have the corners of each triangle in them, so an index that is out of range
+ * is never used for tracing. Files from before version 3 have no triangle blocks, and their
+ * meshes are prepared when the scene is made, after the indices are checked.
+ *
+ * Scene files can be created from a text description with the scenec tool.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "mesh.hpp"
+#include "scene.hpp"
+
+namespace scenefile {
+
+// The first 8 bytes of every scene file
+constexpr char magic[8] = { 'S', 'P', 'H', 'S', 'C', 'E', 'N', 'E' };
+
+// The current version of the file format. Files with a newer version are rejected.
+// Version 2 added the rotation columns. Files without them have no rotated objects.
+// Version 3 added the triangle blocks and the bounding boxes of the meshes.
+constexpr uint32_t version = 3;
+
+// Written as a uint32 in the header, for detecting files written with a different byte order
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+// Every column starts at a multiple of this many bytes
+constexpr uint64_t alignment = 64;
+
+// The columns that can be in a scene file. Unknown columns are skipped when reading.
+enum class Column : uint32_t {
+    Light = 1, // double[4]: x, y, z and radius of the light
+    Background, // double[3]: the background color
+    MaterialR, // double per material: the red, green and blue parts of the material color
+    MaterialG,
+    MaterialB,
+    SphereX, // double per sphere: the position and radius
+    SphereY,
+    SphereZ,
+    SphereR,
+    SphereMaterial, // uint32 per sphere: index into the material columns
+    PlaneX, // double per plane: a point on the plane and the plane normal
+    PlaneY,
+    PlaneZ,
+    PlaneNX,
+    PlaneNY,
+    PlaneNZ,
+    PlaneMaterial, // uint32 per plane
+    CubeX, // double per cube: the center, width, height and depth
+    CubeY,
+    CubeZ,
+    CubeW,
+    CubeH,
+    CubeD,
+    CubeMaterial, // uint32 per cube
+    MeshVertexStart, // uint32 per mesh: the range of the mesh in the vertex columns
+    MeshVertexCount,
+    MeshIndexStart, // uint32 per mesh: the range of the mesh in the index column
+    MeshIndexCount,
+    MeshMaterial, // uint32 per mesh
+    VertexX, // float per vertex, for all meshes
+    VertexY,
+    VertexZ,
+    Index, // uint32 per triangle corner, for all meshes, relative to the first vertex of the mesh
+    CubeQX, // double per cube, if any cube is rotated: the rotation, as a unit quaternion
+    CubeQY,
+    CubeQZ,
+    CubeQW,
+    MeshQX, // double per mesh, if any mesh is rotated: the rotation around the center of the mesh
+    MeshQY,
+    MeshQZ,
+    MeshQW,
+    MeshBlockStart, // uint32 per mesh: the range of the mesh in the block column
+    MeshBlockCount,
+    MeshMinX, // float per mesh: the bounding box of the vertices of the mesh
+    MeshMinY,
+    MeshMinZ,
+    MeshMaxX,
+    MeshMaxY,
+    MeshMaxZ,
+    Block, // TriangleBlock per 8 triangles, for all meshes, see mesh.hpp
+};
+
+// The file header
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t columnCount;
+    uint32_t reserved;
+    uint64_t fileSize;
+};
+
+// One entry in the column table, which follows the header
+struct ColumnEntry {
+    uint32_t column; // a Column value
+    uint32_t elementSize; // the size of each element, in bytes
+    uint64_t count; // the number of elements
+    uint64_t offset; // the position of the first element, from the start of the file
+};
+
+} // namespace scenefile
+
+// SceneView gives access to all the columns of a scene, wherever they are stored
+class SceneView {
+public:
+    std::span<const double> light;
+    std::span<const double> background;
+
+    std::span<const double> materialR;
+    std::span<const double> materialG;
+    std::span<const double> materialB;
+
+    std::span<const double> sphereX;
+    std::span<const double> sphereY;
+    std::span<const double> sphereZ;
+    std::span<const double> sphereR;
+    std::span<const uint32_t> sphereMaterial;
+
+    std::span<const double> planeX;
+    std::span<const double> planeY;
+    std::span<const double> planeZ;
+    std::span<const double> planeNX;
+    std::span<const double> planeNY;
+    std::span<const double> planeNZ;
+    std::span<const uint32_t> planeMaterial;
+
+    std::span<const double> cubeX;
+    std::span<const double> cubeY;
+    std::span<const double> cubeZ;
+    std::span<const double> cubeW;
+    std::span<const double> cubeH;
+    std::span<const double> cubeD;
+    std::span<const uint32_t> cubeMaterial;
+    std::span<const double> cubeQX; // empty if no cube is rotated
+    std::span<const double> cubeQY;
+    std::span<const double> cubeQZ;
+    std::span<const double> cubeQW;
+
+    std::span<const uint32_t> meshVertexStart;
+    std::span<const uint32_t> meshVertexCount;
+    std::span<const uint32_t> meshIndexStart;
+    std::span<const uint32_t> meshIndexCount;
+    std::span<const uint32_t> meshMaterial;
+    std::span<const double> meshQX; // empty if no mesh is rotated
+    std::span<const double> meshQY;
+    std::span<const double> meshQZ;
+    std::span<const double> meshQW;
+    std::span<const uint32_t> meshBlockStart; // empty in files from before version 3
+    std::span<const uint32_t> meshBlockCount;
+    std::span<const float> meshMinX;
+    std::span<const float> meshMinY;
+    std::span<const float> meshMinZ;
+    std::span<const float> meshMaxX;
+    std::span<const float> meshMaxY;
+    std::span<const float> meshMaxZ;
+
+    std::span<const float> vertexX;
+    std::span<const float> vertexY;
+    std::span<const float> vertexZ;
+    std::span<const uint32_t> indices;
+    std::span<const TriangleBlock> blocks;
+
+    void validate() const;
+};
+
+// for_each_column calls f with the column ID and a reference to the span, for every column
+template <typename View, typename F> void for_each_column(View& view, F f)
+{
+    using scenefile::Column;
+    f(Column::Light, view.light);
+    f(Column::Background, view.background);
+    f(Column::MaterialR, view.materialR);
+    f(Column::MaterialG, view.materialG);
+    f(Column::MaterialB, view.materialB);
+    f(Column::SphereX, view.sphereX);
+    f(Column::SphereY, view.sphereY);
+    f(Column::SphereZ, view.sphereZ);
+    f(Column::SphereR, view.sphereR);
+    f(Column::SphereMaterial, view.sphereMaterial);
+    f(Column::PlaneX, view.planeX);
+    f(Column::PlaneY, view.planeY);
+    f(Column::PlaneZ, view.planeZ);
+    f(Column::PlaneNX, view.planeNX);
+    f(Column::PlaneNY, view.planeNY);
+    f(Column::PlaneNZ, view.planeNZ);
+    f(Column::PlaneMaterial, view.planeMaterial);
+    f(Column::CubeX, view.cubeX);
+    f(Column::CubeY, view.cubeY);
+    f(Column::CubeZ, view.cubeZ);
+    f(Column::CubeW, view.cubeW);
+    f(Column::CubeH, view.cubeH);
+    f(Column::CubeD, view.cubeD);
+    f(Column::CubeMaterial, view.cubeMaterial);
+    f(Column::MeshVertexStart, view.meshVertexStart);
+    f(Column::MeshVertexCount, view.meshVertexCount);
+    f(Column::MeshIndexStart, view.meshIndexStart);
+    f(Column::MeshIndexCount, view.meshIndexCount);
+    f(Column::MeshMaterial, view.meshMaterial);
+    f(Column::VertexX, view.vertexX);
+    f(Column::VertexY, view.vertexY);
+    f(Column::VertexZ, view.vertexZ);
+    f(Column::Index, view.indices);
+    f(Column::CubeQX, view.cubeQX);
+    f(Column::CubeQY, view.cubeQY);
+    f(Column::CubeQZ, view.cubeQZ);
+    f(Column::CubeQW, view.cubeQW);
+    f(Column::MeshQX, view.meshQX);
+    f(Column::MeshQY, view.meshQY);
+    f(Column::MeshQZ, view.meshQZ);
+    f(Column::MeshQW, view.meshQW);
+    f(Column::MeshBlockStart, view.meshBlockStart);
+    f(Column::MeshBlockCount, view.meshBlockCount);
+    f(Column::MeshMinX, view.meshMinX);
+    f(Column::MeshMinY, view.meshMinY);
+    f(Column::MeshMinZ, view.meshMinZ);
+    f(Column::MeshMaxX, view.meshMaxX);
+    f(Column::MeshMaxY, view.meshMaxY);
+    f(Column::MeshMaxZ, view.meshMaxZ);
+    f(Column::Block, view.blocks);
+}
+
+// SceneData holds the columns of a scene in memory, while a scene file is being put together
+class SceneData {
+public:
+    std::vector<double> light { 0, 0, 0, 1 };
+    std::vector<double> background { 0, 0, 0 };
+
+    std::vector<double> materialR, materialG, materialB;
+
+    std::vector<double> sphereX, sphereY, sphereZ, sphereR;
+    std::vector<uint32_t> sphereMaterial;
+
+    std::vector<double> planeX, planeY, planeZ, planeNX, planeNY, planeNZ;
+    std::vector<uint32_t> planeMaterial;
+
+    std::vector<double> cubeX, cubeY, cubeZ, cubeW, cubeH, cubeD;
+    std::vector<uint32_t> cubeMaterial;
+    std::vector<double> cubeQX, cubeQY, cubeQZ, cubeQW;
+
+    std::vector<uint32_t> meshVertexStart, meshVertexCount, meshIndexStart, meshIndexCount;
+    std::vector<uint32_t> meshMaterial;
+    std::vector<double> meshQX, meshQY, meshQZ, meshQW;
+    std::vector<uint32_t> meshBlockStart, meshBlockCount;
+    std::vector<float> meshMinX, meshMinY, meshMinZ, meshMaxX, meshMaxY, meshMaxZ;
+
+    std::vector<float> vertexX, vertexY, vertexZ;
+    std::vector<uint32_t> indices;
+    std::vector<TriangleBlock> blocks;
+
+    const SceneView view() const;
+};
+
+// MappedScene is a scene file that is mapped into memory. The columns point straight into the
+// mapped file, and stay valid for as long as the MappedScene exists.
+class MappedScene {
+protected:
+    const MappedFile m_file;
+    SceneView m_view;
+
+public:
+    explicit MappedScene(const std::string& filename);
+
+    const SceneView& view() const;
+};
+
+// parse_scene_text reads a text description of a scene. Each line describes one thing:
+//
+//   background R G B
+//   material NAME R G B
+//   light X Y Z RADIUS
+//   plane X Y Z NX NY NZ [MATERIAL]
+//   sphere X Y Z RADIUS [MATERIAL]
+//   cube X Y Z WIDTH HEIGHT DEPTH [MATERIAL]
+//   mesh FILENAME.obj X Y Z SIZE [MATERIAL]
+//   rotate AX AY AZ DEGREES
+//
+// Meshes are loaded from OBJ files, relative to the text file, and scaled to fit in a cube of the
+// given size, centered on the given point. rotate rotates the cube or mesh on the line before it
+// around the given axis, and can be repeated. Empty lines and lines starting with # are ignored.
+// Throws std::runtime_error if the description is invalid.
+auto parse_scene_text(const std::string& filename) -> SceneData;
+
+// write_scene_file writes the columns of a scene to a scene file.
+// Throws std::runtime_error if the file can not be written.
+void write_scene_file(const SceneView& view, const std::string& filename);
+
+// make_scene creates a Scene from the columns of a scene. The spheres, and the vertices and the
+// triangle blocks of the meshes, are used where they are, and the owner, which must keep the
+// columns valid, is kept for as long as the scene or a scene made from it needs them.
+// Throws std::runtime_error if a mesh has to be prepared and has an index that is out of range.
+auto make_scene(const SceneView& view, std::shared_ptr<const void> owner) -> Scene;
+
+// load_scene_file maps a scene file and makes a Scene that uses its columns, see make_scene.
+// Throws std::runtime_error if the file can not be loaded.
+auto load_scene_file(const std::string& filename) -> Scene;
@@ -9,23 +9,38 @@
  * The ability to create a class in C++ is needed.
  */
 
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "mappedfile.hpp"
+
 using namespace std::string_literals;
 
-enum class TokenType {
+enum class TokenType : uint8_t {
     SEMICOLON,
+    COMMA,
     PAROPEN,
     PARCLOSE,
     BLOCKOPEN,
     BLOCKCLOSE,
+    PLUS,
+    MINUS,
+    STAR,
+    SLASH,
+    ASSIGN,
     GT, // greater than
     LT, // less than
     GTEQ, // greater than or equal to
     LTEQ, // less than or equal to
     EQ, // equal to
+    NOTEQ, // not equal to
     KEYWORD, // a recognized keyword, like "if"
     NAME, // a non-recognized keyword, like "x"
     NUMBER,
@@ -34,15 +49,63 @@ enum class TokenType {
     UNRECOGNIZED
 };
 
+// A token points into the source it was found in, instead of holding a copy of it.
+// The source must outlive the token.
 class Token {
 public:
     TokenType type;
-    std::string source;
+    std::string_view source;
 };
 
-auto tokenize(const std::string source) -> std::vector<Token>;
+auto tokenize(std::string_view source) -> std::vector<Token>;
+
+
+// read_file reads the whole file into a string.
+// Throws std::runtime_error if the file can not be read.
+inline auto read_file(const std::string& filename) -> std::string
+{
+    std::ifstream in { filename, std::ios::binary };
+    if (!in) {
+        throw std::runtime_error("could not open "s + filename);
+    }
+    std::string contents { std::istreambuf_iterator<char> { in }, {} };
+    if (in.bad()) {
+        throw std::runtime_error("could not read "s + filename);
+    }
+    return contents;
+}
+
+// Script is a script file, together with its tokens. The tokens point straight into the contents
+// of the file, and stay valid for as long as the Script exists.
+//
+// The file is memory mapped, unless copy is set, in which case it is read into memory. Files that
+// can be changed while they are read, like scripts that are reloaded when they are saved, must be
+// copied. An editor that truncates a mapped file before writing it makes reading the pages past
+// the new end fail with SIGBUS.
+class Script {
+protected:
+    const std::optional<MappedFile> m_file;
+    const std::string m_contents; // only used if the file is copied
+    const std::vector<Token> m_tokens;
+
+public:
+    explicit Script(const std::string& filename, bool copy = false)
+        : m_file { copy ? std::nullopt : std::optional<MappedFile> { std::in_place, filename } }
+        , m_contents { copy ? read_file(filename) : ""s }
+        , m_tokens { tokenize(source()) }
+    {
+    }
 
-auto interpret(std::vector<Token> tokens) -> int;
+    const std::string_view source() const;
+    const std::vector<Token>& tokens() const;
+};
+
+inline const std::string_view Script::source() const
+{
+    return m_file ? m_file->view() : std::string_view { m_contents };
+}
+
+inline const std::vector<Token>& Script::tokens() const { return m_tokens; }
 
 inline std::ostream& operator<<(std::ostream& os, const TokenType& type)
 {
@@ -50,6 +113,9 @@ inline std::ostream& operator<<(std::ostream& os, const TokenType& type)
     case TokenType::SEMICOLON:
         os << "semicolon";
         break;
+    case TokenType::COMMA:
+        os << "comma";
+        break;
     case TokenType::PAROPEN:
         os << "paropen";
         break;
@@ -62,6 +128,21 @@ inline std::ostream& operator<<(std::ostream& os, const TokenType& type)
     case TokenType::BLOCKCLOSE:
         os << "blockclose";
         break;
+    case TokenType::PLUS:
+        os << "plus";
+        break;
+    case TokenType::MINUS:
+        os << "minus";
+        break;
+    case TokenType::STAR:
+        os << "star";
+        break;
+    case TokenType::SLASH:
+        os << "slash";
+        break;
+    case TokenType::ASSIGN:
+        os << "assign";
+        break;
     case TokenType::NEWLINE:
         os << "newline";
         break;
@@ -92,6 +173,9 @@ inline std::ostream& operator<<(std::ostream& os, const TokenType& type)
     case TokenType::LTEQ:
         os << "lteq";
         break;
+    case TokenType::NOTEQ:
+        os << "noteq";
+        break;
     case TokenType::UNRECOGNIZED:
         os << "unrecognized";
         break;
@@ -0,0 +1,36 @@
+#pragma once
+
+// The shading formulas, shared by Scene and StaticScene
+
+#include "color.hpp"
+#include "point.hpp"
+#include "vec3.hpp"
+
+// shade_sphere returns the color of a point on a sphere, lit by a light at lightPos.
+// The math policy decides how the vectors are normalized, see mathpolicy.hpp.
+template <typename Math>
+inline const RGB shade_sphere(
+    const Point3 lightPos, const RGB color, const Point3 intersectionPoint, const Vec3 normal)
+{
+    // Get the vector pointing to the light from the intersection point. This is
+    // sometimes known as just "L".
+    const auto lightDirection = lightPos - intersectionPoint;
+
+    // Get the dot product between the normalized light vector and the normalized
+    // normal vector. This says something about to which degree the surface normal
+    // points towards the light.
+    const double dt = Math::normalize(lightDirection).dot(Math::normalize(normal));
+
+    // Use a formula for producting a color from dt.
+    return (color + Color::white * dt) * .5;
+}
+
+// shade_surface returns the color of a point on a plane, a cube or a mesh. It is shaded like a
+// sphere, and then mixed with the background color.
+template <typename Math>
+inline const RGB shade_surface(const Point3 lightPos, const RGB color, const RGB backgroundColor,
+    const Point3 intersectionPoint, const Vec3 normal)
+{
+    return shade_sphere<Math>(lightPos, color, intersectionPoint, normal) * .5
+        + backgroundColor * .5;
+}
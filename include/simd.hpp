@@ -0,0 +1,135 @@
+#pragma once
+
+// SIMD kernels for the innermost loops. Each kernel is compiled for several instruction sets, in
+// the same binary, and the best one that the CPU supports is selected when the program starts.
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+// SimdLevel is an instruction set that the kernels are compiled for
+enum class SimdLevel {
+    SCALAR, // plain C++, for any CPU
+    SSE42, // two doubles at a time
+    AVX2, // four doubles at a time
+    AVX512 // eight doubles at a time
+};
+
+// The largest number of doubles that a kernel handles at once. Arrays that are passed to the
+// kernels are padded to a multiple of this.
+constexpr size_t simdWidth = 8;
+
+// AlignedAllocator allocates memory that starts at a multiple of Align bytes, so that SIMD loads
+// never cross a cache line
+template <typename T, size_t Align>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Align>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t { Align }));
+    }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t { Align }); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Align>&) const
+    {
+        return true;
+    }
+};
+
+// AlignedVector is a vector that starts at the beginning of a cache line
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 64>>;
+
+// Vec3a is a vector that is padded to four doubles and aligned to 32 bytes, so that it can be
+// loaded into one AVX register. Unlike Vec3, it is only used for passing values to the kernels.
+struct alignas(32) Vec3a {
+    double x;
+    double y;
+    double z;
+    double pad = 0;
+};
+
+// SphereLanes is the sphere terms of a list of spheres (see SphereTerms in frame.hpp), with each
+// term in its own array, so that a kernel can load the same term for several spheres at once.
+// The arrays are aligned to 64 bytes, and count is a multiple of simdWidth. Spheres that are only
+// there for padding have a c of infinity, and are never hit.
+struct SphereLanes {
+    const double* x;
+    const double* y;
+    const double* z;
+    const double* c;
+    size_t count;
+};
+
+// simd_detect returns the best level that the CPU supports
+SimdLevel simd_detect();
+
+// simd_level returns the level that the kernels use. It starts out as simd_detect().
+SimdLevel simd_level();
+
+// simd_select makes the kernels use the given level, for comparing them. If the CPU does not
+// support it, the level is not changed, and false is returned.
+bool simd_select(SimdLevel level);
+
+// simd_name returns the name of a level, as it is given to simd_parse
+const char* simd_name(SimdLevel level);
+
+// simd_parse returns the level with the given name, if there is one
+std::optional<SimdLevel> simd_parse(const std::string& name);
+
+// closest_sphere finds the closest sphere that a ray from the camera hits, where the camera is
+// the origin that the sphere terms were calculated for. It returns the index of the sphere in the
+// lanes, and sets t so that the hit is at origin + t * direction. If no sphere is hit, count is
+// returned. If several spheres are equally close, the first one is returned, so that all levels
+// give the same results.
+size_t closest_sphere(const SphereLanes& lanes, const Vec3a& direction, double& t);
+
+// argb_to_yuv420 converts an image of ARGB8888 pixels, row by row without padding, to the Y, U
+// and V planes of YUV 4:2:0 video, in studio range. Y has width x height bytes, and U and V have
+// (width + 1) / 2 x (height + 1) / 2 bytes each, where each byte is the average of 2x2 pixels.
+void argb_to_yuv420(
+    const uint32_t* argb, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v);
+
+// The number of entries in a table for gamma encoding, for pack_argb. A color c from 0 to 255 is
+// looked up at c * (gammaLutSize - 1) / 255, rounded down.
+constexpr int gammaLutSize = 4096;
+
+// pack_argb clamps count colors, one plane per channel, to 0..255, and packs them into ARGB8888
+// pixels, with an alpha of 255. If lut is not null, each channel is looked up in it, as a table
+// of gammaLutSize entries, after clamping.
+void pack_argb(const float* r, const float* g, const float* b, size_t count, const uint32_t* lut,
+    uint32_t* argb);
+
+// ToneMap is a curve that maps linear colors, which can be brighter than white, to 0..255
+enum class ToneMap {
+    LINEAR, // no curve, colors brighter than white are clamped when they are packed
+    REINHARD, // x / (1 + x), which never quite reaches white
+    ACES // the filmic curve of the ACES reference, as fitted by Krzysztof Narkowicz
+};
+
+// tone_map multiplies count colors of one channel by the exposure, and maps them to 0..255 with
+// the given curve, in place. 255 is white, both before and after. Negative colors and NaN become
+// 0. The colors are not clamped to 255, since pack_argb does that.
+void tone_map(float* c, size_t count, ToneMap curve, float exposure);
+
+// tone_map_name returns the name of a curve, as it is given to tone_map_parse
+const char* tone_map_name(ToneMap curve);
+
+// tone_map_parse returns the curve with the given name, if there is one
+std::optional<ToneMap> tone_map_parse(const std::string& name);
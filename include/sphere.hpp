@@ -5,36 +5,41 @@
 #include <sstream>
 #include <string>
 
+#include "color.hpp"
 #include "point.hpp"
 #include "vec3.hpp"
 
 using namespace std::string_literals;
 
-// Sphere has a position and a radius
+// Sphere has a position, a radius and a color
 class Sphere {
 protected:
     const Point3 m_pos;
     const double m_radius;
+    const RGB m_color;
 
 public:
-    Sphere(double _x, double _y, double _z, double _r)
+    constexpr Sphere(double _x, double _y, double _z, double _r, const RGB _color = Color::red)
         : m_pos { _x, _y, _z }
         , m_radius { _r }
+        , m_color { _color }
     {
     }
-    Sphere(const Point3 _pos, double _r)
+    constexpr Sphere(const Point3 _pos, double _r, const RGB _color = Color::red)
         : m_pos { _pos }
         , m_radius { _r }
+        , m_color { _color }
     {
     }
     const std::string str() const;
-    double x() const;
-    double y() const;
-    double z() const;
-    double r() const;
-    double radius() const;
-    double radius_squared() const;
-    const Point3 pos() const;
+    constexpr double x() const;
+    constexpr double y() const;
+    constexpr double z() const;
+    constexpr double r() const;
+    constexpr double radius() const;
+    constexpr double radius_squared() const;
+    constexpr const Point3 pos() const;
+    constexpr const RGB color() const;
     const Vec3 normal(const Point3 p) const;
 };
 
@@ -55,19 +60,21 @@ inline std::ostream& operator<<(std::ostream& os, const Sphere& s)
     return os;
 }
 
-double Sphere::x() const { return m_pos.x(); }
+constexpr double Sphere::x() const { return m_pos.x(); }
 
-double Sphere::y() const { return m_pos.y(); }
+constexpr double Sphere::y() const { return m_pos.y(); }
 
-double Sphere::z() const { return m_pos.z(); }
+constexpr double Sphere::z() const { return m_pos.z(); }
 
-double Sphere::r() const { return m_radius; }
+constexpr double Sphere::r() const { return m_radius; }
 
-double Sphere::radius() const { return m_radius; }
+constexpr double Sphere::radius() const { return m_radius; }
 
-double Sphere::radius_squared() const { return m_radius * m_radius; }
+constexpr double Sphere::radius_squared() const { return m_radius * m_radius; }
 
-const Point3 Sphere::pos() const { return m_pos; }
+constexpr const Point3 Sphere::pos() const { return m_pos; }
+
+constexpr const RGB Sphere::color() const { return m_color; }
 
 // Get the normal sticking out from the sphere at the point p on the surface of the sphere
-const Vec3 Sphere::normal(const Point3 p) const { return (p - m_pos) / m_radius; }
+inline const Vec3 Sphere::normal(const Point3 p) const { return (p - m_pos) / m_radius; }
@@ -0,0 +1,52 @@
+#pragma once
+
+// Spheres that are stored one column per property, like in a scene file
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "color.hpp"
+#include "sphere.hpp"
+
+// SphereColumns is a list of spheres, stored as one array for each coordinate, the radius and the
+// material, and the material colors. A Scene can use the columns of a mapped scene file this way,
+// without copying them. The columns stay valid for as long as the owner exists.
+struct SphereColumns {
+    std::span<const double> x;
+    std::span<const double> y;
+    std::span<const double> z;
+    std::span<const double> r;
+    std::span<const uint32_t> material; // index into the material columns
+    std::span<const double> materialR;
+    std::span<const double> materialG;
+    std::span<const double> materialB;
+    std::shared_ptr<const void> owner;
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    // sphere returns sphere i, as a Sphere
+    const Sphere sphere(size_t i) const;
+
+    // spheres returns a copy of all the spheres
+    auto spheres() const -> std::vector<Sphere>;
+};
+
+inline const Sphere SphereColumns::sphere(size_t i) const
+{
+    const uint32_t m = material[i];
+    return Sphere { x[i], y[i], z[i], r[i], RGB { materialR[m], materialG[m], materialB[m] } };
+}
+
+inline auto SphereColumns::spheres() const -> std::vector<Sphere>
+{
+    std::vector<Sphere> result;
+    result.reserve(size());
+    for (size_t i = 0; i < size(); ++i) {
+        result.push_back(sphere(i));
+    }
+    return result;
+}
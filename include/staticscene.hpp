@@ -0,0 +1,260 @@
+#pragma once
+
+// A scene with a fixed number of objects, for demos where the content is known at compile time
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "color.hpp"
+#include "cube.hpp"
+#include "frame.hpp"
+#include "mathpolicy.hpp"
+#include "plane.hpp"
+#include "point.hpp"
+#include "ray.hpp"
+#include "shading.hpp"
+#include "sphere.hpp"
+#include "vec3.hpp"
+
+// Bounds is a box around a group of objects, aligned with the axes
+struct Bounds {
+    const Point3 min;
+    const Point3 max;
+};
+
+// sphere_term calculates the terms of the intersection test for rays that start at the given
+// origin, the same way as Scene::cull does for the visible spheres
+constexpr auto sphere_term(const Sphere& sphere, const Point3 origin) -> SphereTerms
+{
+    const Vec3 c = sphere.pos() - origin;
+    return SphereTerms { c.x(), c.y(), c.z(), c.len_squared() - sphere.radius_squared() };
+}
+
+template <size_t N>
+constexpr auto sphere_terms(const std::array<Sphere, N>& spheres, const Point3 origin)
+    -> std::array<SphereTerms, N>
+{
+    std::array<SphereTerms, N> terms {};
+    for (size_t i = 0; i < N; ++i) {
+        terms[i] = sphere_term(spheres[i], origin);
+    }
+    return terms;
+}
+
+// bounds_of finds the box around the given spheres and cubes. A cube is treated as a sphere with
+// a radius of half of w + h + d, which is larger than the half diagonal, so that the box holds the
+// cube for any rotation without needing a square root. With no objects, the box is empty.
+template <size_t NSpheres, size_t NCubes>
+constexpr auto bounds_of(const std::array<Sphere, NSpheres>& spheres,
+    const std::array<Cube, NCubes>& cubes) -> Bounds
+{
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    double lo[3] = { inf, inf, inf };
+    double hi[3] = { -inf, -inf, -inf };
+    const auto add = [&](const Point3 p, double r) {
+        const double c[3] = { p.x(), p.y(), p.z() };
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = std::min(lo[axis], c[axis] - r);
+            hi[axis] = std::max(hi[axis], c[axis] + r);
+        }
+    };
+    for (const auto& sphere : spheres) {
+        add(sphere.pos(), sphere.r());
+    }
+    for (const auto& cube : cubes) {
+        add(cube.pos(), (cube.w() + cube.h() + cube.d()) / 2);
+    }
+    return Bounds { Point3 { lo[0], lo[1], lo[2] }, Point3 { hi[0], hi[1], hi[2] } };
+}
+
+// StaticScene has a light, NSpheres spheres, NPlanes planes, NCubes cubes and a background color.
+// The objects are kept in arrays, so every loop over them has a length that is known at compile
+// time, and can be unrolled by the compiler. There are no meshes, and the scene can not be
+// changed. The object IDs are the same as for a Scene with the same content.
+//
+// When the scene is constexpr, the terms of the spheres for rays from the view point, and the box
+// around the spheres and the cubes, are calculated at compile time. Rays from the view point use
+// the terms instead of calculating them, and rays that miss the box skip the spheres and cubes.
+template <size_t NSpheres, size_t NPlanes, size_t NCubes>
+class StaticScene {
+protected:
+    const Sphere m_light;
+    const std::array<Plane, NPlanes> m_planes;
+    const std::array<Sphere, NSpheres> m_spheres;
+    const std::array<Cube, NCubes> m_cubes;
+    const RGB m_backgroundColor;
+
+    const Point3 m_viewPoint;
+    const std::array<SphereTerms, NSpheres> m_terms; // for rays from the view point
+    const Bounds m_bounds; // around the spheres and the cubes
+
+    bool hits_bounds(const Point3 origin, const Vec3 direction) const;
+
+public:
+    constexpr StaticScene(const Sphere light, const std::array<Plane, NPlanes> planes,
+        const std::array<Sphere, NSpheres> spheres, const std::array<Cube, NCubes> cubes,
+        const RGB backgroundColor, const Point3 viewPoint = Point3 { 0, 0, 0 })
+        : m_light { light }
+        , m_planes { planes }
+        , m_spheres { spheres }
+        , m_cubes { cubes }
+        , m_backgroundColor { backgroundColor }
+        , m_viewPoint { viewPoint }
+        , m_terms { sphere_terms(spheres, viewPoint) }
+        , m_bounds { bounds_of(spheres, cubes) }
+    {
+    }
+
+    // Raytrace a single pixel, with a ray going from fromPoint towards (x, y, 0)
+    template <typename Math = ExactMath>
+    const RGB color(const Point3 fromPoint, double x, double y) const;
+    template <typename Math = ExactMath>
+    const RGB color(const Point3 fromPoint, double x, double y, double& depth, int& id) const;
+
+    // Raytrace a single ray, and also return the depth and the ID of the closest object
+    template <typename Math = ExactMath>
+    const RGB color(const Ray& ray, double& depth, int& id) const;
+
+    static constexpr size_t sphere_count() { return NSpheres; }
+    static constexpr size_t plane_count() { return NPlanes; }
+    static constexpr size_t cube_count() { return NCubes; }
+
+    constexpr const Point3 view_point() const { return m_viewPoint; }
+    constexpr const std::array<SphereTerms, NSpheres>& terms() const { return m_terms; }
+    constexpr const Bounds& bounds() const { return m_bounds; }
+};
+
+// Check if a ray hits the box around the spheres and the cubes (the slab method). Rays that
+// start inside of the box always hit it.
+template <size_t NSpheres, size_t NPlanes, size_t NCubes>
+inline bool StaticScene<NSpheres, NPlanes, NCubes>::hits_bounds(
+    const Point3 origin, const Vec3 direction) const
+{
+    const double o[3] = { origin.x(), origin.y(), origin.z() };
+    const double d[3] = { direction.x(), direction.y(), direction.z() };
+    const double lo[3] = { m_bounds.min.x(), m_bounds.min.y(), m_bounds.min.z() };
+    const double hi[3] = { m_bounds.max.x(), m_bounds.max.y(), m_bounds.max.z() };
+    double tmin = 0;
+    double tmax = std::numeric_limits<double>::infinity();
+    for (int axis = 0; axis < 3; ++axis) {
+        const double inv = 1.0 / d[axis];
+        double t0 = (lo[axis] - o[axis]) * inv;
+        double t1 = (hi[axis] - o[axis]) * inv;
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+    }
+    return tmin <= tmax;
+}
+
+template <size_t NSpheres, size_t NPlanes, size_t NCubes>
+template <typename Math>
+inline const RGB StaticScene<NSpheres, NPlanes, NCubes>::color(
+    const Point3 fromPoint, double x, double y) const
+{
+    double depth;
+    int id;
+    return color<Math>(fromPoint, x, y, depth, id);
+}
+
+template <size_t NSpheres, size_t NPlanes, size_t NCubes>
+template <typename Math>
+inline const RGB StaticScene<NSpheres, NPlanes, NCubes>::color(
+    const Point3 fromPoint, double x, double y, double& depth, int& id) const
+{
+    return color<Math>(Ray { fromPoint, Vec3 { x, y, 0 } }, depth, id);
+}
+
+// The same as Scene::trace, for the objects that a StaticScene can have. The spheres are tested
+// with the half-b form of the intersection test, without creating optionals, and only the closest
+// sphere is shaded. The spheres and the cubes are only tested if the ray hits the box around them.
+template <size_t NSpheres, size_t NPlanes, size_t NCubes>
+template <typename Math>
+inline const RGB StaticScene<NSpheres, NPlanes, NCubes>::color(
+    const Ray& ray, double& depth, int& id) const
+{
+    const Point3 fromPoint = ray.p0();
+
+    // The closest hit so far
+    double smallestDepth = 0;
+    bool firstFind = true;
+    double closestColor[3] = { 0, 0, 0 }; // RGB is constant, so the parts are kept instead
+    int closestID = -1;
+
+    // Keep the hit if it is closer than the closest hit so far
+    const auto found = [&](double currentDepth, const RGB& currentColor, int objectID) {
+        if (currentDepth < smallestDepth || firstFind) {
+            smallestDepth = currentDepth;
+            firstFind = false;
+            closestColor[0] = currentColor.R();
+            closestColor[1] = currentColor.G();
+            closestColor[2] = currentColor.B();
+            closestID = objectID;
+        }
+    };
+
+    // With the center C relative to the start of the ray, and b = D · C, the ray hits the sphere
+    // where t = (b - sqrt(b² - |D|² * (|C|² - r²))) / |D|². C and |C|² - r² are the terms of the
+    // sphere, which are already known for rays from the view point.
+    const Vec3 d = ray.direction();
+    const double a = d.len_squared();
+    const bool inBounds = hits_bounds(fromPoint, d);
+    const bool fromView = fromPoint == m_viewPoint;
+    double closestT = std::numeric_limits<double>::infinity();
+    size_t closest = 0;
+    for (size_t i = 0; i < (inBounds ? NSpheres : 0); ++i) {
+        const SphereTerms terms = fromView ? m_terms[i] : sphere_term(m_spheres[i], fromPoint);
+        const double b = d.dot(Vec3 { terms.x, terms.y, terms.z });
+        const double discriminant = b * b - a * terms.c;
+        if (discriminant <= 0) {
+            continue;
+        }
+        const double t = (b - std::sqrt(discriminant)) / a;
+        if (t >= 0 && t < closestT) {
+            closestT = t;
+            closest = i;
+        }
+    }
+    if (closestT != std::numeric_limits<double>::infinity()) {
+        const Point3 intersectionPoint = fromPoint + closestT * d;
+        found(Math::distance(fromPoint, intersectionPoint),
+            shade_sphere<Math>(m_light.pos(), m_spheres[closest].color(), intersectionPoint,
+                m_spheres[closest].normal(intersectionPoint)),
+            static_cast<int>(closest));
+    }
+
+    for (size_t i = 0; i < NPlanes; ++i) {
+        if (const auto hit = ray.intersect(m_planes[i])) {
+            found(Math::distance(fromPoint, hit->first),
+                shade_surface<Math>(m_light.pos(), m_planes[i].color(), m_backgroundColor,
+                    hit->first, hit->second),
+                static_cast<int>(NSpheres + i));
+        }
+    }
+
+    for (size_t i = 0; i < (inBounds ? NCubes : 0); ++i) {
+        if (const auto hit = ray.intersect(m_cubes[i])) {
+            found(Math::distance(fromPoint, hit->first),
+                shade_surface<Math>(m_light.pos(), m_cubes[i].color(), m_backgroundColor,
+                    hit->first, hit->second),
+                static_cast<int>(NSpheres + NPlanes + i));
+        }
+    }
+
+    if (firstFind) { // Found no color to use
+        depth = std::numeric_limits<double>::infinity();
+        id = -1;
+        return m_backgroundColor;
+    }
+
+    // Now return the color that had the smallest depth. It is linear, and not clamped, so that
+    // colors that are brighter than white are kept until the frame is tone mapped.
+    depth = smallestDepth;
+    id = closestID;
+    return RGB { closestColor[0], closestColor[1], closestColor[2] };
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// A triangle in 3D space
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "point.hpp"
+#include "vec3.hpp"
+
+using namespace std::string_literals;
+
+// Triangle has three corners
+class Triangle {
+protected:
+    const Point3 m_a;
+    const Point3 m_b;
+    const Point3 m_c;
+
+public:
+    Triangle(const Point3 a, const Point3 b, const Point3 c)
+        : m_a { a }
+        , m_b { b }
+        , m_c { c }
+    {
+    }
+
+    const std::string str() const;
+
+    const Point3 a() const;
+    const Point3 b() const;
+    const Point3 c() const;
+
+    const Vec3 normal() const;
+};
+
+// str returns a string representation of the triangle
+// The string function returns a constant string ("const std::string"),
+// and does not modify anything ("const").
+inline const std::string Triangle::str() const
+{
+    std::stringstream ss;
+    ss << "triangle: ("s << m_a << ", "s << m_b << ", "s << m_c << ")"s;
+    return ss.str();
+}
+
+// Implement support for the << operator, by calling the Triangle str method
+inline std::ostream& operator<<(std::ostream& os, const Triangle& t)
+{
+    os << t.str();
+    return os;
+}
+
+inline const Point3 Triangle::a() const { return m_a; }
+
+inline const Point3 Triangle::b() const { return m_b; }
+
+inline const Point3 Triangle::c() const { return m_c; }
+
+// Get the normal of the triangle. The corners are in counter-clockwise order when looking at the
+// side the normal sticks out from.
+inline const Vec3 Triangle::normal() const { return (m_b - m_a).cross(m_c - m_a).normalize(); }
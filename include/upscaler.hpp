@@ -0,0 +1,140 @@
+#pragma once
+
+// Edge-aware upscaling from the internal render resolution to the window resolution
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Upscaler resizes a traced ARGB frame to a larger frame. Each output pixel blends the four
+// closest traced pixels, like a bilinear filter, but only the pixels that belong to the same
+// object as the nearest traced pixel, and that are at roughly the same depth, are blended.
+// This keeps the edges of spheres and cubes crisp instead of smearing them into the background.
+class Upscaler {
+protected:
+    // Per output column: the left source column and the 8-bit horizontal blend weight
+    std::vector<int> m_x0;
+    std::vector<int> m_fx;
+
+    // Per output row: the top source row and the 8-bit vertical blend weight
+    std::vector<int> m_y0;
+    std::vector<int> m_fy;
+
+    int m_srcw = 0;
+    int m_srch = 0;
+    int m_dstw = 0;
+    int m_dsth = 0;
+
+    // Relative depth difference above which two pixels are considered to be on different surfaces
+    const float m_depthThreshold;
+
+    void prepare(int srcw, int srch, int dstw, int dsth);
+
+public:
+    Upscaler(float depthThreshold = 0.05f)
+        : m_depthThreshold { depthThreshold }
+    {
+    }
+
+    // upscale reads srcw x srch ARGB pixels together with the depth and object ID of each pixel,
+    // and writes dstw x dsth ARGB pixels to dst. dstPitch is the length of a destination row,
+    // in bytes, as returned by SDL_LockTexture.
+    void upscale(const uint32_t* src, const float* depth, const int32_t* ids, int srcw, int srch,
+        uint32_t* dst, int dstw, int dsth, int dstPitch);
+};
+
+// Set up the source coordinates and blend weights for every output row and column.
+// These only change when one of the resolutions change.
+inline void Upscaler::prepare(int srcw, int srch, int dstw, int dsth)
+{
+    if (srcw == m_srcw && srch == m_srch && dstw == m_dstw && dsth == m_dsth) {
+        return;
+    }
+    m_srcw = srcw;
+    m_srch = srch;
+    m_dstw = dstw;
+    m_dsth = dsth;
+
+    const auto axis = [](int srcn, int dstn, std::vector<int>& i0, std::vector<int>& f) {
+        i0.resize(dstn);
+        f.resize(dstn);
+        const double ratio = static_cast<double>(srcn) / static_cast<double>(dstn);
+        for (int d = 0; d < dstn; ++d) {
+            // Map the center of the output pixel to the source image
+            double s = (d + 0.5) * ratio - 0.5;
+            if (s < 0) {
+                s = 0;
+            }
+            int s0 = static_cast<int>(s);
+            if (s0 > srcn - 2) {
+                s0 = srcn > 1 ? srcn - 2 : 0;
+                s = srcn > 1 ? std::fmin(s, srcn - 1.0) : 0;
+            }
+            i0[d] = s0;
+            f[d] = static_cast<int>((s - s0) * 256.0 + 0.5);
+        }
+    };
+
+    axis(srcw, dstw, m_x0, m_fx);
+    axis(srch, dsth, m_y0, m_fy);
+}
+
+inline void Upscaler::upscale(const uint32_t* src, const float* depth, const int32_t* ids,
+    int srcw, int srch, uint32_t* dst, int dstw, int dsth, int dstPitch)
+{
+    prepare(srcw, srch, dstw, dsth);
+
+    const float threshold = m_depthThreshold;
+
+    // The neighbouring column and row, or the same one if the image is only one pixel wide or high
+    const int xstep = srcw > 1 ? 1 : 0;
+    const int ystep = srch > 1 ? srcw : 0;
+
+#pragma omp parallel for
+    for (int dy = 0; dy < dsth; ++dy) {
+        uint32_t* row
+            = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(dst) + dy * dstPitch);
+        const int fy = m_fy[dy];
+        const int rowStart = m_y0[dy] * srcw;
+        for (int dx = 0; dx < dstw; ++dx) {
+            const int fx = m_fx[dx];
+
+            // The four closest source pixels: top left, top right, bottom left and bottom right
+            const int i[4] = { rowStart + m_x0[dx], rowStart + m_x0[dx] + xstep,
+                rowStart + m_x0[dx] + ystep, rowStart + m_x0[dx] + xstep + ystep };
+
+            // Bilinear weights, in 1/65536 units
+            int w[4] = { (256 - fx) * (256 - fy), fx * (256 - fy), (256 - fx) * fy, fx * fy };
+
+            // The nearest source pixel decides which surface this output pixel belongs to
+            const int nearest = (fx < 128 ? 0 : 1) + (fy < 128 ? 0 : 2);
+            const int32_t id = ids[i[nearest]];
+            const float d = depth[i[nearest]];
+
+            // Drop the weights of the pixels that are on a different surface
+            int total = 0;
+            for (int k = 0; k < 4; ++k) {
+                if (ids[i[k]] != id || std::fabs(depth[i[k]] - d) > threshold * d) {
+                    w[k] = 0;
+                }
+                total += w[k];
+            }
+
+            if (total == 0) { // only happens if all weights were zero to begin with
+                row[dx] = src[i[nearest]];
+                continue;
+            }
+
+            // Blend each 8-bit channel
+            uint32_t out = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                int sum = 0;
+                for (int k = 0; k < 4; ++k) {
+                    sum += w[k] * static_cast<int>((src[i[k]] >> shift) & 0xFF);
+                }
+                out |= static_cast<uint32_t>((sum + total / 2) / total) << shift;
+            }
+            row[dx] = out;
+        }
+    }
+}
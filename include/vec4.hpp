@@ -15,64 +15,64 @@ protected:
     const double v[4];
 
 public:
-    Vec4(double _x, double _y, double _z, double _t)
+    constexpr Vec4(double _x, double _y, double _z, double _t)
         : v { _x, _y, _z, _t }
     {
     }
 
-    const Vec4 operator+(const Vec4& a) const; // addition
-    const Vec4 operator-(const Vec4& a) const; // subtraction
-    const Vec4 operator*(const double d) const; // scale
-    const Vec4 operator/(const double d) const; // div
-    double dot(const Vec4& a) const; // dot product
+    constexpr const Vec4 operator+(const Vec4& a) const; // addition
+    constexpr const Vec4 operator-(const Vec4& a) const; // subtraction
+    constexpr const Vec4 operator*(const double d) const; // scale
+    constexpr const Vec4 operator/(const double d) const; // div
+    constexpr double dot(const Vec4& a) const; // dot product
     const Vec4 cross(const Vec4& a) const; // cross product
     double len() const; // length from (0,0,0,0)
-    double len_squared() const; // length from (0,0,0,0), squared
-    bool operator<(const Vec4& a) const; // less than, without using sqrt
-    bool operator>(const Vec4& a) const; // greater than, without using sqrt
+    constexpr double len_squared() const; // length from (0,0,0,0), squared
+    constexpr bool operator<(const Vec4& a) const; // less than, without using sqrt
+    constexpr bool operator>(const Vec4& a) const; // greater than, without using sqrt
     const Vec4 normalize() const; // the normalized version
     const std::string str() const;
 
-    double x() const;
-    double y() const;
-    double z() const;
-    double t() const;
+    constexpr double x() const;
+    constexpr double y() const;
+    constexpr double z() const;
+    constexpr double t() const;
 
-    double R() const;
-    double G() const;
-    double B() const;
-    double A() const;
+    constexpr double R() const;
+    constexpr double G() const;
+    constexpr double B() const;
+    constexpr double A() const;
 
-    const Vec4 intify() const;
+    constexpr const Vec4 intify() const;
 };
 
 // Add components
-inline const Vec4 Vec4::operator+(const Vec4& a) const
+constexpr const Vec4 Vec4::operator+(const Vec4& a) const
 {
     return Vec4 { v[0] + a.v[0], v[1] + a.v[1], v[2] + a.v[2], v[3] + a.v[3] };
 }
 
 // Subtract components
-inline const Vec4 Vec4::operator-(const Vec4& a) const
+constexpr const Vec4 Vec4::operator-(const Vec4& a) const
 {
     return Vec4 { v[0] - a.v[0], v[1] - a.v[1], v[2] - a.v[2], v[3] - a.v[3] };
 }
 
 // Scale by a double
-inline const Vec4 Vec4::operator*(const double d) const
+constexpr const Vec4 Vec4::operator*(const double d) const
 {
     return Vec4 { v[0] * d, v[1] * d, v[2] * d, v[3] * d };
 }
 
 // Div by a double
-inline const Vec4 Vec4::operator/(const double d) const
+constexpr const Vec4 Vec4::operator/(const double d) const
 {
     const double r = (1.0 / d);
     return Vec4 { v[0] * r, v[1] * r, v[2] * r, v[3] * r };
 }
 
 // Dot product
-inline double Vec4::dot(const Vec4& a) const
+constexpr double Vec4::dot(const Vec4& a) const
 {
     return v[0] * a.v[0] + v[1] * a.v[1] + v[2] * a.v[2] + v[3] * a.v[3];
 }
@@ -81,17 +81,17 @@ inline double Vec4::dot(const Vec4& a) const
 inline double Vec4::len() const { return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]); }
 
 // Length; distance from (0, 0, 0), squared
-inline double Vec4::len_squared() const { return v[0] * v[0] + v[1] * v[1] + v[2] * v[2]; }
+constexpr double Vec4::len_squared() const { return v[0] * v[0] + v[1] * v[1] + v[2] * v[2]; }
 
 // Less than, without using sqrt
-inline bool Vec4::operator<(const Vec4& a) const
+constexpr bool Vec4::operator<(const Vec4& a) const
 {
     return (v[0] * v[0] + v[1] * v[1] + v[2] * v[2])
         < (a.v[0] * a.v[0] + a.v[1] * a.v[1] + a.v[2] * a.v[2]);
 }
 
 // Greater than, without using sqrt
-inline bool Vec4::operator>(const Vec4& a) const
+constexpr bool Vec4::operator>(const Vec4& a) const
 {
     return (v[0] * v[0] + v[1] * v[1] + v[2] * v[2] + v[3] * v[3])
         > (a.v[0] * a.v[0] + a.v[1] * a.v[1] + a.v[2] * a.v[2] + a.v[3] * a.v[3]);
@@ -122,31 +122,31 @@ inline std::ostream& operator<<(std::ostream& os, const Vec4& v)
     return os;
 }
 
-inline double Vec4::x() const { return v[0]; }
+constexpr double Vec4::x() const { return v[0]; }
 
-inline double Vec4::y() const { return v[1]; }
+constexpr double Vec4::y() const { return v[1]; }
 
-inline double Vec4::z() const { return v[2]; }
+constexpr double Vec4::z() const { return v[2]; }
 
-inline double Vec4::t() const { return v[3]; }
+constexpr double Vec4::t() const { return v[3]; }
 
-inline bool operator==(const Vec4& a, const Vec4& b)
+constexpr bool operator==(const Vec4& a, const Vec4& b)
 {
     return a.x() == b.x() && a.y() == b.y() && a.z() == b.z() && a.t() == b.t();
 }
 
-inline double Vec4::R() const { return v[0]; }
+constexpr double Vec4::R() const { return v[0]; }
 
-inline double Vec4::G() const { return v[1]; }
+constexpr double Vec4::G() const { return v[1]; }
 
-inline double Vec4::B() const { return v[2]; }
+constexpr double Vec4::B() const { return v[2]; }
 
-inline double Vec4::A() const { return v[3]; }
+constexpr double Vec4::A() const { return v[3]; }
 
 // Return a vec4 with only the integer parts of the coordinates.
 // This can be used for finding the normal vectors of a 4D cube,
 // if the center of the cube is at (0,0,0,0).
-inline const Vec4 Vec4::intify() const
+constexpr const Vec4 Vec4::intify() const
 {
     return Vec4 { static_cast<double>(static_cast<int>(v[0])),
         static_cast<double>(static_cast<int>(v[1])), static_cast<double>(static_cast<int>(v[2])),
@@ -0,0 +1,178 @@
+#pragma once
+
+/*
+ * Bytecode and a register based virtual machine for scripts.
+ *
+ * A script is compiled once. Every variable gets its own register, and the temporary values of
+ * expressions use the registers after the variables. Running the compiled script is then a tight
+ * loop over compact instructions, with no tokens or syntax tree involved.
+ *
+ * The functions a script can call, and the variables that the program sets before running it,
+ * are given to the compiler as Builtins. The same Builtins must be given to the VM.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast.hpp"
+#include "script.hpp"
+
+// Value is the contents of a register: a number, or a string from the bytecode
+class Value {
+public:
+    double number = 0;
+    const std::string* string = nullptr; // set if the value is a string
+};
+
+enum class OpCode : uint8_t {
+    LOADK, // a = constants[wide]
+    LOADS, // a = strings[wide]
+    MOVE, // a = b
+    NEG, // a = -b
+    ADD, // a = b + c
+    SUB, // a = b - c
+    MUL, // a = b * c
+    DIV, // a = b / c
+    LT, // a = b < c, as 1 or 0
+    GT,
+    LTEQ,
+    GTEQ,
+    EQ,
+    NOTEQ,
+    JUMP, // continue at wide
+    JUMPIFNOT, // continue at wide, if a is 0
+    CALL, // a = functions[n](c, c + 1, ... c + b - 1)
+    HALT
+};
+
+// Instruction is one bytecode instruction, in 8 bytes
+struct Instruction {
+    OpCode op;
+    uint8_t n; // the function, for CALL
+    uint16_t a; // the register that is written to, or tested
+    uint16_t b;
+    uint16_t c;
+
+    // wide returns b and c combined, for constant indices and jump targets
+    uint32_t wide() const { return static_cast<uint32_t>(b) | (static_cast<uint32_t>(c) << 16); }
+};
+
+// Bytecode is a compiled script
+class Bytecode {
+public:
+    std::vector<Instruction> code;
+    std::vector<double> constants;
+    std::vector<std::string> strings;
+    std::vector<std::string> variables; // the variable in each register, starting at register 0
+    size_t registerCount = 0;
+};
+
+// A function that can be called from scripts. It returns a number, which is 0 if it has nothing
+// else to return.
+using Builtin = std::function<double(std::span<const Value> args)>;
+
+// Builtins are the functions and variables that a program makes available to its scripts
+class Builtins {
+protected:
+    std::vector<std::string> m_names;
+    std::vector<int> m_arities;
+    std::vector<Builtin> m_functions;
+    std::vector<std::string> m_variables;
+
+public:
+    // Add a function. An arity of -1 means that any number of arguments is accepted.
+    void function(const std::string& name, int arity, Builtin f);
+
+    // Add a variable, that the program can set before running a script
+    void variable(const std::string& name);
+
+    std::optional<size_t> find(std::string_view name) const;
+    int arity(size_t index) const;
+    const Builtin& call(size_t index) const;
+    const std::vector<std::string>& variables() const;
+};
+
+inline void Builtins::function(const std::string& name, int arity, Builtin f)
+{
+    m_names.push_back(name);
+    m_arities.push_back(arity);
+    m_functions.push_back(std::move(f));
+}
+
+inline void Builtins::variable(const std::string& name) { m_variables.push_back(name); }
+
+inline std::optional<size_t> Builtins::find(std::string_view name) const
+{
+    for (size_t i = 0; i < m_names.size(); ++i) {
+        if (m_names[i] == name) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+inline int Builtins::arity(size_t index) const { return m_arities[index]; }
+
+inline const Builtin& Builtins::call(size_t index) const { return m_functions[index]; }
+
+inline const std::vector<std::string>& Builtins::variables() const { return m_variables; }
+
+// compile creates bytecode from the syntax tree of a script. Names and strings are copied, so
+// the source and the tree are not needed afterwards.
+// Throws std::runtime_error, with the line number, if the script uses unknown variables or
+// functions, or calls a function with the wrong number of arguments.
+auto compile(const SyntaxTree& tree, std::string_view source, const Builtins& builtins)
+    -> Bytecode;
+
+// compile_script tokenizes, parses and compiles a script
+auto compile_script(const Script& script, const Builtins& builtins) -> Bytecode;
+
+// VM runs compiled scripts. The registers are kept between runs, so that variables can be used to
+// keep track of things from one frame to the next.
+//
+// Each run may only take so many instructions, so that a script with an endless loop stops with
+// an error, instead of freezing the program that runs it every frame.
+class VM {
+protected:
+    const Builtins& m_builtins;
+    std::shared_ptr<const Bytecode> m_code;
+    std::vector<Value> m_registers;
+    uint64_t m_budget = 100'000'000; // the most instructions in one run
+
+public:
+    VM(const Builtins& builtins, std::shared_ptr<const Bytecode> code)
+        : m_builtins { builtins }
+        , m_code { std::move(code) }
+        , m_registers(m_code->registerCount)
+    {
+    }
+
+    // Switch to a new version of the script. Variables that are in both versions keep their
+    // values, so that a script can be changed while it is running.
+    void load(std::shared_ptr<const Bytecode> code);
+
+    // Set a variable before running the script. Returns false if there is no such variable.
+    bool set(std::string_view name, double value);
+
+    // Get the current value of a variable
+    std::optional<double> get(std::string_view name) const;
+
+    // Set the most instructions that one run may take
+    void budget(uint64_t instructions);
+
+    // Run the script from the start. Throws std::runtime_error if the run takes more instructions
+    // than its budget.
+    void run();
+};
+
+inline void VM::budget(uint64_t instructions) { m_budget = instructions; }
+
+// interpret compiles and runs a script once. Errors are printed to stderr.
+// Returns 0 on success and 1 on failure.
+auto interpret(const Script& script, const Builtins& builtins) -> int;
@@ -0,0 +1,61 @@
+#pragma once
+
+// Recompiling scripts when they change on disk
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vm.hpp"
+
+// ScriptWatcher compiles a set of scripts, and then watches their directories for changes on a
+// background thread. When a script is saved, only that script is tokenized and compiled again.
+// If it compiles, the new program waits in a slot until the render loop picks it up with take,
+// between two frames. If it does not compile, the error is printed and the old program stays.
+//
+// On Linux, the directories are watched with inotify. On other systems, the modification times of
+// the scripts are checked a few times per second.
+//
+// The Builtins are used from the background thread, and must not be changed while the watcher
+// is running.
+class ScriptWatcher {
+protected:
+    struct Slot {
+        std::string path; // the script, as it was given
+        std::string directory; // the directory the script is in
+        std::string name; // the filename, without the directory
+
+        std::atomic<bool> changed = false; // set when there is a new program to take
+        std::mutex mutex; // only held while swapping the program pointer
+        std::shared_ptr<const Bytecode> program;
+    };
+
+    const Builtins& m_builtins;
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    std::atomic<bool> m_stop = false;
+    std::thread m_thread;
+
+    // Compile a script, and place the program in the slot if there are no errors
+    bool recompile(Slot& slot);
+
+    void watch();
+
+public:
+    // Compile the given scripts and start watching them.
+    // Throws std::runtime_error if a script can not be read or compiled.
+    ScriptWatcher(const Builtins& builtins, const std::vector<std::string>& filenames);
+    ~ScriptWatcher();
+
+    ScriptWatcher(const ScriptWatcher&) = delete;
+    ScriptWatcher& operator=(const ScriptWatcher&) = delete;
+
+    // The number of scripts
+    size_t size() const;
+
+    // take returns the newest program for the script with the given index, if it has changed
+    // since the last call, or nullptr if it has not. This never waits for a compilation.
+    std::shared_ptr<const Bytecode> take(size_t index);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+// Streaming frames as YUV4MPEG2 video, to a file or a pipe, on a background thread
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Y4MWriter streams frames as uncompressed YUV 4:2:0 video, which encoders such as ffmpeg can
+// read from a pipe, as in "spheremover --y4m - | ffmpeg -i - video.mp4".
+//
+// Each frame is converted on the thread that calls write, with the SIMD kernel, and queued. The
+// queued frames are written on a thread of its own, with one system call per frame, so that the
+// render loop never waits for the pipe unless it asks to. Frame buffers are reused once they have
+// been written, so after the first frames, streaming does not allocate.
+class Y4MWriter {
+protected:
+    static constexpr size_t maxQueued = 8;
+
+    const int m_width;
+    const int m_height;
+    const size_t m_frameSize; // "FRAME\n" and the Y, U and V planes
+    int m_fd = -1;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<std::vector<uint8_t>> m_queue;
+    std::vector<std::vector<uint8_t>> m_spare; // buffers that have been written, for reuse
+    size_t m_writing = 0; // frames that are being converted or written, outside of the queue
+    size_t m_written = 0;
+    size_t m_dropped = 0;
+    bool m_failed = false;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    void run();
+
+public:
+    // Y4MWriter opens the file and writes the stream header. If the filename is "-", the video is
+    // written to standard output, and anything that is printed to standard output afterwards goes
+    // to standard error instead, so that it does not end up in the video. Throws
+    // std::runtime_error if the file can not be opened.
+    Y4MWriter(const std::string& filename, int width, int height, int fps);
+
+    // Write everything that is queued, then stop the thread and close the file
+    ~Y4MWriter();
+
+    Y4MWriter(const Y4MWriter&) = delete;
+    Y4MWriter& operator=(const Y4MWriter&) = delete;
+
+    int width() const;
+    int height() const;
+
+    // ready returns true if there is room in the queue for another frame. If there is not, the
+    // frame is counted as dropped, so that the caller can skip making it and not call write.
+    bool ready();
+
+    // write converts width x height ARGB8888 pixels to a frame and queues it. If the queue is full,
+    // write waits for room if wait is true, and otherwise drops the frame and returns false.
+    bool write(const uint32_t* argb, bool wait);
+
+    // finish waits until every queued frame has been written, and returns false if any write
+    // has failed, for instance because the reader of the pipe has quit
+    bool finish();
+
+    size_t written();
+    size_t dropped();
+};
+
+inline int Y4MWriter::width() const { return m_width; }
+
+inline int Y4MWriter::height() const { return m_height; }
@@ -1,9 +1,21 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <dlfcn.h>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include <SDL2/SDL.h>
@@ -16,12 +28,42 @@
 
 #include "cube.hpp"
 #include "disk.hpp"
+#include "mesh.hpp"
+#include "objloader.hpp"
 #include "plane.hpp"
+#include "quat.hpp"
 #include "sphere.hpp"
+#include "triangle.hpp"
 
+#include "demoscene.hpp"
 #include "scene.hpp"
+#include "scenefile.hpp"
+#include "staticscene.hpp"
 
+#include "bindings.hpp"
+#include "commands.hpp"
 #include "script.hpp"
+#include "vm.hpp"
+#include "watcher.hpp"
+
+#include "alloccount.hpp"
+#include "arena.hpp"
+#include "interner.hpp"
+
+#include "mathpolicy.hpp"
+
+#include "camera.hpp"
+#include "colorbuffer.hpp"
+#include "frame.hpp"
+#include "simd.hpp"
+
+#include "resolution.hpp"
+#include "upscaler.hpp"
+
+#include "batch.hpp"
+#include "imagewriter.hpp"
+#include "options.hpp"
+#include "y4mwriter.hpp"
 
 #include "ltimer.h"
 
@@ -108,6 +150,79 @@ void TestV4()
     std::cout << a << " > " << b << "? " << (a > b) << std::endl;
 }
 
+void TestQuat()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Quat ---"s << std::endl;
+
+    const double pi = std::numbers::pi;
+    const Quat q = Quat::from_axis_angle(Vec3 { 0, 0, 1 }, pi / 2);
+    std::cout << q << std::endl;
+    std::cout << "rotate (1, 0, 0) by 90 degrees around z: " << q.rotate(Vec3 { 1, 0, 0 })
+              << " (expected [0, 1, 0])" << std::endl;
+
+    // The fast formula gives the same result as q * v * conjugate(q)
+    const Quat r = Quat::from_axis_angle(Vec3 { 1, 2, 3 }, 0.7);
+    const Vec3 v { 4, -5, 6 };
+    const Quat slow = r * Quat { v, 0 } * r.conjugate();
+    std::cout << "fast rotate: " << r.rotate(v) << ", slow rotate: " << slow.xyz()
+              << ", same: " << (r.rotate(v).distance(slow.xyz()) < 1e-12) << std::endl;
+
+    // Combining rotations, and undoing them
+    const Quat twice = q * q;
+    std::cout << "rotate (1, 0, 0) by 180 degrees around z: " << twice.rotate(Vec3 { 1, 0, 0 })
+              << std::endl;
+    std::cout << "undone: " << r.conjugate().rotate(r.rotate(v)) << ", length " << r.len()
+              << std::endl;
+    std::cout << "as Vec4: " << Quat { r.vec4() }.vec4() << std::endl;
+
+    // A cube that is rotated 45 degrees around y shows an edge to a ray going along z
+    const Cube cube { Vec3 { 0, 0, 0 }, 2, 2, 2, Quat::from_axis_angle(Vec3 { 0, 1, 0 }, pi / 4) };
+    std::cout << cube << std::endl;
+    const Ray ray { Point3 { 0.1, 0, -10 }, Point3 { 0.1, 0, 0 } };
+    if (const auto hit = ray.intersect(cube)) {
+        std::cout << "hit rotated cube at " << hit->first << " (expected z "
+                  << -std::sqrt(2.0) + 0.1 << "), normal " << hit->second << std::endl;
+    } else {
+        std::cout << "missed the rotated cube" << std::endl;
+    }
+    const Ray past { Point3 { 1.5, 0, -10 }, Point3 { 1.5, 0, 0 } };
+    std::cout << "misses past the edge: " << !past.intersect(cube).has_value() << std::endl;
+
+    // A square mesh in the xy plane, rotated to stand in the yz plane
+    const Mesh square { { -1, 1, 1, -1 }, { -1, -1, 1, 1 }, { 0, 0, 0, 0 }, { 0, 1, 2, 0, 2, 3 } };
+    const Mesh turned = square.rotate(Quat::from_axis_angle(Vec3 { 0, 1, 0 }, pi / 2));
+    std::cout << turned << std::endl;
+    const Ray alongX { Point3 { -10, 0.2, 0.3 }, Point3 { 0, 0.2, 0.3 } };
+    if (const auto hit = alongX.intersect(turned)) {
+        std::cout << "hit rotated mesh at " << hit->first << ", normal " << hit->second
+                  << std::endl;
+    } else {
+        std::cout << "missed the rotated mesh" << std::endl;
+    }
+    std::cout << "the unrotated mesh is missed: " << !alongX.intersect(square).has_value()
+              << ", the vertices are shared: " << (turned.xs().data() == square.xs().data())
+              << std::endl;
+
+    // Rotations are kept in version 2 scene files, while version 1 files have none
+    const std::string textFilename = "/tmp/test_rotate.txt"s;
+    std::ofstream { textFilename } << "cube 0 0 0 2 2 2\nrotate 0 1 0 45\nsphere 0 0 5 1\n";
+    const std::string filename = "/tmp/test_rotate.scene"s;
+    write_scene_file(parse_scene_text(textFilename).view(), filename);
+    std::cout << "loaded: " << load_scene_file(filename);
+    std::ofstream { textFilename } << "cube 0 0 0 2 2 2\n";
+    write_scene_file(parse_scene_text(textFilename).view(), filename);
+    {
+        // Mark the file as version 1
+        std::fstream f { filename, std::ios::in | std::ios::out | std::ios::binary };
+        const uint32_t oldVersion = 1;
+        f.seekp(offsetof(scenefile::Header, version));
+        f.write(reinterpret_cast<const char*>(&oldVersion), sizeof oldVersion);
+    }
+    std::cout << "loaded version 1: " << load_scene_file(filename);
+}
+
 void TestSphere()
 {
     std::cout << std::boolalpha;
@@ -172,6 +287,145 @@ void TestPlane()
     std::cout << "Plane 1: "s << p1 << std::endl;
 }
 
+void TestTriangle()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Triangle ---"s << std::endl;
+
+    Triangle t1 { Point3 { 0, 0, 10 }, Point3 { 10, 0, 10 }, Point3 { 0, 10, 10 } };
+
+    std::cout << "Triangle 1: "s << t1 << std::endl;
+    std::cout << "Triangle 1 normal: "s << t1.normal() << std::endl;
+
+    Ray ray { Point3 { 1, 1, 0 }, Point3 { 1, 1, 1 } };
+    if (const auto maybeHit = ray.intersect(t1)) {
+        std::cout << "Ray hits triangle at " << maybeHit.value().first << std::endl;
+    } else {
+        std::cout << "Ray does not hit the triangle." << std::endl;
+    }
+}
+
+void TestMesh()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Mesh ---"s << std::endl;
+
+    // An octahedron with 6 shared vertices and 8 triangles
+    const Mesh mesh { { 0, 0, 0, 0, 10, -10 }, { 0, 0, 10, -10, 0, 0 }, { 10, -10, 0, 0, 0, 0 },
+        { 0, 4, 2, 0, 2, 5, 0, 5, 3, 0, 3, 4, 1, 2, 4, 1, 5, 2, 1, 3, 5, 1, 4, 3 } };
+
+    std::cout << mesh << std::endl;
+
+    // Compare the vectorized mesh test with testing each triangle on its own
+    int mismatches = 0;
+    for (int i = 0; i < 100; ++i) {
+        const Point3 from { -30, (i % 10) * 2.5 - 12.0, (i / 10) * 2.5 - 12.0 };
+        const Ray ray { from, Point3 { 30, (i % 7) - 3.0, (i % 5) - 2.0 } };
+        std::optional<double> closest;
+        for (size_t ti = 0; ti < mesh.triangle_count(); ++ti) {
+            if (const auto maybeHit = ray.intersect(mesh.triangle(ti))) {
+                const double depth = from.distance(maybeHit.value().first);
+                if (!closest || depth < *closest) {
+                    closest = depth;
+                }
+            }
+        }
+        const auto meshHit = ray.intersect(mesh);
+        if (closest.has_value() != meshHit.has_value()
+            || (closest && std::fabs(from.distance(meshHit.value().first) - *closest) > 1e-3)) {
+            ++mismatches;
+        }
+    }
+    std::cout << "Mesh and triangle intersections agree: " << (mismatches == 0) << std::endl;
+}
+
+void TestObjLoader()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- OBJ loader ---"s << std::endl;
+
+    // A quad, a triangle that uses negative indices and ends with a comment, and a few lines that
+    // should be ignored
+    const std::string filename = "/tmp/test.obj"s;
+    {
+        std::ofstream out(filename);
+        out << "# test\no quad\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0.5 0.5\n"s
+            << "vn 0 0 1\nf 1/1/1 2/1/1 3/1/1 4/1/1\n\nv 0 0 1.5e0\r\nf -1 -4 -3 # a comment\n"s;
+    }
+
+    const Mesh mesh = load_obj(filename);
+    std::cout << "Loaded: " << mesh << std::endl;
+    std::cout << "5 vertices and 3 triangles: "
+              << (mesh.vertex_count() == 5 && mesh.triangle_count() == 3) << std::endl;
+    std::cout << "Last triangle: " << mesh.triangle(2) << std::endl;
+}
+
+void TestSceneFile()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Scene file ---"s << std::endl;
+
+    // The demo scene, as it is set up in TestSDL2RayTrace
+    const Scene demo = demo_scene(495, 270).scene();
+
+    // Convert the text description of the demo scene, then map the scene file
+    const std::string filename = "/tmp/test.scene"s;
+    write_scene_file(parse_scene_text(SCENEDIR "demo.txt"s).view(), filename);
+    const Scene loaded = load_scene_file(filename);
+
+    std::cout << "Loaded scene:\n"s << loaded;
+    std::cout << "Same as the demo scene: " << (loaded.str() == demo.str()) << std::endl;
+
+    // A rotated mesh, which is stored as triangle blocks, and a sphere. The scene that uses the
+    // mapped file is traced the same as the scene from the text description.
+    const std::string objFilename = "/tmp/test_scenefile.obj"s;
+    std::ofstream { objFilename } << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n"s;
+    const std::string textFilename = "/tmp/test_scenefile.txt"s;
+    std::ofstream { textFilename } << "mesh "s << objFilename
+                                   << " 0 0 5 2\nrotate 0 1 0 30\nsphere 1 0 3 0.5\n"s;
+    const auto data = std::make_shared<const SceneData>(parse_scene_text(textFilename));
+    const std::string meshFilename = "/tmp/test_scenefile.scene"s;
+    write_scene_file(data->view(), meshFilename);
+    std::cout << "triangle blocks in the file: " << MappedScene { meshFilename }.view().blocks.size()
+              << std::endl;
+    const Scene fromText = make_scene(data->view(), data);
+    const Scene fromFile = load_scene_file(meshFilename);
+    int different = 0;
+    for (int y = -20; y <= 20; ++y) {
+        for (int x = -20; x <= 20; ++x) {
+            const Point3 fromPoint { 0, 0, -10 };
+            if (!(fromText.color(fromPoint, x * .1, y * .1)
+                    == fromFile.color(fromPoint, x * .1, y * .1))) {
+                ++different;
+            }
+        }
+    }
+    std::cout << "Mapped scene:\n"s << fromFile;
+    std::cout << "traced the same as from the text: " << (different == 0) << std::endl;
+
+    // Objects that are not finite, and rotations that are not unit quaternions, are rejected
+    const auto check = [](const SceneData& invalid) {
+        try {
+            invalid.view().validate();
+        } catch (const std::runtime_error& e) {
+            return std::string { e.what() };
+        }
+        return "accepted"s;
+    };
+    SceneData notFinite = *data;
+    notFinite.sphereX[0] = std::numeric_limits<double>::quiet_NaN();
+    std::cout << "NaN: " << check(notFinite) << std::endl;
+    notFinite.sphereX[0] = std::numeric_limits<double>::infinity();
+    std::cout << "infinity: " << check(notFinite) << std::endl;
+    SceneData scaled = *data;
+    scaled.meshQW[0] *= 2;
+    std::cout << "scaled rotation: " << check(scaled) << std::endl;
+}
+
 void TestRay()
 {
     std::cout << std::boolalpha;
@@ -203,12 +457,576 @@ void TestRay()
     }
 }
 
-auto TestSDL2RayTrace(const bool verbose) -> int
+void TestUpscaler()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Upscaler ---"s << std::endl;
+
+    // A red object to the left of a blue object at the same depth, upscaled 4x
+    const uint32_t src[2] = { 0xFFFF0000, 0xFF0000FF };
+    const float depth[2] = { 10, 10 };
+    const int32_t ids[2] = { 0, 1 };
+    uint32_t dst[8 * 4];
+
+    Upscaler upscaler;
+    upscaler.upscale(src, depth, ids, 2, 1, dst, 8, 4, 8 * sizeof(uint32_t));
+
+    // No pixel should be a blend of the two objects
+    bool crisp = true;
+    for (const auto pixel : dst) {
+        crisp = crisp && (pixel == src[0] || pixel == src[1]);
+    }
+    std::cout << "Upscaled edge is crisp: " << crisp << std::endl;
+}
+
+void TestResolutionController()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Resolution controller ---"s << std::endl;
+
+    // Simulate a scene that takes 40 ms to trace at full resolution, with a 10 ms budget
+    const double fullMs = 40.0;
+    ResolutionController resolution { 10.0, 0.125, 1.0, 1.0 };
+    int changes = 0;
+    for (int frame = 0; frame < 200; ++frame) {
+        const double scale = resolution.scale();
+        if (resolution.update(fullMs * scale * scale)) {
+            ++changes;
+        }
+    }
+    const double scale = resolution.scale();
+    std::cout << "Settled on scale " << scale << " after " << changes << " changes" << std::endl;
+    std::cout << "Within budget: " << (fullMs * scale * scale <= 10.0 * 1.15) << std::endl;
+}
+
+void TestMathPolicy()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Math policy ---"s << std::endl;
+
+    // The relative error of the fast reciprocal square root
+    double worst = 0;
+    for (double x = 1e-6; x < 1e12; x *= 1.01) {
+        const double exact = 1.0 / std::sqrt(x);
+        worst = std::max(worst, std::fabs(FastMath::rsqrt(x) - exact) / exact);
+    }
+    std::cout << "rsqrt relative error: " << worst << ", below 1e-5: " << (worst < 1e-5)
+              << std::endl;
+
+    const Vec3 v { 3, -4, 12 };
+    std::cout << "normalize: " << FastMath::normalize(v) << " " << ExactMath::normalize(v)
+              << std::endl;
+    std::cout << "distance: " << FastMath::distance(Point3 { 1, 2, 3 }, v) << " "
+              << ExactMath::distance(Point3 { 1, 2, 3 }, v) << ", to itself "
+              << FastMath::distance(v, v) << std::endl;
+
+    // Render the same image with both policies, and compare every color channel
+    const int W = 320;
+    const int H = 240;
+    const Scene scene = demo_scene(W, H).scene();
+    const Point3 fromPoint { 0, 0, -W * 2 };
+    double maxError = 0;
+    int differentPixels = 0;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const RGB exact = scene.color<ExactMath>(fromPoint, x, y).clamp255();
+            const RGB fast = scene.color<FastMath>(fromPoint, x, y).clamp255();
+            const double error = std::max({ std::fabs(exact.R() - fast.R()),
+                std::fabs(exact.G() - fast.G()), std::fabs(exact.B() - fast.B()) });
+            maxError = std::max(maxError, error);
+            if (error >= 0.5) {
+                ++differentPixels;
+            }
+        }
+    }
+    std::cout << "max image error: " << maxError << " of 255, within 1: " << (maxError <= 1.0)
+              << ", visibly different pixels: " << differentPixels << std::endl;
+}
+
+// demoCamera returns a camera that looks straight at the z=0 plane from a distance of W * 2,
+// and sees the area from (0, 0) to (W, H) of that plane
+auto demoCamera(int W, int H) -> Camera
+{
+    return Camera { Point3 { W * .5, H * .5, -W * 2.0 }, Quat::identity(),
+        2 * std::atan((H * .5) / (W * 2.0)) };
+}
+
+// traceFrame traces every pixel at the render resolution, using the given math policy, and
+// stores the colors, depths and object IDs for the upscaler. The frame must be culled and binned
+// for the same camera and resolution, and each tile of pixels only tests the objects of that tile.
+// The data of each tile is placed in the arena of the thread that traces it.
+//
+// The colors are shaded into the linear float colors of the frame first. Then, as passes of their
+// own, they are tone mapped as the mapping says, and packed into ARGB8888 pixels.
+template <typename Math>
+void traceFrame(const Scene& scene, const Camera& camera, Frame& frame, int rw, int rh,
+    uint32_t* colors, float* depths, int32_t* ids, const ToneMapping& toneMapping = {})
+{
+    const double aspect = static_cast<double>(rw) / rh;
+    const int tiles = frame.tilesX * frame.tilesY;
+    ColorBuffer& shaded = frame.colors;
+    shaded.resize(rw, rh);
+
+// Use OpenMP, with one tile at a time per thread
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tiles; ++t) {
+        const int tx = t % frame.tilesX;
+        const int ty = t / frame.tilesX;
+        const TileObjects objects = frame.tile(tx, ty);
+        const int x0 = tx * Frame::tileSize;
+        const int y0 = ty * Frame::tileSize;
+        const int x1 = std::min(x0 + Frame::tileSize, rw);
+        const int y1 = std::min(y0 + Frame::tileSize, rh);
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                double depth;
+                int id;
+                const Ray ray = camera.ray((x + 0.5) / rw, (y + 0.5) / rh, aspect);
+                const RGB c = scene.color<Math>(ray, objects, depth, id);
+                const int i = (y * rw) + x;
+                shaded.r[i] = static_cast<float>(c.R());
+                shaded.g[i] = static_cast<float>(c.G());
+                shaded.b[i] = static_cast<float>(c.B());
+                depths[i] = static_cast<float>(depth);
+                ids[i] = id;
+            }
+        }
+    }
+
+    shaded.toneMap(toneMapping);
+    shaded.pack(colors, toneMapping.gamma);
+}
+
+// loadScene loads a scene from a scene file, or from a text description if the filename ends
+// with .txt. Throws std::runtime_error if it can not be loaded.
+auto loadScene(const std::string& filename) -> Scene
+{
+    if (filename.ends_with(".txt"s)) {
+        const auto data = std::make_shared<const SceneData>(parse_scene_text(filename));
+        return make_scene(data->view(), data);
+    }
+    return load_scene_file(filename);
+}
+
+// cameraScene creates a scene with a grid of spheres that goes far outside of the view of the
+// demo camera, on every side
+auto cameraScene(int W, int H, int n) -> Scene
+{
+    const Sphere light { Vec3 { W * .5, 0, -100 }, 1 };
+    const Plane plane { Vec3 { 0, 0, 400 }, (Vec3 { 0, 0, -1 }).normalize() };
+    std::vector<Sphere> spheres;
+    spheres.reserve(static_cast<size_t>(n) * n);
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            spheres.emplace_back(Vec3 { W * .5 + (i - n / 2) * 12.0, H * .5 + (j - n / 2) * 12.0,
+                                     20.0 + (i + j) % 7 },
+                4.0, (i + j) % 2 ? Color::red : Color::blue);
+        }
+    }
+    const Cube cube { Vec3 { W * .5, H * .5, 60 }, 40 };
+    return Scene { light, plane, spheres, cube, Color::darkgray };
+}
+
+void TestCamera()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Camera ---"s << std::endl;
+
+    const Camera turned { Point3 { 0, 0, 0 },
+        Quat::from_axis_angle(Vec3 { 0, 1, 0 }, std::numbers::pi / 2), std::numbers::pi / 2 };
+    std::cout << turned << std::endl;
+    std::cout << "right: " << turned.right() << ", down: " << turned.down()
+              << ", forward: " << turned.forward() << std::endl;
+    std::cout << "center ray: " << turned.ray(0.5, 0.5, 1.0) << std::endl;
+    std::cout << "moved: " << turned.move(0, 0, 10).pos() << std::endl;
+
+    // The demo camera sees the z=0 plane from (0, 0) to (W, H), like the original projection
+    const int W = 320;
+    const int H = 240;
+    const Camera camera = demoCamera(W, H);
+    const Ray corner = camera.ray(0, 0, static_cast<double>(W) / H);
+    const Vec3 dir = corner.direction();
+    const Vec3 hit = camera.pos() + dir * (-camera.pos().z() / dir.z());
+    std::cout << "top left corner at z=0: " << hit << std::endl;
+
+    const Frustum frustum { camera, static_cast<double>(W) / H };
+    std::cout << "contains center: " << frustum.contains(Point3 { W * .5, H * .5, 0 }, 1)
+              << ", behind: " << frustum.contains(Point3 { W * .5, H * .5, -W * 3.0 }, 1)
+              << ", far left: " << frustum.contains(Point3 { -W * 1.0, H * .5, 0 }, 1)
+              << ", touching the left side: "
+              << frustum.contains(Point3 { -10, H * .5, 0 }, 20) << std::endl;
+
+    // Rendering only the culled objects, or only the objects of each tile, gives the same image
+    // as rendering all of them. The second camera is inside of the grid, turned to look along it,
+    // with spheres behind it and spheres that reach the plane that it is in.
+    const Scene scene = cameraScene(W, H, 60);
+    const Camera cameras[] = { camera,
+        Camera { Point3 { W * .3, H * .5 + 6, 23.0 },
+            Quat::from_axis_angle(Vec3 { 0, 1, 0 }, 1.45), camera.fov() } };
+    Frame frame;
+    for (const auto& cam : cameras) {
+        scene.cull(cam, static_cast<double>(W) / H, frame);
+        scene.bin(cam, W, H, frame);
+        std::cout << "visible: " << frame.sphere_count() << " of " << scene.sphere_count()
+                  << " spheres, " << frame.cube_count() << " cubes, "
+                  << frame.tileSpheres.items.size() << " spheres in " << frame.tilesX << "x"
+                  << frame.tilesY << " tiles" << std::endl;
+        int culledDifferent = 0;
+        int binnedDifferent = 0;
+        for (int t = 0; t < frame.tilesX * frame.tilesY; ++t) {
+            const TileObjects tile = frame.tile(t % frame.tilesX, t / frame.tilesX);
+            const int x0 = (t % frame.tilesX) * Frame::tileSize;
+            const int y0 = (t / frame.tilesX) * Frame::tileSize;
+            for (int i = 0; i < Frame::tileSize * Frame::tileSize; ++i) {
+                const int x = x0 + i % Frame::tileSize;
+                const int y = y0 + i / Frame::tileSize;
+                if (x >= W || y >= H) {
+                    continue;
+                }
+                const Ray ray = cam.ray((x + 0.5) / W, (y + 0.5) / H, static_cast<double>(W) / H);
+                double depthAll, depthCulled, depthBinned;
+                int idAll, idCulled, idBinned;
+                const RGB all = scene.color(ray, depthAll, idAll);
+                const RGB culled = scene.color(ray, frame, depthCulled, idCulled);
+                const RGB binned = scene.color(ray, tile, depthBinned, idBinned);
+                if (idAll != idCulled || depthAll != depthCulled || all.R() != culled.R()
+                    || all.G() != culled.G() || all.B() != culled.B()) {
+                    ++culledDifferent;
+                }
+                if (idAll != idBinned || depthAll != depthBinned || all.R() != binned.R()
+                    || all.G() != binned.G() || all.B() != binned.B()) {
+                    ++binnedDifferent;
+                }
+            }
+        }
+        std::cout << "culled image is the same: " << (culledDifferent == 0)
+                  << ", binned image is the same: " << (binnedDifferent == 0) << std::endl;
+    }
+}
+
+void TestDemoScene()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Demo scene ---"s << std::endl;
+
+    // The demo scene, and the data that its static scene calculates from it, exists at compile
+    // time
+    constexpr DemoScene demo = demo_scene(495, 270);
+    constexpr auto fixed = demo.static_scene();
+    static_assert(demo.spheres[1].x() == 247.5);
+    static_assert(fixed.bounds().min.x() == 198 - 50 && fixed.bounds().max.x() == 346.5 + 75);
+    static_assert(fixed.terms()[1].x == 0 && fixed.terms()[1].c == 1040 * 1040 - 50 * 50);
+    static_assert((Color::white * .5).clamp255() == RGB { 127.5, 127.5, 127.5 });
+    static_assert(Quat::identity().rotate(Vec3 { 1, 2, 3 }) == Vec3 { 1, 2, 3 });
+
+    std::cout << "bounds: " << fixed.bounds().min << " - " << fixed.bounds().max << std::endl;
+
+    // The terms are the same as the ones that cull calculates for the demo camera
+    const Scene scene = demo.scene();
+    Frame frame;
+    scene.cull(demoCamera(495, 270), 495.0 / 270.0, frame);
+    bool same = frame.sphere_count() == fixed.terms().size();
+    for (size_t k = 0; k < frame.sphere_count(); ++k) {
+        const auto& a = frame.sphereTerms[frame.sphere(k)];
+        const auto& b = fixed.terms()[frame.sphere(k)];
+        same = same && a.x == b.x && a.y == b.y && a.z == b.z && a.c == b.c;
+    }
+    std::cout << "sphere terms are the same as from cull: " << same << std::endl;
+}
+
+void TestStaticScene()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Static scene ---"s << std::endl;
+
+    // Render the demo scene as a Scene and as a StaticScene, and compare every pixel
+    const int W = 320;
+    const int H = 240;
+    constexpr DemoScene demo = demo_scene(W, H);
+    constexpr auto fixed = demo.static_scene();
+    static_assert(fixed.sphere_count() == 3 && fixed.plane_count() == 1 && fixed.cube_count() == 1);
+    const Scene scene = demo.scene();
+    double maxError = 0;
+    int differentIDs = 0;
+    // From the view point, the static scene uses its precomputed sphere terms, and from the other
+    // point, it calculates them
+    for (const Point3 fromPoint : { demo.viewPoint, Point3 { 0, 0, -W * 2 } }) {
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                double depthDynamic, depthStatic;
+                int idDynamic, idStatic;
+                const RGB a = scene.color(fromPoint, x, y, depthDynamic, idDynamic);
+                const RGB b = fixed.color(fromPoint, x, y, depthStatic, idStatic);
+                maxError = std::max({ maxError, std::fabs(a.R() - b.R()),
+                    std::fabs(a.G() - b.G()), std::fabs(a.B() - b.B()) });
+                if (idDynamic != idStatic) {
+                    ++differentIDs;
+                }
+            }
+        }
+    }
+    std::cout << "max image error: " << maxError << " of 255, below 1e-6: " << (maxError < 1e-6)
+              << ", different object IDs: " << differentIDs << std::endl;
+}
+
+// forEachSimdLevel selects each level that the CPU supports, starting with the scalar kernels, and
+// calls fn with it. Afterwards, the level that was used before is selected again.
+template <typename F>
+void forEachSimdLevel(F fn)
+{
+    const SimdLevel detected = simd_level();
+    for (const auto level :
+        { SimdLevel::SCALAR, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512 }) {
+        if (simd_select(level)) {
+            fn(level);
+        }
+    }
+    simd_select(detected);
+}
+
+// randomBits returns count numbers from a linear congruential generator, which is random enough
+// for filling test data, and gives the same numbers for the same seed every time
+auto randomBits(size_t count, uint32_t seed) -> std::vector<uint32_t>
+{
+    std::vector<uint32_t> numbers(count);
+    for (auto& n : numbers) {
+        seed = seed * 1664525 + 1013904223;
+        n = seed;
+    }
+    return numbers;
+}
+
+// randomPlane returns count floats from low up to high, for filling a plane of a color buffer
+auto randomPlane(size_t count, uint32_t seed, float low, float high) -> std::vector<float>
+{
+    std::vector<float> plane(count);
+    const std::vector<uint32_t> bits = randomBits(count, seed);
+    for (size_t i = 0; i < count; ++i) {
+        plane[i] = low + (high - low) * static_cast<float>(bits[i] >> 8) / (1 << 24);
+    }
+    return plane;
+}
+
+void TestSimd()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- SIMD ---"s << std::endl;
+
+    std::cout << "detected: " << simd_name(simd_detect()) << std::endl;
+
+    // Every level that the CPU supports renders the same image as the scalar kernel, bit for bit,
+    // for the demo camera and for a camera inside of the grid of spheres
+    const int W = 320;
+    const int H = 240;
+    const Scene scene = cameraScene(W, H, 60);
+    const Camera camera = demoCamera(W, H);
+    const Camera cameras[] = { camera,
+        Camera { Point3 { W * .3, H * .5 + 6, 23.0 },
+            Quat::from_axis_angle(Vec3 { 0, 1, 0 }, 1.45), camera.fov() } };
+    Frame frame;
+    for (const auto& cam : cameras) {
+        scene.cull(cam, static_cast<double>(W) / H, frame);
+        scene.bin(cam, W, H, frame);
+        std::vector<uint32_t> colors[2] = { std::vector<uint32_t>(W * H),
+            std::vector<uint32_t>(W * H) };
+        std::vector<float> depths[2] = { std::vector<float>(W * H), std::vector<float>(W * H) };
+        std::vector<int32_t> ids[2] = { std::vector<int32_t>(W * H), std::vector<int32_t>(W * H) };
+        forEachSimdLevel([&](const SimdLevel level) {
+            const int k = level == SimdLevel::SCALAR ? 0 : 1;
+            traceFrame<ExactMath>(scene, cam, frame, W, H, colors[k].data(), depths[k].data(),
+                ids[k].data());
+            if (k == 1) {
+                std::cout << simd_name(level) << " is the same as scalar: "
+                          << (colors[0] == colors[1] && depths[0] == depths[1]
+                                 && ids[0] == ids[1])
+                          << std::endl;
+            }
+        });
+    }
+}
+
+void TestColorBuffer()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Color buffer ---"s << std::endl;
+
+    // Red, green and blue end up in bits 16..23, 8..15 and 0..7, and colors outside of 0..255 are
+    // clamped, including NaN, which becomes 0
+    ColorBuffer colors;
+    colors.resize(5, 1);
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float values[5][3]
+        = { { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 }, { -10, 300, 127.9f }, { nan, 1, 2 } };
+    for (int i = 0; i < 5; ++i) {
+        colors.r[i] = values[i][0];
+        colors.g[i] = values[i][1];
+        colors.b[i] = values[i][2];
+    }
+    uint32_t argb[5];
+    colors.pack(argb);
+    std::cout << std::hex << argb[0] << " " << argb[1] << " " << argb[2] << " " << argb[3] << " "
+              << argb[4] << std::dec
+              << " (expected ffff0000 ff00ff00 ff0000ff ff00ff7f ff000102)" << std::endl;
+    colors.pack(argb, true);
+    std::cout << "sRGB: " << std::hex << argb[3] << std::dec << " (expected ff00ffbc), table: "
+              << srgb_lut()[0] << " " << srgb_lut()[gammaLutSize / 2] << " "
+              << srgb_lut()[gammaLutSize - 1] << " (expected 0 188 255)" << std::endl;
+
+    // Every level packs the same pixels as the scalar version, with and without the table, also
+    // for the pixels at the end that do not fill a whole register
+    const size_t count = 1000 + 13;
+    const std::vector<float> planes[3] = { randomPlane(count, 4321, -50, 350),
+        randomPlane(count, 4322, -50, 350), randomPlane(count, 4323, -50, 350) };
+    for (const uint32_t* lut : { static_cast<const uint32_t*>(nullptr), srgb_lut() }) {
+        std::vector<uint32_t> packed[2]
+            = { std::vector<uint32_t>(count), std::vector<uint32_t>(count) };
+        forEachSimdLevel([&](const SimdLevel level) {
+            const int k = level == SimdLevel::SCALAR ? 0 : 1;
+            pack_argb(planes[0].data(), planes[1].data(), planes[2].data(), count, lut,
+                packed[k].data());
+            if (k == 1) {
+                std::cout << simd_name(level) << (lut ? " with sRGB" : "")
+                          << " is the same as scalar: " << (packed[0] == packed[1]) << std::endl;
+            }
+        });
+    }
+}
+
+void TestToneMap()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Tone mapping ---"s << std::endl;
+
+    // A sphere that is much brighter than white stays that way until it is tone mapped
+    const std::string filename = "/tmp/spheremover_hdr.txt"s;
+    std::ofstream { filename } << "background 0 0 0\n"s
+                               << "material lamp 4000 4000 4000\n"s
+                               << "light 0 0 50 1\n"s
+                               << "sphere 247.5 135 50 50 lamp\n"s;
+    const Scene scene = loadScene(filename);
+    const RGB bright = scene.color(Point3 { 247.5, 135, -990 }, 247.5, 135);
+    std::cout << "brighter than white: " << (bright.R() > 255 * 4) << std::endl;
+
+    // The curves, for black, white, ten times white, a negative color and NaN
+    ColorBuffer colors;
+    colors.resize(5, 1);
+    const float values[5] = { 0, 255, 2550, -10, std::numeric_limits<float>::quiet_NaN() };
+    for (const auto curve : { ToneMap::LINEAR, ToneMap::REINHARD, ToneMap::ACES }) {
+        std::copy(values, values + 5, colors.r.begin());
+        std::copy(values, values + 5, colors.g.begin());
+        std::copy(values, values + 5, colors.b.begin());
+        ToneMapping mapping;
+        mapping.curve = curve;
+        mapping.exposure = curve == ToneMap::LINEAR ? -1 : 0;
+        const float exposure = colors.toneMap(mapping);
+        std::cout << tone_map_name(curve) << ", exposure " << exposure << ":";
+        for (const float c : colors.r) {
+            std::cout << " " << c;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "(expected 0 127.5 1275 0 0, 0 127.5 231.818 0 0 and 0 204.968 257.314 0 0)"
+              << std::endl;
+
+    // The default mapping does not touch the colors
+    std::copy(values, values + 5, colors.r.begin());
+    std::cout << "the default mapping changes nothing: "
+              << (colors.toneMap(ToneMapping {}) == 1.0f && colors.r[3] == -10) << std::endl;
+
+    // Every level maps the colors like the scalar version, bit for bit
+    const size_t count = 1000 + 13;
+    const std::vector<float> input = randomPlane(count, 1234, -100, 4900);
+    for (const auto curve : { ToneMap::LINEAR, ToneMap::REINHARD, ToneMap::ACES }) {
+        std::vector<float> expected;
+        forEachSimdLevel([&](const SimdLevel level) {
+            std::vector<float> mapped = input;
+            tone_map(mapped.data(), count, curve, 1.5f);
+            if (level == SimdLevel::SCALAR) {
+                expected = mapped;
+                return;
+            }
+            std::cout << simd_name(level) << " " << tone_map_name(curve)
+                      << " is the same as scalar: " << (mapped == expected) << std::endl;
+        });
+    }
+
+    // Auto exposure brings a frame that is four times brighter than middle gray down by about
+    // two stops, give or take half a bin, and leaves a black frame alone
+    colors.resize(64, 64);
+    std::fill(colors.r.begin(), colors.r.end(), 255 * 0.72f);
+    std::fill(colors.g.begin(), colors.g.end(), 255 * 0.72f);
+    std::fill(colors.b.begin(), colors.b.end(), 255 * 0.72f);
+    const double stops = std::log2(colors.autoExposure());
+    std::cout << "auto exposure: " << stops
+              << " stops, about -2: " << (std::fabs(stops + 2) < 0.125) << std::endl;
+    std::fill(colors.r.begin(), colors.r.end(), 0.0f);
+    std::fill(colors.g.begin(), colors.g.end(), 0.0f);
+    std::fill(colors.b.begin(), colors.b.end(), 0.0f);
+    std::cout << "auto exposure of a black frame: " << colors.autoExposure() << " (expected 1)"
+              << std::endl;
+
+    // Traced with Reinhard and auto exposure, the bright sphere keeps some of its shading,
+    // instead of being white all over
+    const Camera camera = demoCamera(495, 270);
+    Frame frame;
+    const int w = 64;
+    const int h = 36;
+    std::vector<uint32_t> pixels[2]
+        = { std::vector<uint32_t>(w * h), std::vector<uint32_t>(w * h) };
+    std::vector<float> depths(w * h);
+    std::vector<int32_t> ids(w * h);
+    scene.cull(camera, static_cast<double>(w) / h, frame);
+    scene.bin(camera, w, h, frame);
+    ToneMapping reinhard;
+    reinhard.curve = ToneMap::REINHARD;
+    reinhard.autoExposure = true;
+    for (int k = 0; k < 2; ++k) {
+        traceFrame<ExactMath>(scene, camera, frame, w, h, pixels[k].data(), depths.data(),
+            ids.data(), k == 0 ? ToneMapping {} : reinhard);
+    }
+    const auto shades = [&](const std::vector<uint32_t>& image) {
+        std::vector<uint32_t> sphere;
+        for (size_t i = 0; i < image.size(); ++i) {
+            if (ids[i] == 0) {
+                sphere.push_back(image[i]);
+            }
+        }
+        std::sort(sphere.begin(), sphere.end());
+        return std::unique(sphere.begin(), sphere.end()) - sphere.begin();
+    };
+    std::cout << "shades of the sphere, clamped: " << shades(pixels[0])
+              << " (expected 1), tone mapped: more than 1: " << (shades(pixels[1]) > 1)
+              << std::endl;
+}
+
+auto TestSDL2RayTrace(const bool verbose, const Options& options) -> int
 {
 
     using std::cerr;
     using std::endl;
 
+    // Open the video stream first, so that nothing else is printed to it if it is standard output
+    std::unique_ptr<Y4MWriter> video;
+    if (!options.y4m.empty()) {
+        try {
+            video = std::make_unique<Y4MWriter>(options.y4m, options.width, options.height, 60);
+        } catch (const std::runtime_error& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+    Upscaler videoUpscaler;
+    std::vector<uint32_t> videoBuffer(static_cast<size_t>(options.width) * options.height);
+
     auto sys = sdl2::make_sdlsystem(SDL_INIT_EVERYTHING);
     if (!sys) {
         cerr << "Error creating SDL2 system: " << SDL_GetError() << endl;
@@ -218,7 +1036,7 @@ auto TestSDL2RayTrace(const bool verbose) -> int
     // Select if fullscreen should be default here
     bool fullscreen = false;
 
-    // This is the resolution of what's drawn in the window, regardless of the window resolution
+    // This is the resolution the scene is defined in, regardless of the window resolution
     const int W = 495;
     const int H = 270;
 
@@ -251,30 +1069,110 @@ auto TestSDL2RayTrace(const bool verbose) -> int
         return 1;
     }
 
-    auto tex = sdl2::make_buffer_texture(ren.get(), W, H);
-    if (!tex) {
-        cerr << "Error creating texture: " << SDL_GetError() << endl;
-        return 1;
+    // The window resolution, and the internal render resolution, which starts out as the window
+    // resolution divided by the upscale ratio. If the ratio is 1, every window pixel is traced.
+    int outw = 0;
+    int outh = 0;
+    int rw = 0;
+    int rh = 0;
+
+    // The traced pixels, with the depth and object ID of each pixel, for the upscaler
+    std::vector<uint32_t> textureBuffer;
+    std::vector<float> depthBuffer;
+    std::vector<int32_t> idBuffer;
+
+    Upscaler upscaler;
+
+    // Adjusts the render resolution to the frame time budget, if a target is given
+    const bool dynamicResolution = options.targetMs > 0;
+    ResolutionController resolution { options.targetMs, options.minScale, options.maxScale,
+        1.0 / options.upscale };
+
+    sdl2::texture_ptr_t tex { nullptr, SDL_DestroyTexture };
+
+    // Create a scene pointer, starting with the demo scene that is defined at compile time
+    constexpr DemoScene demo = demo_scene(W, H);
+    std::unique_ptr<Scene> scene_ptr = std::make_unique<Scene>(demo.scene());
+
+    // Or load the scene from a file
+    if (!options.scene.empty()) {
+        try {
+            const auto loadStart = std::chrono::steady_clock::now();
+            scene_ptr = std::make_unique<Scene>(loadScene(options.scene));
+            const std::chrono::duration<double, std::milli> loadTime
+                = std::chrono::steady_clock::now() - loadStart;
+            if (verbose) {
+                std::cout << "loaded " << options.scene << " in " << loadTime.count() << " ms"
+                          << std::endl;
+            }
+        } catch (const std::runtime_error& e) {
+            cerr << "Error loading scene: " << e.what() << endl;
+            return 1;
+        }
     }
 
-    uint32_t* textureBuffer = new uint32_t[W * H];
-
-    const Sphere light { Vec3 { 0, 0, 50 }, 1 };
-    const Plane plane { Vec3 { 0, 0, 100 }, (Vec3 { 0, 0, 0.5 }).normalize() };
-
-    const Sphere sphere1 { Vec3 { W * .4, H * .5, 50 }, 50 };
-    const Sphere sphere2 { Vec3 { W * .5, H * .5, 50 }, 50 };
-    const Sphere sphere3 { Vec3 { W * .6, H * .5, 50 }, 50 };
-    const Cube cube1 { Vec3 { W * .7, H * .5, 50 }, 50 };
-
-    std::vector<Sphere> spheres = { sphere1, sphere2, sphere3 };
+    // Add the meshes given on the command line, to the left of the spheres
+    for (const auto& filename : options.meshes) {
+        try {
+            const auto loadStart = std::chrono::steady_clock::now();
+            const Mesh mesh = load_obj(filename);
+            const std::chrono::duration<double, std::milli> loadTime
+                = std::chrono::steady_clock::now() - loadStart;
+            if (verbose) {
+                std::cout << "loaded " << filename << " in " << loadTime.count() << " ms: " << mesh
+                          << std::endl;
+            }
+            const auto fitted
+                = std::make_shared<const Mesh>(mesh.fit(Vec3 { W * .2, H * .5, 50 }, 100));
+            scene_ptr = std::make_unique<Scene>(scene_ptr->mesh_add(fitted));
+        } catch (const std::runtime_error& e) {
+            cerr << "Error loading mesh: " << e.what() << endl;
+            return 1;
+        }
+    }
 
-    // Create a scene and a scene pointer
-    Scene scene1 { light, plane, spheres, cube1, Color::darkgray };
-    std::unique_ptr<Scene> scene_ptr = std::make_unique<Scene>(scene1);
+    // Compile the animation scripts, if there are any. The scripts can use the frame number and
+    // the time in seconds, and change the scene through the scene builtins, which record the
+    // changes in a command buffer. The keys and the controller record their changes in the same
+    // buffer. The watcher compiles the scripts again in the background when they are saved.
+    CommandBuffer commands;
+    Builtins builtins;
+    add_standard_builtins(builtins);
+    add_scene_builtins(builtins, scene_ptr, commands);
+    builtins.variable("frame");
+    builtins.variable("time");
+    std::unique_ptr<ScriptWatcher> watcher;
+    std::vector<std::unique_ptr<VM>> vms;
+    std::vector<bool> stopped; // scripts that failed, and are not run again until they are saved
+    if (!options.scripts.empty()) {
+        try {
+            watcher = std::make_unique<ScriptWatcher>(builtins, options.scripts);
+        } catch (const std::runtime_error& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        for (size_t i = 0; i < watcher->size(); ++i) {
+            vms.push_back(std::make_unique<VM>(builtins, watcher->take(i)));
+        }
+        stopped.assign(vms.size(), false);
+    }
 
-    // Create a camera point
-    const Point3 fromPoint { 0, 0, -W * 2 };
+    // The camera starts out looking straight at the scene. It is turned with the right stick, or
+    // by dragging with the mouse, and moved forward and back with the mouse wheel.
+    const Camera startCamera = demoCamera(W, H);
+    double cameraX = startCamera.pos().x(); // Point3 is constant, so the parts are kept instead
+    double cameraY = startCamera.pos().y();
+    double cameraZ = startCamera.pos().z();
+    double cameraYaw = 0;
+    double cameraPitch = 0;
+    const auto cameraOrientation = [&] {
+        // Turn around the y axis, and then up or down
+        return Quat::from_axis_angle(Vec3 { 0, 1, 0 }, cameraYaw)
+            * Quat::from_axis_angle(Vec3 { 1, 0, 0 }, cameraPitch);
+    };
+
+    // The objects that can be seen, prepared once per frame
+    Frame frame;
 
     // Select a sphere by switching between them with the Tab key
     size_t currentSphere = 0;
@@ -302,6 +1200,7 @@ auto TestSDL2RayTrace(const bool verbose) -> int
     }
 
     std::cout << "arrow keys and tab to move spheres around" << std::endl;
+    std::cout << "drag with the mouse or use the right stick to look around" << std::endl;
     std::cout << "esc or q to quit" << std::endl;
     std::cout << "f to toggle fullscreen" << std::endl;
 
@@ -351,26 +1250,39 @@ auto TestSDL2RayTrace(const bool verbose) -> int
                         } else if (event.jaxis.value > JOYSTICK_DEAD_ZONE) {
                             joy_left_offset_y = event.jaxis.value / 32767.0;
                         }
-                    } else if (event.jaxis.axis == 3) { // right X, 8-direction
+                    } else if (event.jaxis.axis == 3) { // right X, smooth
                         joy_right_offset_x = 0;
                         if (event.jaxis.value < -JOYSTICK_DEAD_ZONE) {
-                            joy_right_offset_x = -1;
+                            joy_right_offset_x = event.jaxis.value / 32768.0;
                         } else if (event.jaxis.value > JOYSTICK_DEAD_ZONE) {
-                            joy_right_offset_x = 1;
+                            joy_right_offset_x = event.jaxis.value / 32767.0;
                         }
-                    } else if (event.jaxis.axis == 4) { // right Y, 8-direction
+                    } else if (event.jaxis.axis == 4) { // right Y, smooth
                         joy_right_offset_y = 0;
                         if (event.jaxis.value < -JOYSTICK_DEAD_ZONE) {
-                            joy_right_offset_y = -1;
+                            joy_right_offset_y = event.jaxis.value / 32768.0;
                         } else if (event.jaxis.value > JOYSTICK_DEAD_ZONE) {
-                            joy_right_offset_y = 1;
+                            joy_right_offset_y = event.jaxis.value / 32767.0;
                         }
                     }
                 }
                 break;
+            case SDL_MOUSEMOTION: // Dragging with the left mouse button turns the camera
+                if (event.motion.state & SDL_BUTTON_LMASK) {
+                    cameraYaw += event.motion.xrel * 0.003;
+                    cameraPitch -= event.motion.yrel * 0.003;
+                }
+                break;
+            case SDL_MOUSEWHEEL: { // The mouse wheel moves the camera forward and back
+                const Vec3 offset
+                    = cameraOrientation().rotate(Vec3 { 0, 0, 1 }) * (event.wheel.y * 20.0);
+                cameraX += offset.x();
+                cameraY += offset.y();
+                cameraZ += offset.z();
+            } break;
             case SDL_JOYBUTTONUP: // If a joystick button is released, select the next sphere
                 currentSphere++;
-                if (currentSphere >= spheres.size()) {
+                if (currentSphere >= scene_ptr->sphere_count()) {
                     currentSphere = 0;
                 }
                 break;
@@ -380,7 +1292,7 @@ auto TestSDL2RayTrace(const bool verbose) -> int
                 case SDLK_TAB: {
                     // std::cout << "Tab" << std::endl;
                     currentSphere++;
-                    if (currentSphere >= spheres.size()) {
+                    if (currentSphere >= scene_ptr->sphere_count()) {
                         currentSphere = 0;
                     }
                     // std::cout << "current sphere is now " << currentSphere << std::endl;
@@ -389,29 +1301,25 @@ auto TestSDL2RayTrace(const bool verbose) -> int
                 case SDLK_d:
                 case SDLK_RIGHT: {
                     // std::cout << "Right" << std::endl;
-                    const auto newScene = scene_ptr->sphere_move(currentSphere, Vec3 { 1, 0, 0 });
-                    scene_ptr = std::make_unique<Scene>(newScene);
+                    commands.move(currentSphere, 1, Vec3 { 1, 0, 0 });
                     break;
                 }
                 case SDLK_a:
                 case SDLK_LEFT: {
                     // std::cout << "Left" << std::endl;
-                    const auto newScene = scene_ptr->sphere_move(currentSphere, Vec3 { -1, 0, 0 });
-                    scene_ptr = std::make_unique<Scene>(newScene);
+                    commands.move(currentSphere, 1, Vec3 { -1, 0, 0 });
                     break;
                 }
                 case SDLK_w:
                 case SDLK_UP: {
                     // std::cout << "Up" << std::endl;
-                    const auto newScene = scene_ptr->sphere_move(currentSphere, Vec3 { 0, -1, 0 });
-                    scene_ptr = std::make_unique<Scene>(newScene);
+                    commands.move(currentSphere, 1, Vec3 { 0, -1, 0 });
                     break;
                 }
                 case SDLK_s:
                 case SDLK_DOWN: {
                     // std::cout << "Down" << std::endl;
-                    const auto newScene = scene_ptr->sphere_move(currentSphere, Vec3 { 0, 1, 0 });
-                    scene_ptr = std::make_unique<Scene>(newScene);
+                    commands.move(currentSphere, 1, Vec3 { 0, 1, 0 });
                     break;
                 }
                 case SDLK_f:
@@ -437,51 +1345,129 @@ auto TestSDL2RayTrace(const bool verbose) -> int
 
         // Left thumbstick moves the current sphere
         if (joy_left_offset_x != 0 || joy_left_offset_y != 0) {
-            const auto newScene = scene_ptr->sphere_move(
-                currentSphere, Vec3 { joy_left_offset_x, joy_left_offset_y, 0 });
-            scene_ptr = std::make_unique<Scene>(newScene);
+            commands.move(currentSphere, 1, Vec3 { joy_left_offset_x, joy_left_offset_y, 0 });
             // std::cout << "moved sphere " << currentSphere << std::endl;
         }
 
-        // Right thumbstick moves the next sphere
+        // Right thumbstick turns the camera
         if (joy_right_offset_x != 0 || joy_right_offset_y != 0) {
-            currentSphere++;
-            if (currentSphere >= spheres.size()) {
-                currentSphere = 0;
+            cameraYaw += joy_right_offset_x * 0.02;
+            cameraPitch -= joy_right_offset_y * 0.02;
+        }
+        cameraPitch = std::clamp(cameraPitch, -1.5, 1.5);
+
+        // Let the scripts animate the scene
+        for (size_t i = 0; i < vms.size(); ++i) {
+            // Switch to the newest version of the script, if it has been changed
+            if (auto code = watcher->take(i)) {
+                vms[i]->load(std::move(code));
+                stopped[i] = false;
+                if (verbose) {
+                    std::cout << "reloaded " << options.scripts[i] << std::endl;
+                }
             }
-            const auto newScene = scene_ptr->sphere_move(
-                currentSphere, Vec3 { joy_right_offset_x, joy_right_offset_y, 0 });
-            scene_ptr = std::make_unique<Scene>(newScene);
-            // std::cout << "moved sphere " << currentSphere << std::endl;
-
-            // NOTE: currentSphere must always be > 0, it's not an int
-            if (currentSphere > 0) {
-                currentSphere--;
-            } else {
-                currentSphere = spheres.size() - 1;
+            if (stopped[i]) {
+                continue;
+            }
+            vms[i]->set("frame", countedFrames);
+            vms[i]->set("time", fpsTimer.getTicks() / 1000.0);
+            try {
+                vms[i]->run();
+            } catch (const std::runtime_error& e) {
+                cerr << "Error in " << options.scripts[i] << ": " << e.what() << endl;
+                stopped[i] = true;
             }
         }
 
+        // Apply everything the keys, the controller and the scripts did to the scene, all at
+        // once, without creating a new scene
+        if (!commands.empty()) {
+            scene_ptr->update(commands);
+            commands.clear();
+        }
+
         double avgFPS = countedFrames / (fpsTimer.getTicks() / 1000.0);
         if (avgFPS > 2000000) {
             avgFPS = 0;
         }
 
-// Use OpenMP
-#pragma omp parallel for
-        for (int y = 0; y < H; ++y) {
-            for (int x = 0; x < W; ++x) {
-                // if (x % 2 != 0) {
-                //    textureBuffer[(y * W) + x] = textureBuffer[(y * W) + x - 1];
-                //} else {
-                const RGB c = scene_ptr->color(fromPoint, x, y).clamp255();
-                textureBuffer[(y * W) + x] = 0xFF000000 | (static_cast<uint8_t>(c.R()) << 16)
-                    | (static_cast<uint8_t>(c.B()) << 8) | static_cast<uint8_t>(c.G());
-                //}
+        // Recreate the window-sized texture if the window resolution has changed
+        int neww = outw;
+        int newh = outh;
+        if (SDL_GetRendererOutputSize(ren.get(), &neww, &newh) != 0) {
+            cerr << "Error getting the renderer output size: " << SDL_GetError() << endl;
+            return 1;
+        }
+        if (neww != outw || newh != outh || !tex) {
+            outw = neww;
+            outh = newh;
+            tex = sdl2::make_buffer_texture(ren.get(), outw, outh);
+            if (!tex) {
+                cerr << "Error creating texture: " << SDL_GetError() << endl;
+                return 1;
+            }
+        }
+
+        // Reallocate the render buffers if the render resolution has changed
+        const double scale = dynamicResolution ? resolution.scale() : 1.0 / options.upscale;
+        const int renderw = std::max(1, static_cast<int>(outw * scale + 0.5));
+        const int renderh = std::max(1, static_cast<int>(outh * scale + 0.5));
+        if (renderw != rw || renderh != rh) {
+            rw = renderw;
+            rh = renderh;
+            textureBuffer.assign(rw * rh, 0);
+            depthBuffer.assign(rw * rh, 0);
+            idBuffer.assign(rw * rh, 0);
+            if (verbose && dynamicResolution) {
+                std::cout << "render resolution: " << rw << "x" << rh << std::endl;
             }
         }
 
-        SDL_UpdateTexture(tex.get(), nullptr, textureBuffer, W * sizeof(uint32_t));
+        const Camera camera { Point3 { cameraX, cameraY, cameraZ }, cameraOrientation(),
+            startCamera.fov() };
+
+        const auto traceStart = std::chrono::steady_clock::now();
+
+        // Only the objects that can be seen are tested for each pixel
+        scene_ptr->cull(camera, static_cast<double>(rw) / rh, frame);
+        scene_ptr->bin(camera, rw, rh, frame);
+
+        // The preview uses fast square roots, unless exact math has been asked for
+        if (options.exactMath) {
+            traceFrame<ExactMath>(*scene_ptr, camera, frame, rw, rh, textureBuffer.data(),
+                depthBuffer.data(), idBuffer.data(), options.toneMapping);
+        } else {
+            traceFrame<FastMath>(*scene_ptr, camera, frame, rw, rh, textureBuffer.data(),
+                depthBuffer.data(), idBuffer.data(), options.toneMapping);
+        }
+
+        const std::chrono::duration<double, std::milli> traceTime
+            = std::chrono::steady_clock::now() - traceStart;
+        if (dynamicResolution) {
+            resolution.update(traceTime.count());
+        }
+
+        // Stream the frame at the size of the video. The loop never waits for the pipe, so if
+        // the reader can not keep up, frames are dropped instead, before they are upscaled.
+        if (video && video->ready()) {
+            videoUpscaler.upscale(textureBuffer.data(), depthBuffer.data(), idBuffer.data(), rw, rh,
+                videoBuffer.data(), video->width(), video->height(),
+                video->width() * static_cast<int>(sizeof(uint32_t)));
+            video->write(videoBuffer.data(), false);
+        }
+
+        if (rw != outw || rh != outh) {
+            // Upscale straight into the window-sized streaming texture
+            void* pixels;
+            int pitch;
+            if (SDL_LockTexture(tex.get(), nullptr, &pixels, &pitch) == 0) {
+                upscaler.upscale(textureBuffer.data(), depthBuffer.data(), idBuffer.data(), rw,
+                    rh, static_cast<uint32_t*>(pixels), outw, outh, pitch);
+                SDL_UnlockTexture(tex.get());
+            }
+        } else {
+            SDL_UpdateTexture(tex.get(), nullptr, textureBuffer.data(), rw * sizeof(uint32_t));
+        }
 
         SDL_RenderClear(ren.get());
         SDL_RenderCopy(ren.get(), tex.get(), nullptr, nullptr);
@@ -500,6 +1486,16 @@ auto TestSDL2RayTrace(const bool verbose) -> int
         joystick = nullptr;
     }
 
+    if (video) {
+        if (!video->finish()) {
+            cerr << "Error writing the video" << endl;
+        }
+        if (verbose) {
+            cerr << "streamed " << video->written() << " frames, dropped " << video->dropped()
+                 << endl;
+        }
+    }
+
     SDL_Quit();
     return 0;
 }
@@ -509,23 +1505,13 @@ void TestRayTrace(const std::string filename)
     const int W = 320;
     const int H = 240;
 
-    const Sphere light { Vec3 { 0, 0, 50 }, 1 };
-    const Plane plane { Vec3 { 0, 0, 100 }, (Vec3 { 0, 0, 0.5 }).normalize() };
-
-    const Sphere sphere1 { Vec3 { W * .4, H * .5, 50 }, 50 };
-    const Sphere sphere2 { Vec3 { W * .5, H * .5, 50 }, 50 };
-    const Sphere sphere3 { Vec3 { W * .6, H * .5, 50 }, 50 };
-
-    const Cube cube1 { Vec3 { W * .7, H * .5, 50 }, 50 };
-
-    std::vector<Sphere> spheres = { sphere1, sphere2, sphere3 };
-
     std::ofstream out(filename);
     out << "P3\n"s << W << " "s << H << " "s
         << "255\n"s;
 
-    // Create a scene
-    Scene scene { light, plane, spheres, cube1, Color::darkgray };
+    // Create a scene, from the demo scene that is defined at compile time
+    constexpr DemoScene demo = demo_scene(W, H);
+    const Scene scene = demo.scene();
 
     // Create a camera point
     const Point3 fromPoint { 0, 0, -W * 2 };
@@ -537,46 +1523,1605 @@ void TestRayTrace(const std::string filename)
     }
 }
 
-// mustRead reads the contents of the given filename,
-// with no error checking except possibly exceptions
-auto mustRead(const std::string filename) -> const std::string
+auto TestScript(const std::string filename) -> int
 {
-    std::stringstream buf;
-    std::ifstream f { filename };
-    buf << f.rdbuf();
-    return buf.str();
+    std::cout << "--- SCRIPT: " << filename << " ---" << std::endl;
+    const Script script { filename };
+    std::cout << "read " << script.source().length() << " characters, "
+              << script.tokens().size() << " tokens" << std::endl;
+    const Script copied { filename, true };
+    std::cout << std::boolalpha << "copied, the same source: "
+              << (copied.source() == script.source()) << ", the same number of tokens: "
+              << (copied.tokens().size() == script.tokens().size()) << std::endl;
+
+    // The example scripts call hello and hi
+    Builtins builtins;
+    add_standard_builtins(builtins);
+    builtins.function("hello", 0, [](std::span<const Value>) {
+        std::cout << "hello called" << std::endl;
+        return 0.0;
+    });
+    builtins.function("hi", 0, [](std::span<const Value>) {
+        std::cout << "hi called" << std::endl;
+        return 0.0;
+    });
+    return interpret(script, builtins);
 }
 
-auto TestScript(const std::string filename) -> int
+// compileSource compiles a script that is given as a string
+auto compileSource(std::string_view source, const Builtins& builtins) -> Bytecode
 {
-    std::cout << "--- SCRIPT: " << filename << " ---" << std::endl;
-    const std::string source = mustRead(filename);
-    std::cout << "read " << source.length() << " characters" << std::endl;
-    return interpret(tokenize(source));
+    const auto tokens = tokenize(source);
+    SyntaxTree tree;
+    parse(tokens, source, tree);
+    return compile(tree, source, builtins);
 }
 
-auto main(int argc, char** argv) -> int
+void TestArena()
 {
-    if (argc > 1) { // pass ie. "test" as the first argument
+    std::cout << std::boolalpha;
 
-        TestV2();
-        TestV3();
-        TestV4();
+    std::cout << "--- Arena ---"s << std::endl;
+
+    Arena arena { 1024 };
+    const auto* a = arena.make<Vec3>(1, 2, 3);
+    const auto numbers = arena.array<double>(100);
+    const auto* b = arena.make<Vec3>(4, 5, 6);
+    std::cout << *a << " " << *b << ", " << numbers.size() << " numbers" << std::endl;
+    std::cout << "aligned: " << (reinterpret_cast<uintptr_t>(numbers.data()) % alignof(double) == 0)
+              << std::endl;
+    std::cout << "used: " << arena.used() << ", reserved: " << arena.reserved() << std::endl;
+
+    // Large allocations get their own block
+    arena.allocate(4096);
+    std::cout << "reserved after a large allocation: " << arena.reserved() << std::endl;
+
+    // After a reset, the same memory is handed out again
+    arena.reset();
+    const auto* c = arena.make<Vec3>(7, 8, 9);
+    std::cout << "reused after reset: " << (static_cast<const void*>(c) == a)
+              << ", reserved: " << arena.reserved() << std::endl;
+
+    Interner names { arena };
+    const auto x = names.intern("x");
+    const auto y = names.intern("y");
+    std::cout << "interned: " << (names.intern("x") == x) << " " << (x != y) << " "
+              << names.str(y) << " " << names.size() << std::endl;
+}
+
+void TestVM()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- VM ---"s << std::endl;
+
+    Builtins builtins;
+    add_standard_builtins(builtins);
+    builtins.variable("frame");
+
+    // Loops, conditions, arithmetic and function calls
+    const std::string_view source = R"(
+        // Sum the numbers from 1 to 10, the even ones twice
+        sum = 0
+        even = 0
+        for (i = 1; i <= 10; i = i + 1) {
+            if (even == 1) {
+                sum = sum + 2 * i
+                even = 0
+            } else {
+                sum = sum + i
+                even = 1
+            }
+        }
+        wave = sin(frame) * -2.5
+        print("sum is", sum)
+    )";
+    const auto code = std::make_shared<const Bytecode>(compileSource(source, builtins));
+    std::cout << code->code.size() << " instructions, " << code->registerCount << " registers"
+              << std::endl;
+    VM vm { builtins, code };
+    vm.set("frame", 1);
+    vm.run();
+    std::cout << "sum: " << *vm.get("sum") << " (expected 85)" << std::endl;
+    std::cout << "wave: " << *vm.get("wave") << " (expected " << std::sin(1.0) * -2.5 << ")"
+              << std::endl;
+
+    // Variables keep their values between runs
+    const auto counter = std::make_shared<const Bytecode>(
+        compileSource("if (frame == 0) { n = 0 } n = n + 1", builtins));
+    VM counterVM { builtins, counter };
+    for (int frame = 0; frame < 5; ++frame) {
+        counterVM.set("frame", frame);
+        counterVM.run();
+    }
+    std::cout << "counter after 5 runs: " << *counterVM.get("n") << std::endl;
+
+    // Errors are reported with the line number
+    for (const std::string_view bad : { "x = 1\ny = z", "print(\n1,", "x = sin(1, 2)" }) {
+        try {
+            compileSource(bad, builtins);
+            std::cout << "no error for: " << bad << std::endl;
+        } catch (const std::runtime_error& e) {
+            std::cout << "error: " << e.what() << std::endl;
+        }
+    }
+
+    // Scripts that are nested too deeply are rejected, instead of overflowing the stack
+    const auto nested = [](size_t depth) {
+        return "x = "s + std::string(depth, '(') + "1"s + std::string(depth, ')');
+    };
+    compileSource(nested(200), builtins);
+    try {
+        compileSource(nested(100000), builtins);
+        std::cout << "no error for 100000 parentheses" << std::endl;
+    } catch (const std::runtime_error& e) {
+        std::cout << "error: " << e.what() << std::endl;
+    }
+
+    // An endless loop is stopped, once the run has taken more instructions than its budget
+    const auto loop = std::make_shared<const Bytecode>(compileSource("for (;;) {}", builtins));
+    VM endless { builtins, loop };
+    endless.budget(1000000);
+    try {
+        endless.run();
+        std::cout << "the endless loop ended" << std::endl;
+    } catch (const std::runtime_error& e) {
+        std::cout << "error: " << e.what() << std::endl;
+    }
+}
+
+// generateScript writes an animation script of roughly the given size to a file
+void generateScript(const std::string filename, size_t size)
+{
+    std::ofstream f { filename };
+    size_t written = 0;
+    for (int frame = 0; written < size; ++frame) {
+        const std::string block = "if (frame >= "s + std::to_string(frame)
+            + ") {\n  move(sphere);\n  print(\"frame "s + std::to_string(frame) + "\");\n}\n"s;
+        f << block;
+        written += block.length();
+    }
+}
+
+void TestWatcher()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Script watcher ---"s << std::endl;
+
+    Builtins builtins;
+    add_standard_builtins(builtins);
+
+    const std::string filename = "/tmp/test_watcher.pip"s;
+    std::ofstream { filename } << "n = n + 1\nstep = 1\n";
+
+    ScriptWatcher watcher { builtins, { filename } };
+    VM vm { builtins, watcher.take(0) };
+    vm.run();
+    vm.run();
+    std::cout << "nothing new: " << (watcher.take(0) == nullptr) << std::endl;
+
+    // Save a script with an error, then a fixed one, like when editing
+    std::ofstream { filename } << "n = n +\n";
+    std::ofstream { filename } << "n = n + 10\nstep = 10\n";
+
+    // Wait for the new program, like the render loop does between frames
+    std::shared_ptr<const Bytecode> code;
+    for (int i = 0; i < 200 && !code; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (auto newest = watcher.take(0)) {
+            code = newest;
+        }
+    }
+    std::cout << "reloaded: " << (code != nullptr) << std::endl;
+    if (code) {
+        vm.load(code);
+        vm.run();
+    }
+    std::cout << "n: " << *vm.get("n") << " (expected 12), step: " << *vm.get("step")
+              << " (expected 10)" << std::endl;
+}
+
+void TestCommandBuffer()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Command buffer ---"s << std::endl;
+
+    const Sphere light { Vec3 { 0, 0, 50 }, 1 };
+    const Plane plane { Vec3 { 0, 0, 100 }, (Vec3 { 0, 0, 0.5 }).normalize() };
+    const Cube cube { Vec3 { 0, 0, 50 }, 50 };
+    std::vector<Sphere> spheres;
+    for (int i = 0; i < 4; ++i) {
+        spheres.push_back(Sphere { Vec3 { i * 10.0, 0, 0 }, 1 });
+    }
+    auto scene = std::make_unique<Scene>(light, plane, spheres, cube, Color::darkgray);
+
+    // Record changes from a script, then apply them all at once
+    CommandBuffer commands;
+    Builtins builtins;
+    add_standard_builtins(builtins);
+    add_scene_builtins(builtins, scene, commands);
+    const std::string_view source = R"(
+        sphere_move_range(0, 4, 0, 1, 0)
+        sphere_set(1, 5, 5, 5)
+        sphere_move(1, 1, 0, 0)
+        newest = spawn(100, 0, 0, 2)
+        sphere_move(newest, 0, 0, 1)
+        destroy(2)
+        light_move(0, 0, -10)
+        count = sphere_count()
+    )";
+    VM vm { builtins, std::make_shared<const Bytecode>(compileSource(source, builtins)) };
+    vm.run();
+    std::cout << commands.size() << " commands, spawned index " << *vm.get("newest")
+              << " (expected 4), count " << *vm.get("count") << " (expected 5)" << std::endl;
+    std::cout << "unchanged before applying: " << (scene->sphere_count() == 4) << std::endl;
+
+    scene = std::make_unique<Scene>(scene->apply(commands));
+    commands.clear();
+    std::cout << "spheres after applying: " << scene->sphere_count() << " (expected 4)"
+              << std::endl;
+    std::cout << *scene;
+
+    // Overlapping ranges are applied in the order they were recorded
+    std::vector<Sphere> many;
+    for (int i = 0; i < 10000; ++i) {
+        many.push_back(Sphere { Vec3 { 0, 0, 0 }, 1 });
+    }
+    commands.move(0, 10000, Vec3 { 1, 0, 0 });
+    commands.set_position(5000, Vec3 { 0, 0, 0 });
+    commands.move(4000, 2000, Vec3 { 0, 1, 0 });
+    const auto moved = commands.apply(many);
+    std::cout << "overlapping: " << moved[0].pos() << " " << moved[4500].pos() << " "
+              << moved[5000].pos() << " (expected [1, 0, 0] [1, 1, 0] [0, 1, 0])" << std::endl;
+
+    // Ranges from scripts that are NaN, infinite or far too long
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    size_t start = 0;
+    size_t length = 0;
+    const bool rejected = !sphere_range(nan, 1, 10, start, length)
+        && !sphere_range(0, nan, 10, start, length) && !sphere_range(inf, 1, 10, start, length)
+        && !sphere_range(0, inf, 10, start, length);
+    const bool limited = sphere_range(3, 1e30, 10, start, length) && start == 3 && length == 7;
+    std::cout << "invalid ranges rejected: " << rejected << ", long range limited: " << limited
+              << std::endl;
+}
+
+// FrameLoop does the work that the main loop does for every frame, without a window. A script
+// moves the spheres, the changes are applied to the scene, and the scene is culled, binned,
+// traced and upscaled, while the camera turns. The spheres and the camera go back and forth,
+// about every 63 frames.
+struct FrameLoop {
+    const int W;
+    const int H;
+    const int rw;
+    const int rh;
+    std::unique_ptr<Scene> scene;
+    CommandBuffer commands;
+    Builtins builtins;
+    std::unique_ptr<VM> vm;
+    Frame frame;
+    Upscaler upscaler;
+    std::vector<uint32_t> colors;
+    std::vector<float> depths;
+    std::vector<int32_t> ids;
+    std::vector<uint32_t> output;
+    int frameNumber = 0;
+
+    // A grid of n x n spheres, traced at rw x rh and upscaled to W x H
+    FrameLoop(int w, int h, int n, int renderw, int renderh)
+        : W { w }
+        , H { h }
+        , rw { renderw }
+        , rh { renderh }
+        , scene { std::make_unique<Scene>(cameraScene(w, h, n)) }
+        , colors(renderw * renderh)
+        , depths(renderw * renderh)
+        , ids(renderw * renderh)
+        , output(w * h)
+    {
+        add_standard_builtins(builtins);
+        add_scene_builtins(builtins, scene, commands);
+        builtins.variable("frame");
+        vm = std::make_unique<VM>(builtins,
+            std::make_shared<const Bytecode>(compileSource(
+                "sphere_move_range(0, sphere_count(), sin(frame / 10) / 10, 0, 0)", builtins)));
+    }
+
+    void run()
+    {
+        vm->set("frame", frameNumber);
+        vm->run();
+        scene->update(commands);
+        commands.clear();
+        const Camera start = demoCamera(W, H);
+        const Camera camera { start.pos(),
+            Quat::from_axis_angle(Vec3 { 0, 1, 0 }, std::sin(frameNumber / 10.0) * .1),
+            start.fov() };
+        scene->cull(camera, static_cast<double>(rw) / rh, frame);
+        scene->bin(camera, rw, rh, frame);
+        traceFrame<FastMath>(*scene, camera, frame, rw, rh, colors.data(), depths.data(),
+            ids.data());
+        upscaler.upscale(colors.data(), depths.data(), ids.data(), rw, rh, output.data(), W, H,
+            W * static_cast<int>(sizeof(uint32_t)));
+        ++frameNumber;
+    }
+};
+
+void TestAllocations()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Allocations ---"s << std::endl;
+
+    // Each thread counts its own allocations, if counting is built in
+    if (allocationsCounted) {
+        const AllocationCount before = thread_allocation_count();
+        const auto numbers = std::make_unique<std::vector<int>>(100);
+        const AllocationCount counted = thread_allocation_count() - before;
+        std::cout << "allocations for a vector of 100 ints: " << counted.allocations << ", "
+                  << counted.bytes << " bytes" << std::endl;
+    } else {
+        std::cout << "allocations are not counted in this build, skipping the counts (they are "
+                     "checked by spheremover_counted)"
+                  << std::endl;
+    }
+
+    // Updating a scene in place gives the same scene as creating a new one
+    Scene scene = cameraScene(100, 100, 4);
+    CommandBuffer commands;
+    commands.move(0, 16, Vec3 { 1, 2, 3 });
+    commands.destroy(3, 1);
+    commands.spawn(Point3 { 1, 1, 1 }, 2);
+    commands.light_move(Vec3 { 0, 0, 5 });
+    const Scene applied = scene.apply(commands);
+    scene.update(commands);
+    std::cout << "updated in place is the same as applied: " << (scene.str() == applied.str())
+              << std::endl;
+
+    // Once the buffers have grown to hold the most objects that are seen, which takes one round
+    // of the animation, the frames of the main loop do not allocate at all
+    if (!allocationsCounted) {
+        return;
+    }
+    FrameLoop loop { 320, 240, 60, 80, 60 };
+    const int frames = 64;
+    for (int i = 0; i < frames; ++i) {
+        loop.run();
+    }
+    const AllocationCount start = allocation_count();
+    for (int i = 0; i < 2 * frames; ++i) {
+        loop.run();
+    }
+    const AllocationCount allocated = allocation_count() - start;
+    std::cout << "allocations in " << 2 * frames << " frames, after the first " << frames << ": "
+              << allocated.allocations << ", none: " << (allocated.allocations == 0) << std::endl;
+}
+
+void TestFrameArenas()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Frame arenas ---"s << std::endl;
+
+    // The arenas are only made by begin_frame, and a thread without one is refused
+    FrameArenas arenas;
+    bool refused = false;
+    try {
+        arenas.local();
+    } catch (const std::runtime_error&) {
+        refused = true;
+    }
+    std::cout << "no arena before the first frame: " << refused << std::endl;
+
+    // Each thread gets its own arena, in cache lines of its own
+    const int threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+    arenas.begin_frame();
+    Arena* local[4] = { nullptr, nullptr, nullptr, nullptr };
+#pragma omp parallel num_threads(4)
+    {
+        local[omp_get_thread_num()] = &arenas.local();
+    }
+    omp_set_num_threads(threads);
+    bool separate = true;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i + 1; j < 4; ++j) {
+            const auto a = reinterpret_cast<uintptr_t>(local[i]);
+            const auto b = reinterpret_cast<uintptr_t>(local[j]);
+            separate = separate && a / 64 != b / 64 && (a + sizeof(Arena) - 1) / 64 != b / 64
+                && (b + sizeof(Arena) - 1) / 64 != a / 64;
+        }
+    }
+    std::cout << arenas.stats().threads << " arenas, in separate cache lines: " << separate
+              << std::endl;
+
+    // The lanes of the tiles are placed in the arenas, and after the first frame, each arena has
+    // one block that is large enough for a whole frame
+    const int W = 320;
+    const int H = 240;
+    const Scene scene = cameraScene(W, H, 60);
+    const Camera camera = demoCamera(W, H);
+    Frame frame;
+    std::vector<uint32_t> colors(W * H);
+    std::vector<float> depths(W * H);
+    std::vector<int32_t> ids(W * H);
+    size_t reserved = 0;
+    for (int i = 0; i < 3; ++i) {
+        scene.cull(camera, static_cast<double>(W) / H, frame);
+        scene.bin(camera, W, H, frame);
+        traceFrame<ExactMath>(scene, camera, frame, W, H, colors.data(), depths.data(), ids.data());
+        const ArenaStats stats = frame.arenas.stats();
+        std::cout << "frame " << i << ": used " << stats.used << ", peak " << stats.peak
+                  << ", reserved " << stats.reserved << " bytes" << std::endl;
+        if (i == 1) {
+            reserved = stats.reserved;
+        }
+    }
+    std::cout << "same memory in the last frame: " << (frame.arenas.stats().reserved == reserved)
+              << std::endl;
+    const TileObjects tile = frame.tile(frame.tilesX / 2, frame.tilesY / 2);
+    std::cout << "lanes start at a cache line: "
+              << (reinterpret_cast<uintptr_t>(tile.sphere_lanes().x) % 64 == 0)
+              << ", in the arena of this thread: " << (&tile.arena() == &frame.arenas.local())
+              << std::endl;
+}
+
+// BatchResult is what renderBatch did
+struct BatchResult {
+    size_t rendered = 0;
+    size_t imageParallel = 0; // images that were traced on one thread each, side by side
+    size_t tileParallel = 0; // images that were traced one at a time, with a tile per thread
+    std::vector<std::string> failed; // the images with scenes that could not be loaded
+};
+
+// renderImage traces one image of a batch at its own resolution, and returns the colors as
+// ARGB8888 pixels, tone mapped as the mapping says. The camera starts out where it does in the
+// main loop, unless the image places it.
+auto renderImage(const Scene& scene, const BatchImage& image, Frame& frame,
+    const ToneMapping& toneMapping) -> std::vector<uint32_t>
+{
+    const int w = image.width;
+    const int h = image.height;
+
+    // Move the spheres in a copy of the scene, so that the other images see the original
+    std::optional<Scene> moved;
+    if (!image.moves.empty()) {
+        CommandBuffer commands;
+        for (const auto& move : image.moves) {
+            commands.move(move.index, 1, Vec3 { move.x, move.y, move.z });
+        }
+        moved.emplace(scene.apply(commands));
+    }
+    const Scene& traced = moved ? *moved : scene;
+
+    const Camera start = demoCamera(495, 270);
+    const Point3 pos = image.camera
+        ? Point3 { (*image.camera)[0], (*image.camera)[1], (*image.camera)[2] }
+        : start.pos();
+    const Camera camera { pos,
+        Quat::from_axis_angle(Vec3 { 0, 1, 0 }, image.yaw)
+            * Quat::from_axis_angle(Vec3 { 1, 0, 0 }, image.pitch),
+        start.fov() };
+
+    std::vector<uint32_t> colors(static_cast<size_t>(w) * h);
+    std::vector<float> depths(colors.size());
+    std::vector<int32_t> ids(colors.size());
+    traced.cull(camera, static_cast<double>(w) / h, frame);
+    traced.bin(camera, w, h, frame);
+    traceFrame<ExactMath>(
+        traced, camera, frame, w, h, colors.data(), depths.data(), ids.data(), toneMapping);
+    return colors;
+}
+
+// rgbBytes returns three bytes per pixel, for writing ARGB8888 colors from traceFrame to a file
+auto rgbBytes(const std::vector<uint32_t>& colors) -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> rgb(colors.size() * 3);
+    for (size_t i = 0; i < colors.size(); ++i) {
+        rgb[(i * 3)] = static_cast<uint8_t>(colors[i] >> 16);
+        rgb[(i * 3) + 1] = static_cast<uint8_t>(colors[i] >> 8);
+        rgb[(i * 3) + 2] = static_cast<uint8_t>(colors[i]);
+    }
+    return rgb;
+}
+
+// traceImages traces each image in its scene, scenes[i] for images[i], with the given tone
+// mapping, and passes the colors of each image to done, together with its index. done is called
+// from several threads at once.
+//
+// The work is shared between the threads in one of two ways. An image with fewer than largeTiles
+// tiles has too few tiles to keep all threads busy until the end, so small images are traced
+// side by side, one image per thread, each with a Frame of its own. The larger images are traced
+// one at a time, with the tiles of each image shared between all threads. If there are fewer
+// small images than threads, they are traced like the large ones.
+auto traceImages(const std::vector<const Scene*>& scenes, const std::vector<BatchImage>& images,
+    int largeTiles, const ToneMapping& toneMapping,
+    const std::function<void(size_t, std::vector<uint32_t>)>& done) -> BatchResult
+{
+    BatchResult result;
+
+    std::vector<size_t> small;
+    std::vector<size_t> large;
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (!scenes[i]) {
+            result.failed.push_back(images[i].output);
+            continue;
+        }
+        const int tilesX = (images[i].width + Frame::tileSize - 1) / Frame::tileSize;
+        const int tilesY = (images[i].height + Frame::tileSize - 1) / Frame::tileSize;
+        (tilesX * tilesY < largeTiles ? small : large).push_back(i);
+    }
+    if (small.size() < static_cast<size_t>(omp_get_max_threads())) {
+        large.insert(large.end(), small.begin(), small.end());
+        small.clear();
+    }
+
+    // Frame-level: the loop of tiles in traceFrame runs on the thread of its image, since
+    // OpenMP does not start more threads from inside of a parallel region by default
+#pragma omp parallel
+    {
+        Frame frame;
+#pragma omp for schedule(dynamic)
+        for (size_t k = 0; k < small.size(); ++k) {
+            done(small[k],
+                renderImage(*scenes[small[k]], images[small[k]], frame, toneMapping));
+        }
+    }
+
+    // Tile-level
+    Frame frame;
+    for (const size_t i : large) {
+        done(i, renderImage(*scenes[i], images[i], frame, toneMapping));
+    }
+
+    result.imageParallel = small.size();
+    result.tileParallel = large.size();
+    result.rendered = small.size() + large.size();
+    return result;
+}
+
+// renderBatch renders all the given images, and queues them for the writer. Each scene is only
+// loaded once, even if many images use it. See traceImages for how the work is shared.
+auto renderBatch(const std::vector<BatchImage>& images, ImageWriter& writer,
+    int largeTiles = 8 * omp_get_max_threads(), const ToneMapping& toneMapping = {})
+    -> BatchResult
+{
+    std::map<std::string, Scene> loaded;
+    for (const auto& image : images) {
+        if (loaded.contains(image.scene)) {
+            continue;
+        }
+        try {
+            if (image.scene == "demo"s) {
+                loaded.emplace(image.scene, demo_scene(495, 270).scene());
+            } else {
+                loaded.emplace(image.scene, loadScene(image.scene));
+            }
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error loading scene: " << e.what() << std::endl;
+        }
+    }
+
+    // The images with scenes that could not be loaded have no scene
+    std::vector<const Scene*> scenes;
+    for (const auto& image : images) {
+        const auto found = loaded.find(image.scene);
+        scenes.push_back(found != loaded.end() ? &found->second : nullptr);
+    }
+    return traceImages(
+        scenes, images, largeTiles, toneMapping, [&](size_t i, std::vector<uint32_t> colors) {
+            writer.write(images[i].output, images[i].width, images[i].height, rgbBytes(colors));
+        });
+}
+
+// Animation replays the scripts on a scene, one frame at a time, and renders the frames to
+// numbered images or to video. Frame 0 is the scene as it starts, and frame k is the scene after
+// the scripts have run k times, with the frame number and the time at 60 frames per second.
+//
+// The scripts have to run in order, but once they have run, each frame is a Scene of its own
+// that nothing changes any more, so the frames are traced in windows of a few frames per thread,
+// side by side, while the writer writes the frames before them. Only the scenes and colors of one
+// window and the frames in the queue of the writer are kept in memory.
+struct Animation {
+    static constexpr double fps = 60;
+
+    // How the colors of the frames are turned into pixels
+    ToneMapping toneMapping;
+
+    std::unique_ptr<Scene> scene;
+    CommandBuffer commands;
+    Builtins builtins;
+    std::vector<std::unique_ptr<VM>> vms;
+    int frameNumber = 0;
+
+    // Throws std::runtime_error if a script can not be read or compiled
+    Animation(Scene start, const std::vector<std::string>& scripts)
+        : scene { std::make_unique<Scene>(std::move(start)) }
+    {
+        add_standard_builtins(builtins);
+        add_scene_builtins(builtins, scene, commands);
+        builtins.variable("frame");
+        builtins.variable("time");
+        for (const auto& filename : scripts) {
+            const Script script { filename };
+            vms.push_back(std::make_unique<VM>(
+                builtins, std::make_shared<const Bytecode>(compile_script(script, builtins))));
+        }
+    }
+
+    // step returns the scene of the next frame, and runs the scripts to make the one after it
+    auto step() -> std::unique_ptr<const Scene>
+    {
+        for (auto& vm : vms) {
+            vm->set("frame", frameNumber);
+            vm->set("time", frameNumber / fps);
+            vm->run();
+        }
+        ++frameNumber;
+        auto next = std::make_unique<Scene>(scene->apply(commands));
+        commands.clear();
+        return std::exchange(scene, std::move(next));
+    }
+
+    // trace traces the next frames, from the current frame to the given one, and passes the
+    // number and the colors of each frame to done, in order, on the calling thread. If done
+    // returns false, no more frames are traced.
+    auto trace(int end, int w, int h, int largeTiles,
+        const std::function<bool(int, const std::vector<uint32_t>&)>& done) -> BatchResult
+    {
+        const auto window = static_cast<size_t>(2 * omp_get_max_threads());
+        BatchResult result;
+        std::vector<std::unique_ptr<const Scene>> frames;
+        std::vector<const Scene*> scenes;
+        std::vector<BatchImage> images;
+        std::vector<std::vector<uint32_t>> colors(window);
+        bool going = true;
+        while (going && frameNumber < end) {
+            const int first = frameNumber;
+            frames.clear();
+            scenes.clear();
+            images.clear();
+            while (frameNumber < end && frames.size() < window) {
+                BatchImage image;
+                image.width = w;
+                image.height = h;
+                images.push_back(image);
+                frames.push_back(step());
+                scenes.push_back(frames.back().get());
+            }
+            const BatchResult traced = traceImages(scenes, images, largeTiles, toneMapping,
+                [&](size_t i, std::vector<uint32_t> pixels) { colors[i] = std::move(pixels); });
+            for (size_t i = 0; going && i < images.size(); ++i) {
+                going = done(first + static_cast<int>(i), colors[i]);
+            }
+            result.rendered += traced.rendered;
+            result.imageParallel += traced.imageParallel;
+            result.tileParallel += traced.tileParallel;
+        }
+        return result;
+    }
+
+    // render renders the next frames, up to the given one, to files with the frame numbers added
+    // to the output filename, padded to at least 4 digits
+    auto render(int end, const std::string& output, int w, int h, ImageWriter& writer,
+        int largeTiles = 8 * omp_get_max_threads()) -> BatchResult
+    {
+        const int digits = std::max(4, static_cast<int>(std::to_string(end - 1).size()));
+        return trace(end, w, h, largeTiles, [&](int number, const std::vector<uint32_t>& colors) {
+            writer.write(numbered_filename(output, number, digits), w, h, rgbBytes(colors));
+            return true;
+        });
+    }
+
+    // stream renders the next frames, up to the given one, as video. It stops early if the video
+    // can not be written.
+    auto stream(int end, Y4MWriter& video, int largeTiles = 8 * omp_get_max_threads())
+        -> BatchResult
+    {
+        return trace(end, video.width(), video.height(), largeTiles,
+            [&](int, const std::vector<uint32_t>& colors) {
+                return video.write(colors.data(), true);
+            });
+    }
+};
+
+// runBatch renders the images of a manifest with the given tone mapping, and writes them. Returns
+// EXIT_FAILURE if any image could not be rendered or written.
+auto runBatch(const std::string& manifest, const ToneMapping& toneMapping) -> int
+{
+    std::vector<BatchImage> images;
+    try {
+        images = parse_manifest(manifest);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error reading manifest: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    ImageWriter writer;
+    const BatchResult result
+        = renderBatch(images, writer, 8 * omp_get_max_threads(), toneMapping);
+    const auto unwritten = writer.wait();
+    const std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+
+    for (const auto& filename : unwritten) {
+        std::cerr << "Could not write " << filename << std::endl;
+    }
+    for (const auto& filename : result.failed) {
+        std::cerr << "Could not render " << filename << std::endl;
+    }
+    std::cout << "wrote " << writer.written() << " of " << images.size() << " images in "
+              << elapsed.count() << " ms (" << result.imageParallel << " one per thread, "
+              << result.tileParallel << " with a tile per thread)" << std::endl;
+    return (unwritten.empty() && result.failed.empty()) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// runAnimation renders the frames of the scripts that are given in the options, starting with
+// the demo scene or the scene that is given, to numbered images or to video. Returns
+// EXIT_FAILURE if anything goes wrong.
+auto runAnimation(const Options& options) -> int
+{
+    std::unique_ptr<Animation> animation;
+    try {
+        animation = std::make_unique<Animation>(
+            options.scene.empty() ? demo_scene(495, 270).scene() : loadScene(options.scene),
+            options.scripts);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    animation->toneMapping = options.toneMapping;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!options.y4m.empty()) {
+        std::unique_ptr<Y4MWriter> video;
+        try {
+            video = std::make_unique<Y4MWriter>(
+                options.y4m, options.width, options.height, static_cast<int>(Animation::fps));
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        try {
+            animation->stream(options.animate, *video);
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        const bool ok = video->finish();
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - start;
+        // Standard output may be the video, in which case this goes to standard error
+        std::cout << "streamed " << video->written() << " of " << options.animate
+                  << " frames in " << elapsed.count() << " ms" << std::endl;
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    ImageWriter writer;
+    BatchResult result;
+    try {
+        result = animation->render(
+            options.animate, options.output, options.width, options.height, writer);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    const auto unwritten = writer.wait();
+    const std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+
+    for (const auto& filename : unwritten) {
+        std::cerr << "Could not write " << filename << std::endl;
+    }
+    std::cout << "wrote " << writer.written() << " of " << options.animate << " frames in "
+              << elapsed.count() << " ms (" << result.imageParallel << " one per thread, "
+              << result.tileParallel << " with a tile per thread)" << std::endl;
+    return unwritten.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void TestBatch()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Batch ---"s << std::endl;
+
+    const std::string manifest = "/tmp/spheremover_batch.txt"s;
+    {
+        std::ofstream out { manifest };
+        out << "# the demo scene, from the side\n"s
+            << "image spheremover_batch_demo.ppm demo 160 90\n"s
+            << "camera 100 135 -990 0.2 0\n"s
+            << "image spheremover_batch_sweep.ppm demo 64 36\n"s
+            << "sweep 0 20 0 0 3\n"s
+            << "image spheremover_batch_text.ppm "s << SCENEDIR "demo.txt"s << " 300 200\n"s;
+    }
+    const auto images = parse_manifest(manifest);
+    std::cout << "images: " << images.size() << " (expected 5), second: " << images[1].output
+              << ", moved by " << images[2].moves[0].x << " (expected 20)" << std::endl;
+
+    try {
+        std::ofstream { manifest } << "image out.ppm demo\nsweep 0 1 2\n"s;
+        parse_manifest(manifest);
+        std::cout << "invalid manifest accepted" << std::endl;
+    } catch (const std::runtime_error& e) {
+        std::cout << "invalid manifest: " << e.what() << std::endl;
+    }
+
+    // Render the images one per thread, then with a tile per thread, and compare the files
+    std::vector<std::string> first;
+    ImageWriter writer;
+    for (const int largeTiles : { std::numeric_limits<int>::max(), 0 }) {
+        const BatchResult result = renderBatch(images, writer, largeTiles);
+        const auto unwritten = writer.wait();
+        std::cout << "rendered " << result.rendered << ", one per thread "
+                  << result.imageParallel << ", with a tile per thread " << result.tileParallel
+                  << ", not written " << unwritten.size() << std::endl;
+        std::vector<std::string> files;
+        for (const auto& image : images) {
+            files.push_back(read_file(image.output));
+        }
+        if (first.empty()) {
+            first = files;
+        } else {
+            std::cout << "the same files both ways: " << (files == first) << std::endl;
+        }
+    }
+    std::cout << "written: " << writer.written() << " (expected 10), PPM header: "
+              << first[0].starts_with("P6\n160 90\n255\n"s) << ", size " << first[0].size()
+              << " (expected " << 14 + (160 * 90 * 3) << ")" << std::endl;
+    std::cout << "the sweep moves a sphere: " << (first[1] != first[2] && first[2] != first[3])
+              << std::endl;
+}
+
+void TestAnimation()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Animation ---"s << std::endl;
+
+    const std::string script = "/tmp/spheremover_animation.pip"s;
+    std::ofstream { script } << "sphere_move(0, 10, 0, 0)\n"s;
+
+    // Render the frames one per thread, and then with a tile per thread
+    const int frames = 5;
+    ImageWriter writer;
+    std::vector<std::vector<std::string>> files;
+    for (const int largeTiles : { std::numeric_limits<int>::max(), 0 }) {
+        Animation animation { demo_scene(495, 270).scene(), { script } };
+        const BatchResult result = animation.render(
+            frames, "/tmp/spheremover_frame.ppm"s, 64, 36, writer, largeTiles);
+        std::cout << "rendered " << result.rendered << ", one per thread "
+                  << result.imageParallel << ", with a tile per thread " << result.tileParallel
+                  << ", not written " << writer.wait().size() << std::endl;
+        files.emplace_back();
+        for (int k = 0; k < frames; ++k) {
+            const auto filename = numbered_filename("/tmp/spheremover_frame.ppm"s, k, 4);
+            files.back().push_back(read_file(filename));
+        }
+    }
+    std::cout << "first frame: " << numbered_filename("/tmp/spheremover_frame.ppm"s, 0, 4)
+              << ", the same both ways: " << (files[0] == files[1]) << std::endl;
+
+    // Frame k is the scene after the script has moved the sphere k times, which is what a sweep
+    // in a manifest renders
+    std::ofstream { "/tmp/spheremover_sweep.txt"s }
+        << "image spheremover_sweep.ppm demo 64 36\nsweep 0 10 0 0 5\n"s;
+    renderBatch(parse_manifest("/tmp/spheremover_sweep.txt"s), writer);
+    writer.wait();
+    bool same = true;
+    for (int k = 0; k < frames; ++k) {
+        const std::string swept = read_file(numbered_filename("/tmp/spheremover_sweep.ppm"s, k));
+        same = same && files[0][k] == swept;
+    }
+    std::cout << "the same as a sweep: " << same << ", the frames differ: "
+              << (files[0][0] != files[0][1]) << std::endl;
+}
+
+void TestY4M()
+{
+    std::cout << std::boolalpha;
+
+    std::cout << "--- Y4M ---"s << std::endl;
+
+    // White, black, red, green and blue, as the same color in each pixel of a 2x2 block. A block
+    // gives four luma bytes, and one byte in each of the chroma planes
+    bool sameLuma = true;
+    for (const uint32_t color : { 0xFFFFFFFF, 0xFF000000, 0xFFFF0000, 0xFF00FF00, 0xFF0000FF }) {
+        const uint32_t block[4] = { color, color, color, color };
+        uint8_t y[4];
+        uint8_t u[1];
+        uint8_t v[1];
+        argb_to_yuv420(block, 2, 2, y, u, v);
+        sameLuma = sameLuma && y[1] == y[0] && y[2] == y[0] && y[3] == y[0];
+        std::cout << std::hex << color << std::dec << ": " << static_cast<int>(y[0]) << " "
+                  << static_cast<int>(u[0]) << " " << static_cast<int>(v[0]) << std::endl;
+    }
+    std::cout << "(expected 235 128 128, 16 128 128, 82 90 240, 144 54 34 and 41 240 110)"
+              << std::endl;
+    std::cout << "the same luma in each pixel: " << sameLuma << std::endl;
+
+    // Every level gives the same bytes as the scalar version, also for odd sizes, where the rows
+    // end in the scalar code and the last chroma samples only cover one column or row
+    for (const auto& [w, h] : { std::pair { 64, 32 }, std::pair { 37, 21 } }) {
+        std::vector<uint32_t> argb = randomBits(static_cast<size_t>(w) * h, 12345);
+        for (auto& p : argb) {
+            p |= 0xFF000000;
+        }
+        const size_t chroma = static_cast<size_t>((w + 1) / 2) * ((h + 1) / 2);
+        std::vector<uint8_t> planes[2] = { std::vector<uint8_t>(argb.size() + 2 * chroma),
+            std::vector<uint8_t>(argb.size() + 2 * chroma) };
+        const auto convert = [&](std::vector<uint8_t>& out) {
+            argb_to_yuv420(argb.data(), w, h, out.data(), out.data() + argb.size(),
+                out.data() + argb.size() + chroma);
+        };
+        forEachSimdLevel([&](const SimdLevel level) {
+            const int k = level == SimdLevel::SCALAR ? 0 : 1;
+            std::fill(planes[k].begin(), planes[k].end(), 0);
+            convert(planes[k]);
+            if (k == 1) {
+                std::cout << w << "x" << h << " " << simd_name(level)
+                          << " is the same as scalar: " << (planes[0] == planes[1]) << std::endl;
+            }
+        });
+    }
+
+    // Stream three frames of an animation to a file
+    const std::string filename = "/tmp/spheremover.y4m"s;
+    {
+        Y4MWriter video { filename, 64, 36, 60 };
+        Animation animation { demo_scene(495, 270).scene(), {} };
+        animation.stream(3, video);
+        std::cout << "finished: " << video.finish() << ", written: " << video.written()
+                  << ", dropped: " << video.dropped() << ", ready for more: " << video.ready()
+                  << std::endl;
+    }
+    const std::string contents = read_file(filename);
+    const std::string header = "YUV4MPEG2 W64 H36 F60:1 Ip A1:1 C420jpeg\n"s;
+    std::cout << "header: " << contents.starts_with(header) << ", size: " << contents.size()
+              << " (expected " << header.size() + 3 * (6 + 64 * 36 + 2 * 32 * 18) << ")"
+              << std::endl;
+}
+
+// BenchmarkTokenizer measures how fast large, generated scripts can be loaded and tokenized
+void BenchmarkTokenizer()
+{
+    std::cout << "--- Tokenizer ---" << std::endl;
+    for (const size_t megabytes : { 1, 4, 16, 64 }) {
+        const std::string filename = "/tmp/bench.pip"s;
+        generateScript(filename, megabytes * 1024 * 1024);
+
+        // Use the best of a few runs, to leave out the time it takes to read the file from disk
+        double best = 0;
+        size_t tokenCount = 0;
+        for (int run = 0; run < 5; ++run) {
+            const auto start = std::chrono::steady_clock::now();
+            const Script script { filename };
+            const std::chrono::duration<double, std::milli> elapsed
+                = std::chrono::steady_clock::now() - start;
+            if (run == 0 || elapsed.count() < best) {
+                best = elapsed.count();
+            }
+            tokenCount = script.tokens().size();
+        }
+        std::cout << megabytes << " MiB: " << tokenCount << " tokens in " << best << " ms, "
+                  << static_cast<double>(megabytes) / (best / 1000.0) << " MiB/s" << std::endl;
+    }
+}
+
+// BenchmarkParser measures how fast a large, generated script can be parsed into a syntax tree,
+// and how much memory the tree needs
+void BenchmarkParser()
+{
+    std::cout << "--- Parser ---" << std::endl;
+
+    const int lines = 100000;
+    std::string source;
+    for (int i = 0; i < lines; i += 2) {
+        const std::string x = "x"s + std::to_string(i % 1000);
+        source += x + " = "s + x + " * 0.5 + sin(time + "s + std::to_string(i) + ")\n"s;
+        source += "if (frame > "s + std::to_string(i) + ") { sphere_move(1, "s + x + ", 0, -"s + x
+            + ") } else { light_move(0, 1, 2) }\n"s;
+    }
+    const auto tokens = tokenize(source);
+
+    // Parse into the same tree a few times, which reuses the memory of the previous tree
+    SyntaxTree tree;
+    double best = 0;
+    for (int run = 0; run < 5; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        parse(tokens, source, tree);
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - start;
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    std::cout << lines << " lines, " << tokens.size() << " tokens, " << source.size() / 1024
+              << " KiB: parsed in " << best << " ms" << std::endl;
+    std::cout << "tree: " << tree.arena.used() / 1024 << " KiB used, "
+              << tree.arena.reserved() / 1024 << " KiB reserved, " << tree.names.size()
+              << " names" << std::endl;
+
+    Builtins builtins;
+    add_standard_builtins(builtins);
+    builtins.function("sphere_move", 4, [](std::span<const Value>) { return 0.0; });
+    builtins.function("light_move", 3, [](std::span<const Value>) { return 0.0; });
+    builtins.variable("frame");
+    builtins.variable("time");
+    const auto start = std::chrono::steady_clock::now();
+    const auto code = compile(tree, source, builtins);
+    const std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+    std::cout << "compiled to " << code.code.size() << " instructions in " << elapsed.count()
+              << " ms" << std::endl;
+}
+
+// BenchmarkVM measures how long it takes to run a typical animation script, once per frame
+void BenchmarkVM()
+{
+    std::cout << "--- VM ---" << std::endl;
+
+    Builtins builtins;
+    add_standard_builtins(builtins);
+    builtins.variable("frame");
+    builtins.variable("time");
+    double moved = 0;
+    builtins.function("sphere_move", 4, [&moved](std::span<const Value> args) {
+        moved += args[1].number + args[2].number + args[3].number;
+        return 0.0;
+    });
+    const std::string_view source = R"(
+        for (i = 0; i < 3; i = i + 1) {
+            sphere_move(i, cos(time + i) * 2, sin(time * 2 + i) * 2, 0)
+        }
+        if (frame / 60 > 10) {
+            speed = speed + 0.01
+        } else {
+            speed = 1
+        }
+    )";
+    VM vm { builtins, std::make_shared<const Bytecode>(compileSource(source, builtins)) };
+
+    const int runs = 1000000;
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < runs; ++frame) {
+        vm.set("frame", frame);
+        vm.set("time", frame / 60.0);
+        vm.run();
+    }
+    const std::chrono::duration<double, std::micro> elapsed
+        = std::chrono::steady_clock::now() - start;
+    std::cout << runs << " runs, " << elapsed.count() / runs << " us per run (" << moved << ")"
+              << std::endl;
+}
+
+// BenchmarkCommandBuffer measures how long it takes for a script to move 100k spheres, once per
+// frame, and for the changes to be applied to the scene
+void BenchmarkCommandBuffer()
+{
+    std::cout << "--- Command buffer ---" << std::endl;
+
+    const Sphere light { Vec3 { 0, 0, 50 }, 1 };
+    const Plane plane { Vec3 { 0, 0, 100 }, (Vec3 { 0, 0, 0.5 }).normalize() };
+    const Cube cube { Vec3 { 0, 0, 50 }, 50 };
+    const size_t sphereCount = 100000;
+    std::vector<Sphere> spheres;
+    for (size_t i = 0; i < sphereCount; ++i) {
+        spheres.push_back(Sphere { Vec3 { static_cast<double>(i % 500), i / 500.0, 50 }, 1 });
+    }
+    auto scene = std::make_unique<Scene>(light, plane, spheres, cube, Color::darkgray);
+
+    CommandBuffer commands;
+    Builtins builtins;
+    add_standard_builtins(builtins);
+    add_scene_builtins(builtins, scene, commands);
+    builtins.variable("time");
+
+    // One call per sphere, and one call for all of them
+    const std::pair<std::string, std::string_view> scripts[] = {
+        { "per sphere", R"(
+            n = sphere_count()
+            for (i = 0; i < n; i = i + 1) {
+                sphere_move(i, sin(time + i), 0, 0)
+            }
+        )" },
+        { "one range", "sphere_move_range(0, sphere_count(), sin(time), 0, 0)" },
+    };
+    for (const auto& [name, source] : scripts) {
+        VM vm { builtins, std::make_shared<const Bytecode>(compileSource(source, builtins)) };
+        const int frames = 20;
+        std::chrono::duration<double, std::milli> scripted { 0 };
+        std::chrono::duration<double, std::milli> applied { 0 };
+        std::chrono::duration<double, std::milli> updated { 0 };
+        AllocationCount applyAllocations;
+        AllocationCount updateAllocations;
+        for (int frame = 0; frame < frames; ++frame) {
+            // Every other frame creates a new scene, and the others update it in place
+            const auto start = std::chrono::steady_clock::now();
+            const AllocationCount before = allocation_count();
+            vm.set("time", frame / 60.0);
+            vm.run();
+            const auto ran = std::chrono::steady_clock::now();
+            if (frame % 2 == 0) {
+                scene = std::make_unique<Scene>(scene->apply(commands));
+                applied += std::chrono::steady_clock::now() - ran;
+                applyAllocations = applyAllocations + (allocation_count() - before);
+            } else {
+                scene->update(commands);
+                updated += std::chrono::steady_clock::now() - ran;
+                updateAllocations = updateAllocations + (allocation_count() - before);
+            }
+            commands.clear();
+            scripted += ran - start;
+        }
+        // The allocations are only shown if they are counted
+        const auto allocations = [&](const AllocationCount& count) {
+            return allocationsCounted
+                ? " ("s + std::to_string(count.allocations / (frames / 2)) + " allocations)"s
+                : ""s;
+        };
+        std::cout << sphereCount << " spheres, " << name << ": script " << scripted.count() / frames
+                  << " ms, apply " << applied.count() / (frames / 2) << " ms"
+                  << allocations(applyAllocations) << ", update "
+                  << updated.count() / (frames / 2) << " ms" << allocations(updateAllocations)
+                  << " per frame" << std::endl;
+    }
+
+    // For comparison, creating a new scene for every moved sphere, with fewer spheres
+    const size_t fewer = 2000;
+    std::vector<Sphere> someSpheres(spheres.begin(), spheres.begin() + fewer);
+    auto small = std::make_unique<Scene>(light, plane, someSpheres, cube, Color::darkgray);
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < fewer; ++i) {
+        small = std::make_unique<Scene>(small->sphere_move(i, Vec3 { 1, 0, 0 }));
+    }
+    const std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+    std::cout << fewer << " spheres, a new scene per call: " << elapsed.count() << " ms per frame"
+              << std::endl;
+}
+
+// BenchmarkMathPolicy measures how long it takes to trace a frame with each math policy
+void BenchmarkMathPolicy()
+{
+    std::cout << "--- Math policy ---" << std::endl;
+
+    const int W = 495;
+    const int H = 270;
+    const Scene scene = demo_scene(W, H).scene();
+    const Camera camera = demoCamera(W, H);
+    const int rw = 990;
+    const int rh = 540;
+    Frame frame;
+    scene.cull(camera, static_cast<double>(rw) / rh, frame);
+    scene.bin(camera, rw, rh, frame);
+    std::vector<uint32_t> colors(rw * rh);
+    std::vector<float> depths(rw * rh);
+    std::vector<int32_t> ids(rw * rh);
+
+    const auto measure = [&](const std::string& name, auto trace) {
+        const int frames = 20;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            trace();
+        }
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << elapsed.count() / frames << " ms per " << rw << "x" << rh
+                  << " frame" << std::endl;
+    };
+    measure("exact", [&] {
+        traceFrame<ExactMath>(
+            scene, camera, frame, rw, rh, colors.data(), depths.data(), ids.data());
+    });
+    measure("fast", [&] {
+        traceFrame<FastMath>(
+            scene, camera, frame, rw, rh, colors.data(), depths.data(), ids.data());
+    });
+}
+
+void BenchmarkCulling()
+{
+    std::cout << "--- Culling ---" << std::endl;
+
+    // 100k spheres, where most of them are outside of the view
+    const int W = 495;
+    const int H = 270;
+    const Scene scene = cameraScene(W, H, 316);
+    const Camera camera = demoCamera(W, H);
+    const int rw = 124;
+    const int rh = 68;
+    const double aspect = static_cast<double>(rw) / rh;
+    Frame frame;
+
+    const auto measure = [&](const std::string& name, auto trace) {
+        const int frames = 3;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            trace();
+        }
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << elapsed.count() / frames << " ms per " << rw << "x" << rh
+                  << " frame" << std::endl;
+    };
+    measure("cull only", [&] { scene.cull(camera, aspect, frame); });
+    std::cout << "visible: " << frame.sphere_count() << " of " << scene.sphere_count()
+              << " spheres" << std::endl;
+    measure("all objects", [&] {
+#pragma omp parallel for
+        for (int y = 0; y < rh; ++y) {
+            for (int x = 0; x < rw; ++x) {
+                double depth;
+                int id;
+                scene.color(camera.ray((x + 0.5) / rw, (y + 0.5) / rh, aspect), depth, id);
+            }
+        }
+    });
+    measure("culled", [&] {
+        scene.cull(camera, aspect, frame);
+#pragma omp parallel for
+        for (int y = 0; y < rh; ++y) {
+            for (int x = 0; x < rw; ++x) {
+                double depth;
+                int id;
+                scene.color(camera.ray((x + 0.5) / rw, (y + 0.5) / rh, aspect), frame, depth, id);
+            }
+        }
+    });
+    measure("bin only", [&] { scene.bin(camera, rw, rh, frame); });
+    std::cout << "spheres per tile: "
+              << static_cast<double>(frame.tileSpheres.items.size())
+            / (frame.tilesX * frame.tilesY)
+              << std::endl;
+    std::vector<uint32_t> colors(rw * rh);
+    std::vector<float> depths(rw * rh);
+    std::vector<int32_t> ids(rw * rh);
+    measure("culled and binned", [&] {
+        scene.cull(camera, aspect, frame);
+        scene.bin(camera, rw, rh, frame);
+        traceFrame<ExactMath>(
+            scene, camera, frame, rw, rh, colors.data(), depths.data(), ids.data());
+    });
+}
+
+void BenchmarkStaticScene()
+{
+    std::cout << "--- Static scene ---" << std::endl;
+
+    // The demo scene, as a Scene and as a StaticScene, traced for every pixel without culling
+    const int W = 495;
+    const int H = 270;
+    constexpr DemoScene demo = demo_scene(W, H);
+    constexpr auto fixed = demo.static_scene();
+    const Scene scene = demo.scene();
+    const Point3 fromPoint = demo.viewPoint; // the static scene has the sphere terms for it
+    const int rw = 990;
+    const int rh = 540;
+    std::vector<int32_t> ids(rw * rh);
+
+    const auto measure = [&](const std::string& name, const auto& s) {
+        const int frames = 20;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+#pragma omp parallel for
+            for (int y = 0; y < rh; ++y) {
+                for (int x = 0; x < rw; ++x) {
+                    double depth;
+                    int id;
+                    s.color(fromPoint, x * static_cast<double>(W) / rw,
+                        y * static_cast<double>(H) / rh, depth, id);
+                    ids[(y * rw) + x] = id;
+                }
+            }
+        }
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << elapsed.count() / frames << " ms per " << rw << "x" << rh
+                  << " frame" << std::endl;
+    };
+    measure("dynamic", scene);
+    measure("static", fixed);
+}
+
+// BenchmarkFrameLoop measures the work of the main loop for each frame, and how many allocations
+// it makes after the first frames, if they are counted
+void BenchmarkFrameLoop()
+{
+    std::cout << "--- Frame loop ---" << std::endl;
+
+    FrameLoop loop { 990, 540, 316, 248, 136 };
+    const int frames = 64;
+    for (int i = 0; i < frames; ++i) {
+        loop.run();
+    }
+    const AllocationCount before = allocation_count();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        loop.run();
+    }
+    const std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+    const AllocationCount allocated = allocation_count() - before;
+    std::cout << loop.scene->sphere_count() << " spheres, " << loop.rw << "x" << loop.rh
+              << " upscaled to " << loop.W << "x" << loop.H << ": " << elapsed.count() / frames
+              << " ms per frame";
+    if (allocationsCounted) {
+        std::cout << ", " << static_cast<double>(allocated.allocations) / frames
+                  << " allocations and " << static_cast<double>(allocated.bytes) / frames
+                  << " bytes per frame";
+    }
+    std::cout << std::endl;
+    const ArenaStats stats = loop.frame.arenas.stats();
+    std::cout << "frame arenas: " << stats.threads << " threads, " << stats.used
+              << " bytes used in the last frame, " << stats.peak << " at most, "
+              << stats.reserved << " reserved" << std::endl;
+}
+
+void BenchmarkSimd()
+{
+    std::cout << "--- SIMD ---" << std::endl;
+
+    // The sphere kernel at each level, for a camera inside of a grid of 100k spheres, looking
+    // along it, so that each tile has many spheres behind each other
+    const int W = 495;
+    const int H = 270;
+    const Scene scene = cameraScene(W, H, 316);
+    const Camera camera { Point3 { W * .3, H * .5 + 6, 23.0 },
+        Quat::from_axis_angle(Vec3 { 0, 1, 0 }, 1.45), demoCamera(W, H).fov() };
+    const int rw = 248;
+    const int rh = 136;
+    Frame frame;
+    scene.cull(camera, static_cast<double>(rw) / rh, frame);
+    scene.bin(camera, rw, rh, frame);
+    std::cout << "spheres per tile: "
+              << static_cast<double>(frame.tileSpheres.items.size())
+            / (frame.tilesX * frame.tilesY)
+              << std::endl;
+    std::vector<uint32_t> colors(rw * rh);
+    std::vector<float> depths(rw * rh);
+    std::vector<int32_t> ids(rw * rh);
+    forEachSimdLevel([&](const SimdLevel level) {
+        const int frames = 10;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            traceFrame<ExactMath>(
+                scene, camera, frame, rw, rh, colors.data(), depths.data(), ids.data());
+        }
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - start;
+        std::cout << simd_name(level) << ": " << elapsed.count() / frames << " ms per " << rw
+                  << "x" << rh << " frame" << std::endl;
+    });
+}
+
+// BenchmarkBatch measures how long it takes to render many small images, one per thread, and
+// one at a time with a tile per thread
+void BenchmarkBatch()
+{
+    std::cout << "--- Batch ---" << std::endl;
+
+    const std::string manifest = "/tmp/spheremover_bench.txt"s;
+    std::ofstream { manifest } << "image spheremover_bench.ppm demo 160 90\nsweep 0 4 0 0 48\n"s;
+    const auto images = parse_manifest(manifest);
+    ImageWriter writer;
+    for (const int largeTiles : { std::numeric_limits<int>::max(), 0 }) {
+        const auto start = std::chrono::steady_clock::now();
+        const BatchResult result = renderBatch(images, writer, largeTiles);
+        writer.wait();
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - start;
+        std::cout << images.size() << " images of 160x90, "
+                  << (result.imageParallel > 0 ? "one per thread"s : "a tile per thread"s)
+                  << ": " << elapsed.count() << " ms" << std::endl;
+    }
+}
+
+// BenchmarkPack measures how long it takes to pack a 1980x1080 frame of float colors into
+// pixels, at each level, compared to clamping and packing each pixel on its own
+void BenchmarkPack()
+{
+    std::cout << "--- Pack ---" << std::endl;
+
+    const int w = 1980;
+    const int h = 1080;
+    ColorBuffer colors;
+    colors.resize(w, h);
+    for (size_t i = 0; i < colors.r.size(); ++i) {
+        colors.r[i] = static_cast<float>(i % 300);
+        colors.g[i] = static_cast<float>(i % 256);
+        colors.b[i] = static_cast<float>(i % 280) - 10;
+    }
+    std::vector<uint32_t> argb(colors.r.size());
+    const int frames = 20;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+#pragma omp parallel for
+        for (int i = 0; i < w * h; ++i) {
+            const RGB c = RGB { colors.r[i], colors.g[i], colors.b[i] }.clamp255();
+            argb[i] = 0xFF000000 | (static_cast<uint8_t>(c.R()) << 16)
+                | (static_cast<uint8_t>(c.G()) << 8) | static_cast<uint8_t>(c.B());
+        }
+    }
+    const std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+    std::cout << "each pixel on its own: " << elapsed.count() / frames << " ms per frame"
+              << std::endl;
+
+    forEachSimdLevel([&](const SimdLevel level) {
+        for (const bool gamma : { false, true }) {
+            const auto packStart = std::chrono::steady_clock::now();
+            for (int f = 0; f < frames; ++f) {
+                colors.pack(argb.data(), gamma);
+            }
+            const std::chrono::duration<double, std::milli> packTime
+                = std::chrono::steady_clock::now() - packStart;
+            std::cout << simd_name(level) << (gamma ? " with sRGB: " : ": ")
+                      << packTime.count() / frames << " ms per frame" << std::endl;
+        }
+    });
+}
+
+// BenchmarkToneMap measures how long it takes to tone map a 1980x1080 frame of HDR colors with
+// each curve, at each level, and how long auto exposure takes
+void BenchmarkToneMap()
+{
+    std::cout << "--- Tone mapping ---" << std::endl;
+
+    ColorBuffer colors;
+    colors.resize(1980, 1080);
+    const auto fill = [&] {
+        for (size_t i = 0; i < colors.r.size(); ++i) {
+            colors.r[i] = static_cast<float>(i % 3000);
+            colors.g[i] = static_cast<float>(i % 2000);
+            colors.b[i] = static_cast<float>(i % 1000);
+        }
+    };
+    const int frames = 20;
+
+    fill();
+    const auto start = std::chrono::steady_clock::now();
+    float exposure = 0;
+    for (int f = 0; f < frames; ++f) {
+        exposure += colors.autoExposure();
+    }
+    const std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+    std::cout << "auto exposure of " << exposure / frames << ": " << elapsed.count() / frames
+              << " ms per frame" << std::endl;
+
+    forEachSimdLevel([&](const SimdLevel level) {
+        for (const auto curve : { ToneMap::LINEAR, ToneMap::REINHARD, ToneMap::ACES }) {
+            ToneMapping mapping;
+            mapping.curve = curve;
+            mapping.exposure = -1;
+            std::chrono::duration<double, std::milli> mapTime { 0 };
+            for (int f = 0; f < frames; ++f) {
+                fill();
+                const auto mapStart = std::chrono::steady_clock::now();
+                colors.toneMap(mapping);
+                mapTime += std::chrono::steady_clock::now() - mapStart;
+            }
+            std::cout << simd_name(level) << " " << tone_map_name(curve) << ": "
+                      << mapTime.count() / frames << " ms per frame" << std::endl;
+        }
+    });
+}
+
+// BenchmarkY4M measures how long it takes to convert a 1980x1080 frame to YUV 4:2:0, at each
+// level
+void BenchmarkY4M()
+{
+    std::cout << "--- Y4M ---" << std::endl;
+
+    const int w = 1980;
+    const int h = 1080;
+    std::vector<uint32_t> argb(static_cast<size_t>(w) * h);
+    for (size_t i = 0; i < argb.size(); ++i) {
+        argb[i] = 0xFF000000 | static_cast<uint32_t>(i * 2654435761u);
+    }
+    const size_t chroma = static_cast<size_t>(w / 2) * (h / 2);
+    std::vector<uint8_t> yuv(argb.size() + 2 * chroma);
+    forEachSimdLevel([&](const SimdLevel level) {
+        const int frames = 20;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            argb_to_yuv420(argb.data(), w, h, yuv.data(), yuv.data() + argb.size(),
+                yuv.data() + argb.size() + chroma);
+        }
+        const std::chrono::duration<double, std::milli> elapsed
+            = std::chrono::steady_clock::now() - start;
+        std::cout << simd_name(level) << ": " << elapsed.count() / frames << " ms per frame"
+                  << std::endl;
+    });
+}
+
+auto main(int argc, char** argv) -> int
+{
+    const auto options = parse_options(argc, argv);
+    if (!options) {
+        return EXIT_FAILURE;
+    }
+
+    if (options->simd && !simd_select(*options->simd)) {
+        std::cerr << "This CPU does not support " << simd_name(*options->simd) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (options->test) { // pass "test" as the first argument
+
+        TestV2();
+        TestV3();
+        TestV4();
+        TestQuat();
 
         TestSphere();
         TestCube();
         TestDisk();
         TestPlane();
 
+        TestTriangle();
+        TestMesh();
+        TestObjLoader();
+        TestSceneFile();
+
         TestRay();
+        TestUpscaler();
+        TestResolutionController();
         TestRayTrace("/tmp/out.ppm"s);
+        TestMathPolicy();
+        TestCamera();
+        TestDemoScene();
+        TestStaticScene();
+        TestSimd();
+        TestColorBuffer();
+        TestToneMap();
 
         TestScript(SCRIPTDIR "hello.pip"s);
         TestScript(SCRIPTDIR "hello2.pip"s);
+        TestArena();
+        TestVM();
+        TestWatcher();
+        TestCommandBuffer();
+        TestAllocations();
+        TestFrameArenas();
+        TestBatch();
+        TestAnimation();
+        TestY4M();
+
+    } else if (options->bench) { // pass "bench" as the first argument
+
+        BenchmarkTokenizer();
+        BenchmarkParser();
+        BenchmarkVM();
+        BenchmarkCommandBuffer();
+        BenchmarkMathPolicy();
+        BenchmarkCulling();
+        BenchmarkStaticScene();
+        BenchmarkSimd();
+        BenchmarkPack();
+        BenchmarkToneMap();
+        BenchmarkFrameLoop();
+        BenchmarkBatch();
+        BenchmarkY4M();
+
+    } else if (!options->batch.empty()) {
+
+        return runBatch(options->batch, options->toneMapping);
+
+    } else if (options->animate > 0) {
+
+        return runAnimation(*options);
 
     } else { // default behavior
 
-        TestSDL2RayTrace(true);
+        return TestSDL2RayTrace(true, *options);
     }
 
     return EXIT_SUCCESS;
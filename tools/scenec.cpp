@@ -0,0 +1,33 @@
+// scenec converts a text description of a scene to a scene file that can be memory mapped.
+// See include/scenefile.hpp for the format of the text description and the scene file.
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "scenefile.hpp"
+
+auto main(int argc, char** argv) -> int
+{
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " INPUT.txt OUTPUT.scene" << std::endl;
+        return EXIT_FAILURE;
+    }
+    try {
+        const SceneData data = parse_scene_text(argv[1]);
+        write_scene_file(data.view(), argv[2]);
+
+        // Read the file back, to check that it can be loaded
+        const MappedScene mapped { argv[2] };
+        const SceneView& view = mapped.view();
+        std::cout << argv[2] << ": " << view.sphereX.size() << " spheres, "
+                  << view.planeX.size() << " planes, " << view.cubeX.size() << " cubes, "
+                  << view.meshVertexStart.size() << " meshes with " << view.indices.size() / 3
+                  << " triangles, " << view.materialR.size() << " materials" << std::endl;
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}